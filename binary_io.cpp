@@ -0,0 +1,52 @@
+#include "binary_io.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const size_t READ_CHUNK_SIZE = 1 << 16;
+
+} // namespace
+
+void WriteUint(ostream& output, uint64_t value, size_t bytes) {
+    char buffer[sizeof(uint64_t)];
+    for (size_t i = 0; i < bytes; ++i) {
+        buffer[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+    output.write(buffer, bytes);
+}
+
+uint64_t ReadUint(istream& input, size_t bytes) {
+    char buffer[sizeof(uint64_t)];
+    if (!input.read(buffer, bytes)) {
+        throw invalid_argument("Unexpected end of binary data"s);
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(buffer[i])) << (8 * i);
+    }
+    return value;
+}
+
+void WriteString(ostream& output, string_view value) {
+    WriteUint(output, value.size(), sizeof(uint32_t));
+    output.write(value.data(), value.size());
+}
+
+string ReadString(istream& input, size_t max_size) {
+    const size_t size = ReadUint(input, sizeof(uint32_t));
+    if (size > max_size) {
+        throw invalid_argument("Broken size of string"s);
+    }
+    string value;
+    while (value.size() < size) {
+        const size_t offset = value.size();
+        value.resize(offset + min(size - offset, READ_CHUNK_SIZE));
+        if (!input.read(value.data() + offset, value.size() - offset)) {
+            throw invalid_argument("Unexpected end of binary data"s);
+        }
+    }
+    return value;
+}
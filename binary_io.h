@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// Little-endian integers and strings (u32 size | bytes) of binary files: query logs, snapshots.
+// Reading throws invalid_argument if data ends earlier.
+
+void WriteUint(std::ostream& output, uint64_t value, size_t bytes);
+uint64_t ReadUint(std::istream& input, size_t bytes);
+
+void WriteString(std::ostream& output, std::string_view value);
+// max_size - limit of size of broken data, string grows by chunks as they are read, so size of broken
+// data allocates no more than the data itself
+std::string ReadString(std::istream& input, size_t max_size);
@@ -0,0 +1,78 @@
+#include "bloom_filter.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+uint64_t HashBloomKey(string_view key) {
+    uint64_t hash = std::hash<string_view>{}(key);
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+BloomFilterParameters::BloomFilterParameters(double false_positive_rate) :
+    false_positive_rate(false_positive_rate) {
+    if (!(false_positive_rate > 0 && false_positive_rate < 1)) {
+        throw invalid_argument("False positive rate must be in (0, 1)"s);
+    }
+    const double ln2 = log(2.0);
+    bits_per_key = -log(false_positive_rate) / (ln2 * ln2);
+    hash_count = static_cast<uint32_t>(clamp(lround(bits_per_key * ln2), 1L, 16L));
+}
+
+BlockedBloomFilter::BlockedBloomFilter(const allocator_type& allocator) :
+    blocks_(allocator) {
+
+}
+
+BlockedBloomFilter::BlockedBloomFilter(size_t key_count, const BloomFilterParameters& parameters, const allocator_type& allocator) :
+    blocks_(max<size_t>(1, static_cast<size_t>(ceil(key_count * parameters.bits_per_key / BLOOM_BLOCK_BITS))), allocator),
+    hash_count_(parameters.hash_count) {
+
+}
+
+BlockedBloomFilter::BlockedBloomFilter(const BlockedBloomFilter& other, const allocator_type& allocator) :
+    blocks_(other.blocks_, allocator), hash_count_(other.hash_count_) {
+
+}
+
+BlockedBloomFilter::BlockedBloomFilter(BlockedBloomFilter&& other, const allocator_type& allocator) :
+    blocks_(std::move(other.blocks_), allocator), hash_count_(other.hash_count_) {
+
+}
+
+void BlockedBloomFilter::Add(uint64_t hash) {
+    BloomBlock& block = blocks_[GetBlockIndex(hash)];
+    ForEachBit(hash, [&block](size_t word, uint64_t mask) {
+        block.bits[word] |= mask;
+    });
+}
+
+bool BlockedBloomFilter::MayContain(uint64_t hash) const {
+    if (blocks_.empty()) {
+        return false;
+    }
+    const BloomBlock& block = blocks_[GetBlockIndex(hash)];
+    bool may_contain = true;
+    ForEachBit(hash, [&block, &may_contain](size_t word, uint64_t mask) {
+        may_contain &= (block.bits[word] & mask) != 0;
+    });
+    return may_contain;
+}
+
+size_t BlockedBloomFilter::GetBlockCount() const {
+    return blocks_.size();
+}
+
+void BlockedBloomFilter::Clear() {
+    blocks_.clear();
+    blocks_.shrink_to_fit();
+}
+
+size_t BlockedBloomFilter::GetBlockIndex(uint64_t hash) const {
+    // multiply-shift range reduction of the high half of hash
+    return static_cast<size_t>(((hash >> 32) * blocks_.size()) >> 32);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// bits of one block of filter (cache line)
+const size_t BLOOM_BLOCK_BITS = 512;
+
+// cache line of filter with bits of keys which hashes select it
+struct alignas(64) BloomBlock {
+    uint64_t bits[BLOOM_BLOCK_BITS / 64] = {};
+};
+
+// hash of key of filter (std::hash with finalizer of splitmix64)
+uint64_t HashBloomKey(std::string_view key);
+
+// sizes of filters for false positive rate p: -ln(p) / ln(2)^2 bits per key, k = bits per key * ln(2)
+// bits per key (blocked filter has somewhat larger rate because keys aren't spread evenly over blocks)
+struct BloomFilterParameters {
+    explicit BloomFilterParameters(double false_positive_rate);
+
+    double false_positive_rate;
+    double bits_per_key;
+    uint32_t hash_count;
+};
+
+// Blocked Bloom filter: key sets hash_count bits in one block selected by its hash, so test of key reads
+// one cache line. MayContain is false only for keys which weren't added.
+class BlockedBloomFilter {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    explicit BlockedBloomFilter(const allocator_type& allocator = {});
+    BlockedBloomFilter(size_t key_count, const BloomFilterParameters& parameters, const allocator_type& allocator = {});
+    BlockedBloomFilter(const BlockedBloomFilter& other, const allocator_type& allocator);
+    BlockedBloomFilter(BlockedBloomFilter&& other, const allocator_type& allocator);
+    BlockedBloomFilter(const BlockedBloomFilter&) = default;
+    BlockedBloomFilter(BlockedBloomFilter&&) = default;
+    BlockedBloomFilter& operator=(const BlockedBloomFilter&) = default;
+    BlockedBloomFilter& operator=(BlockedBloomFilter&&) = default;
+
+    void Add(uint64_t hash);
+    bool MayContain(uint64_t hash) const;
+
+    size_t GetBlockCount() const;
+    // releasing blocks, filter contains nothing
+    void Clear();
+
+private:
+    std::pmr::vector<BloomBlock> blocks_;
+    uint32_t hash_count_ = 0;
+
+    // bits of block for hash: double hashing by the low half of hash (the high half chooses block)
+    template <typename Function>
+    void ForEachBit(uint64_t hash, Function function) const {
+        const uint32_t first = static_cast<uint32_t>(hash);
+        const uint32_t step = static_cast<uint32_t>((hash * 0x9e3779b97f4a7c15ULL) >> 40) | 1;
+        for (uint32_t i = 0; i < hash_count_; ++i) {
+            const uint32_t bit = (first + i * step) % BLOOM_BLOCK_BITS;
+            function(bit / 64, uint64_t{ 1 } << (bit % 64));
+        }
+    }
+
+    size_t GetBlockIndex(uint64_t hash) const;
+};
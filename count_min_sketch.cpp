@@ -0,0 +1,44 @@
+#include "count_min_sketch.h"
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+CountMinSketch::CountMinSketch(size_t width, size_t depth, uint64_t decay_period) :
+    width_(width), depth_(depth), decay_period_(decay_period), counters_(width * depth) {
+    if (width == 0 || depth == 0) {
+        throw invalid_argument("Size of sketch must be positive"s);
+    }
+}
+
+uint32_t CountMinSketch::Add(string_view key) {
+    if (decay_period_ > 0 && (addition_count_.fetch_add(1, memory_order_relaxed) + 1) % decay_period_ == 0) {
+        for (auto& counter : counters_) {
+            counter.store(counter.load(memory_order_relaxed) / 2, memory_order_relaxed);
+        }
+    }
+
+    const size_t hash = std::hash<string_view>{}(key);
+    uint32_t estimate = numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < depth_; ++row) {
+        const uint32_t count = counters_[row * width_ + GetIndex(hash, row)].fetch_add(1, memory_order_relaxed) + 1;
+        estimate = min(estimate, count);
+    }
+    return estimate;
+}
+
+uint32_t CountMinSketch::Estimate(string_view key) const {
+    const size_t hash = std::hash<string_view>{}(key);
+    uint32_t estimate = numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < depth_; ++row) {
+        estimate = min(estimate, counters_[row * width_ + GetIndex(hash, row)].load(memory_order_relaxed));
+    }
+    return estimate;
+}
+
+size_t CountMinSketch::GetIndex(size_t hash, size_t row) const {
+    // the second hash is odd, so rows use different counters for colliding keys
+    const size_t step = ((hash >> 32) ^ (hash * 0x9e3779b97f4a7c15ULL)) | 1;
+    return (hash + row * step) % width_;
+}
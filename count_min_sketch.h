@@ -0,0 +1,28 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Count-Min sketch of frequencies of strings: depth rows of width counters, estimate is the minimum of
+// counters of key (never less than true frequency, more by collisions). Counters are halved after
+// decay_period additions, so frequencies of recent keys outweigh old ones. Adding is lock-free.
+class CountMinSketch {
+public:
+    CountMinSketch(size_t width, size_t depth, uint64_t decay_period);
+
+    // adding one occurrence of key, returns estimate of its frequency after it
+    uint32_t Add(std::string_view key);
+
+    uint32_t Estimate(std::string_view key) const;
+
+private:
+    size_t width_;
+    size_t depth_;
+    uint64_t decay_period_;
+    std::vector<std::atomic<uint32_t>> counters_;
+    std::atomic<uint64_t> addition_count_ = 0;
+
+    // index of counter of key in row (double hashing)
+    size_t GetIndex(size_t hash, size_t row) const;
+};
@@ -0,0 +1,91 @@
+#include "execution_cost.h"
+#include "generators.h"
+#include "search_server.h"
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const int CALIBRATION_DICTIONARY_SIZE = 500;
+const int CALIBRATION_DOCUMENT_WORDS = 50;
+const int CALIBRATION_QUERY_COUNT = 8;
+const int CALIBRATION_REPETITIONS = 3;
+const int CALIBRATION_MAX_QUERY_WORDS = 256;
+
+struct Measurement {
+    double cost = 0;
+    double sequential_time = 0;
+    double parallel_time = 0;
+};
+
+// the least time of several runs of all queries
+template <typename Function>
+double MeasureTime(const vector<string>& queries, Function function) {
+    double best_time = NEVER_PARALLEL;
+    for (int i = 0; i < CALIBRATION_REPETITIONS; ++i) {
+        const auto start = chrono::steady_clock::now();
+        for (const string& query : queries) {
+            function(query);
+        }
+        best_time = min(best_time, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return best_time;
+}
+
+// the least cost from which parallel execution is faster for all measured costs
+double FindThreshold(const vector<Measurement>& measurements) {
+    double threshold = NEVER_PARALLEL;
+    for (auto it = measurements.rbegin(); it != measurements.rend() && it->parallel_time < it->sequential_time; ++it) {
+        threshold = it->cost;
+    }
+    return threshold;
+}
+
+}
+
+ExecutionCostModel CalibrateCostModel(shared_ptr<Executor> executor, size_t document_count) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, CALIBRATION_DICTIONARY_SIZE, 10);
+
+    SearchServer server(""s, executor);
+    for (size_t i = 0; i < document_count; ++i) {
+        server.AddDocument(i, GenerateQuery(generator, dictionary, CALIBRATION_DOCUMENT_WORDS), DocumentStatus::ACTUAL, { 1 });
+    }
+
+    ExecutionCostModel model;
+    const double lookup_cost = model.word_cost + log2(server.GetWordFrequencies(0).size() + 1);
+
+    vector<Measurement> find_measurements;
+    vector<Measurement> match_measurements;
+    for (int word_count = 1; word_count <= CALIBRATION_MAX_QUERY_WORDS; word_count *= 2) {
+        vector<string> queries;
+        Measurement find;
+        for (int i = 0; i < CALIBRATION_QUERY_COUNT; ++i) {
+            queries.push_back(GenerateQuery(generator, dictionary, word_count, 0.1));
+            find.cost += server.EstimateQueryCost(queries.back()) / CALIBRATION_QUERY_COUNT;
+        }
+
+        find.sequential_time = MeasureTime(queries, [&](const string& query) { server.FindTopDocuments(execution::seq, query); });
+        find.parallel_time = MeasureTime(queries, [&](const string& query) { server.FindTopDocuments(execution::par, query); });
+        find_measurements.push_back(find);
+
+        Measurement match;
+        match.cost = word_count * lookup_cost;
+        match.sequential_time = MeasureTime(queries, [&](const string& query) { server.MatchDocument(execution::seq, query, 0); });
+        match.parallel_time = MeasureTime(queries, [&](const string& query) { server.MatchDocument(execution::par, query, 0); });
+        match_measurements.push_back(match);
+    }
+
+    model.parallel_threshold = FindThreshold(find_measurements);
+    if (model.parallel_threshold != NEVER_PARALLEL) {
+        // task must have at least half of work which pays for parallel execution
+        model.cost_per_task = model.parallel_threshold / 2;
+    }
+    model.match_parallel_threshold = FindThreshold(match_measurements);
+    return model;
+}
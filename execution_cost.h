@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include "executor.h"
+
+// policy tag: server chooses sequential or parallel execution (and count of tasks) by cost of query
+struct AdaptivePolicy {};
+inline constexpr AdaptivePolicy ADAPTIVE{};
+
+// Cost model of adaptive execution.
+// Cost of FindTopDocuments is count of postings of plus and minus words + word_cost for every word.
+// Cost of MatchDocument is count of query words * (word_cost + log2 of count of document words).
+struct ExecutionCostModel {
+    // cost of query word apart from its postings (dictionary search, IDF)
+    double word_cost = 32;
+    // FindTopDocuments is parallel from this cost
+    double parallel_threshold = 50'000;
+    // cost of one task of parallel FindTopDocuments, fan-out = cost / cost_per_task
+    double cost_per_task = 25'000;
+    // MatchDocument is parallel from this cost
+    double match_parallel_threshold = 20'000;
+};
+
+// cost which is never reached: always sequential
+const double NEVER_PARALLEL = std::numeric_limits<double>::max();
+
+// built-in benchmark: synthetic base of document_count documents is queried sequentially and in parallel
+// by executor, thresholds are set to the least cost from which parallel execution is faster
+// (NEVER_PARALLEL if it is never faster)
+ExecutionCostModel CalibrateCostModel(std::shared_ptr<Executor> executor, size_t document_count = 20'000);
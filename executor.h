@@ -0,0 +1,65 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+enum class TaskPriority {
+    LOW,
+    NORMAL,
+    HIGH,
+};
+
+// runs tasks of search server: asynchronous queries and parallel stages of queries
+class Executor {
+public:
+    using Task = std::function<void()>;
+
+    virtual ~Executor() = default;
+
+    // adding task if queue is not full: true/false
+    virtual bool TrySubmit(Task task, TaskPriority priority = TaskPriority::NORMAL) = 0;
+
+    // calling function(i) for i from 0 to count - 1, returns when all calls are done;
+    // must be safe to call from tasks of the same executor
+    virtual void ParallelFor(size_t count, const std::function<void(size_t)>& function) = 0;
+
+    // count of threads doing tasks
+    virtual size_t GetConcurrency() const = 0;
+};
+
+// size of part of range which is sorted by one task
+const size_t MIN_PARALLEL_SORT_CHUNK = 1024;
+
+// sorting parts of range by executor and merging them
+template <typename RandomIt, typename Compare>
+void ParallelSort(Executor& executor, RandomIt first, RandomIt last, Compare comp) {
+    const size_t size = last - first;
+    const size_t chunk_count = std::min(executor.GetConcurrency(), size / MIN_PARALLEL_SORT_CHUNK);
+    if (chunk_count < 2) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    std::vector<size_t> bounds(chunk_count + 1);
+    for (size_t i = 0; i <= chunk_count; ++i) {
+        bounds[i] = size * i / chunk_count;
+    }
+
+    executor.ParallelFor(chunk_count,
+        [&](size_t i) {
+            std::sort(first + bounds[i], first + bounds[i + 1], comp);
+        });
+
+    // merging neighbour sorted parts: 1+1, 2+2, 4+4...
+    for (size_t width = 1; width < chunk_count; width *= 2) {
+        executor.ParallelFor((chunk_count + 2 * width - 1) / (2 * width),
+            [&](size_t i) {
+                const size_t left = i * 2 * width;
+                const size_t middle = std::min(left + width, chunk_count);
+                const size_t right = std::min(left + 2 * width, chunk_count);
+                if (middle < right) {
+                    std::inplace_merge(first + bounds[left], first + bounds[middle], first + bounds[right], comp);
+                }
+            });
+    }
+}
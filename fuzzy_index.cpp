@@ -0,0 +1,135 @@
+#include "fuzzy_index.h"
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <unordered_set>
+
+using namespace std;
+
+size_t ComputeEditDistance(string_view lhs, string_view rhs, size_t max_distance) {
+    const size_t too_far = max_distance + 1;
+    if (max(lhs.size(), rhs.size()) - min(lhs.size(), rhs.size()) > max_distance) {
+        return too_far;
+    }
+    // rows of distances of prefixes of lhs to prefixes of rhs: before previous, previous, current
+    vector<size_t> before(rhs.size() + 1), previous(rhs.size() + 1), current(rhs.size() + 1);
+    for (size_t j = 0; j <= rhs.size(); ++j) {
+        previous[j] = j;
+    }
+    size_t previous_min = 0;
+    for (size_t i = 1; i <= lhs.size(); ++i) {
+        current[0] = i;
+        size_t row_min = current[0];
+        for (size_t j = 1; j <= rhs.size(); ++j) {
+            const size_t cost = lhs[i - 1] == rhs[j - 1] ? 0 : 1;
+            current[j] = min({ previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost });
+            if (i > 1 && j > 1 && lhs[i - 1] == rhs[j - 2] && lhs[i - 2] == rhs[j - 1]) {
+                current[j] = min(current[j], before[j - 2] + 1);
+            }
+            row_min = min(row_min, current[j]);
+        }
+        // the next rows are computed from this row and the previous one (transpositions)
+        if (row_min > max_distance && previous_min > max_distance) {
+            return too_far;
+        }
+        previous_min = row_min;
+        swap(before, previous);
+        swap(previous, current);
+    }
+    return min(previous[rhs.size()], too_far);
+}
+
+DeletionIndex::DeletionIndex(size_t max_distance, const allocator_type& allocator) :
+    max_distance_(max_distance),
+    deletions_(allocator) {
+}
+
+void DeletionIndex::Add(string_view word) {
+    for (const uint64_t hash : GetDeletionHashes(word)) {
+        deletions_[hash].push_back(word);
+    }
+    ++word_count_;
+}
+
+void DeletionIndex::Remove(string_view word) {
+    for (const uint64_t hash : GetDeletionHashes(word)) {
+        const auto it = deletions_.find(hash);
+        if (it == deletions_.end()) {
+            continue;
+        }
+        auto& words = it->second;
+        const auto word_it = find(words.begin(), words.end(), word);
+        if (word_it != words.end()) {
+            *word_it = words.back();
+            words.pop_back();
+        }
+        if (words.empty()) {
+            deletions_.erase(it);
+        }
+    }
+    --word_count_;
+}
+
+void DeletionIndex::Rekey(string_view word, string_view key) {
+    for (const uint64_t hash : GetDeletionHashes(word)) {
+        auto& words = deletions_.at(hash);
+        *find(words.begin(), words.end(), word) = key;
+    }
+}
+
+vector<pair<string_view, size_t>> DeletionIndex::Find(string_view word) const {
+    vector<pair<string_view, size_t>> result;
+    unordered_set<string_view> checked;
+    for (const uint64_t hash : GetDeletionHashes(word)) {
+        const auto it = deletions_.find(hash);
+        if (it == deletions_.end()) {
+            continue;
+        }
+        for (const string_view candidate : it->second) {
+            if (!checked.insert(candidate).second) {
+                continue;
+            }
+            const size_t distance = ComputeEditDistance(word, candidate, max_distance_);
+            if (distance <= max_distance_) {
+                result.emplace_back(candidate, distance);
+            }
+        }
+    }
+    return result;
+}
+
+size_t DeletionIndex::GetMaxDistance() const {
+    return max_distance_;
+}
+
+size_t DeletionIndex::GetWordCount() const {
+    return word_count_;
+}
+
+vector<uint64_t> DeletionIndex::GetDeletionHashes(string_view word) const {
+    // deletions by levels of count of deleted characters, strings of level have the same size
+    vector<string> deletions{ string(word) };
+    size_t level_begin = 0;
+    for (size_t distance = 0; distance < max_distance_; ++distance) {
+        const size_t level_end = deletions.size();
+        for (size_t i = level_begin; i < level_end; ++i) {
+            for (size_t position = 0; position < deletions[i].size(); ++position) {
+                string deletion = deletions[i];
+                deletion.erase(position, 1);
+                deletions.push_back(move(deletion));
+            }
+        }
+        sort(deletions.begin() + level_end, deletions.end());
+        deletions.erase(unique(deletions.begin() + level_end, deletions.end()), deletions.end());
+        level_begin = level_end;
+    }
+
+    vector<uint64_t> hashes;
+    hashes.reserve(deletions.size());
+    for (const string& deletion : deletions) {
+        hashes.push_back(hash<string_view>{}(deletion));
+    }
+    sort(hashes.begin(), hashes.end());
+    hashes.erase(unique(hashes.begin(), hashes.end()), hashes.end());
+    return hashes;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// optimal string alignment distance (insertions, deletions, substitutions and transpositions of adjacent
+// characters), max_distance + 1 if it is larger
+size_t ComputeEditDistance(std::string_view lhs, std::string_view rhs, size_t max_distance);
+
+// Index of deletions of dictionary words (SymSpell): if words are within d edits, a string obtained from one
+// of them by deleting no more than d characters is obtained so from the other as well. Candidates of query
+// word are words sharing such deletions with it, so search doesn't scan dictionary. Keys are hashes of
+// deletions, candidates are checked by ComputeEditDistance.
+class DeletionIndex {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    explicit DeletionIndex(size_t max_distance, const allocator_type& allocator = {});
+
+    // word must stay valid while it is in index (see Rekey)
+    void Add(std::string_view word);
+    void Remove(std::string_view word);
+    // replacing view of word by key with the same characters
+    void Rekey(std::string_view word, std::string_view key);
+
+    // words of index within max distance of word with their distances (in no particular order)
+    std::vector<std::pair<std::string_view, size_t>> Find(std::string_view word) const;
+
+    size_t GetMaxDistance() const;
+    size_t GetWordCount() const;
+
+private:
+    size_t max_distance_;
+    size_t word_count_ = 0;
+    std::pmr::unordered_map<uint64_t, std::pmr::vector<std::string_view>> deletions_;
+
+    // hashes of distinct strings obtained from word by deleting no more than max_distance_ characters
+    // (word itself too)
+    std::vector<uint64_t> GetDeletionHashes(std::string_view word) const;
+};
@@ -0,0 +1,15 @@
+#pragma once
+#include <random>
+#include <string>
+#include <vector>
+
+// random word of letters a-z
+std::string GenerateWord(std::mt19937& generator, int max_length);
+
+// random words without adjacent duplicates
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+
+// random words of dictionary separated by spaces, word is minus-word with probability minus_prob
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count);
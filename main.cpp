@@ -1,6 +1,8 @@
 #include "search_server.h"
-#include "log_duration.h"
+#include "generators.h"
+#include "metrics.h"
 #include "test_example_functions.h"
+#include <algorithm>
 #include <execution>
 #include <iostream>
 #include <random>
@@ -9,52 +11,9 @@
 
 using namespace std;
 
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution(static_cast<int>('a'), static_cast < int>('z'))(generator));
-    }
-    return word;
-}
-
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
-    }
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
-}
-
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
-        }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
-        }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
-    }
-    return query;
-}
-
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-    vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
-    }
-    return queries;
-}
-
 template <typename ExecutionPolicy>
 void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
+    ScopedTimer timer(MetricsRegistry::Instance().Register("benchmark."s + string(mark), MetricType::TIMER));
     double total_relevance = 0;
     for (const string_view query : queries) {
         for (const auto& document : search_server.FindTopDocuments(policy, query)) {
@@ -71,11 +30,21 @@ int main() {
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
     const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
-    SearchServer search_server(dictionary[0]);
+    const auto executor = make_shared<ThreadPool>(ThreadPoolConfig());
+    SearchServer search_server(dictionary[0], executor);
     for (size_t i = 0; i < documents.size(); ++i) {
         search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
     }
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
     TEST(seq);
     TEST(par);
+    search_server.SetCostModel(CalibrateCostModel(executor));
+    Test("adaptive"s, search_server, queries, ADAPTIVE);
+    // registry is global: metrics registered by tests aren't printed
+    MetricsSnapshot snapshot = MetricsRegistry::Instance().GetSnapshot();
+    snapshot.metrics.erase(remove_if(snapshot.metrics.begin(), snapshot.metrics.end(),
+        [](const MetricSnapshot& metric) {
+            return metric.name.rfind("benchmark."s, 0) != 0 && metric.name.rfind("find_top_documents"s, 0) != 0;
+        }), snapshot.metrics.end());
+    cout << snapshot.ToText();
 }
\ No newline at end of file
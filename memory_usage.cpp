@@ -0,0 +1,45 @@
+#include "memory_usage.h"
+
+using namespace std;
+
+size_t MemoryUsage::GetTotal() const {
+    return stop_words + inverted_index + forward_index + quantized_index + impact_index + duplicate_index + bloom_filters + fuzzy_index + document_texts + document_metadata;
+}
+
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other) {
+    stop_words += other.stop_words;
+    inverted_index += other.inverted_index;
+    forward_index += other.forward_index;
+    quantized_index += other.quantized_index;
+    impact_index += other.impact_index;
+    duplicate_index += other.duplicate_index;
+    bloom_filters += other.bloom_filters;
+    fuzzy_index += other.fuzzy_index;
+    document_texts += other.document_texts;
+    document_metadata += other.document_metadata;
+    return *this;
+}
+
+CountingMemoryResource::CountingMemoryResource(pmr::memory_resource* upstream) :
+    upstream_(upstream) {
+
+}
+
+size_t CountingMemoryResource::GetAllocatedBytes() const {
+    return allocated_bytes_.load(memory_order_relaxed);
+}
+
+void* CountingMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    void* pointer = upstream_->allocate(bytes, alignment);
+    allocated_bytes_.fetch_add(bytes, memory_order_relaxed);
+    return pointer;
+}
+
+void CountingMemoryResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    upstream_->deallocate(pointer, bytes, alignment);
+    allocated_bytes_.fetch_sub(bytes, memory_order_relaxed);
+}
+
+bool CountingMemoryResource::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+// bytes requested by containers of search server (without overhead of heap)
+struct MemoryUsage {
+    size_t stop_words = 0;
+    // word -> documents
+    size_t inverted_index = 0;
+    // document -> words
+    size_t forward_index = 0;
+    // postings with quantized impacts (empty in exact scoring mode)
+    size_t quantized_index = 0;
+    // postings sorted by TF (empty if impact ordering is disabled)
+    size_t impact_index = 0;
+    // signatures of sets of words of documents and found duplicates (empty if detection is disabled)
+    size_t duplicate_index = 0;
+    // Bloom filters of words of documents (empty if they are disabled)
+    size_t bloom_filters = 0;
+    // deletions of dictionary words for typo-tolerant search (empty if it is disabled)
+    size_t fuzzy_index = 0;
+    size_t document_texts = 0;
+    // IDs, ratings, statuses, order of adding
+    size_t document_metadata = 0;
+
+    size_t GetTotal() const;
+
+    MemoryUsage& operator+=(const MemoryUsage& other);
+};
+
+// memory resource counting bytes which are allocated and not yet deallocated, counters are thread-safe,
+// upstream is called by thread calling allocate/deallocate
+class CountingMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit CountingMemoryResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    size_t GetAllocatedBytes() const;
+
+private:
+    std::pmr::memory_resource* upstream_;
+    std::atomic<size_t> allocated_bytes_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
@@ -0,0 +1,268 @@
+#include "metrics.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// index of the highest set bit, value > 0
+int GetHighestBit(uint64_t value) {
+    int bit = 0;
+    for (int shift = 32; shift > 0; shift /= 2) {
+        if (value >> shift) {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+    return bit;
+}
+
+// single writer: load + store is enough and cheaper than fetch_add
+void Increase(atomic<uint64_t>& value, uint64_t delta) {
+    value.store(value.load(memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+uint64_t GetPercentile(const vector<uint64_t>& counts, uint64_t total_count, double percentile) {
+    const double rank = percentile * total_count;
+    uint64_t count = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        count += counts[i];
+        if (count > 0 && count >= rank) {
+            return LatencyHistogram::GetBucketValue(i);
+        }
+    }
+    return 0;
+}
+
+string_view GetTypeName(MetricType type) {
+    return type == MetricType::TIMER ? "timer"sv : "counter"sv;
+}
+
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return value;
+    }
+    value = min(value, (uint64_t(1) << MAX_VALUE_BITS) - 1);
+    const int bit = GetHighestBit(value);
+    const uint64_t sub_bucket = (value >> (bit - SUB_BUCKET_BITS)) - SUB_BUCKET_COUNT;
+    return (bit - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketValue(size_t bucket) {
+    if (bucket < SUB_BUCKET_COUNT) {
+        return bucket;
+    }
+    const int shift = bucket / SUB_BUCKET_COUNT - 1;
+    const uint64_t sub_bucket = bucket % SUB_BUCKET_COUNT;
+    return ((SUB_BUCKET_COUNT + sub_bucket + 1) << shift) - 1;
+}
+
+string MetricsSnapshot::ToText() const {
+    ostringstream out;
+    for (const auto& metric : metrics) {
+        const size_t depth = count(metric.name.begin(), metric.name.end(), '.');
+        const size_t dot = metric.name.rfind('.');
+        out << string(depth * 2, ' ') << (dot == string::npos ? metric.name : metric.name.substr(dot + 1)) << ": "s;
+        if (metric.type == MetricType::TIMER) {
+            out << "count = "s << metric.count << ", total = "s << metric.total_ns / 1000 << " us, p50 = "s << metric.p50_ns
+                << " ns, p90 = "s << metric.p90_ns << " ns, p99 = "s << metric.p99_ns << " ns, max = "s << metric.max_ns << " ns"s;
+        }
+        else {
+            out << metric.count;
+        }
+        out << '\n';
+    }
+    return out.str();
+}
+
+string MetricsSnapshot::ToJson() const {
+    ostringstream out;
+    out << "{\"metrics\": ["s;
+    bool is_first = true;
+    for (const auto& metric : metrics) {
+        out << (is_first ? ""s : ", "s) << "{\"name\": \""s << metric.name << "\", \"type\": \""s << GetTypeName(metric.type)
+            << "\", \"count\": "s << metric.count;
+        if (metric.type == MetricType::TIMER) {
+            out << ", \"total_ns\": "s << metric.total_ns << ", \"p50_ns\": "s << metric.p50_ns << ", \"p90_ns\": "s << metric.p90_ns
+                << ", \"p99_ns\": "s << metric.p99_ns << ", \"max_ns\": "s << metric.max_ns;
+        }
+        out << '}';
+        is_first = false;
+    }
+    out << "]}"s;
+    return out.str();
+}
+
+MetricsRegistry& MetricsRegistry::Instance() {
+    // never destroyed: threads may write metrics while static objects are destroyed
+    static MetricsRegistry* registry = new MetricsRegistry;
+    return *registry;
+}
+
+MetricsRegistry::ThreadMetrics::~ThreadMetrics() {
+    for (auto& histogram : histograms) {
+        delete histogram.load();
+    }
+}
+
+MetricsRegistry::~MetricsRegistry() {
+    for (ThreadMetrics* thread = threads_.load(); thread;) {
+        ThreadMetrics* next = thread->next;
+        delete thread;
+        thread = next;
+    }
+}
+
+size_t MetricsRegistry::Register(string_view name, MetricType type) {
+    lock_guard guard(mutex_);
+    const auto it = ids_.find(name);
+    if (it != ids_.end()) {
+        if (types_[it->second] != type) {
+            throw invalid_argument("Metric "s + string(name) + " is registered with other type"s);
+        }
+        return it->second;
+    }
+
+    const size_t id = metric_count_.load(memory_order_relaxed);
+    if (id == MAX_METRIC_COUNT) {
+        throw invalid_argument("Too many metrics"s);
+    }
+    names_[id] = string(name);
+    types_[id] = type;
+    ids_.emplace(name, id);
+    metric_count_.store(id + 1, memory_order_release);
+    return id;
+}
+
+size_t MetricsRegistry::RegisterOrDrop(string_view name, MetricType type) {
+    try {
+        return Register(name, type);
+    }
+    catch (const invalid_argument&) {
+        return DROPPED_METRIC_ID;
+    }
+}
+
+void MetricsRegistry::RecordDuration(size_t id, uint64_t nanoseconds) {
+    if (id == DROPPED_METRIC_ID) {
+        return;
+    }
+    ThreadMetrics& metrics = GetThreadMetrics();
+    LatencyHistogram* histogram = metrics.histograms[id].load(memory_order_relaxed);
+    if (!histogram) {
+        histogram = new LatencyHistogram;
+        metrics.histograms[id].store(histogram, memory_order_release);
+    }
+    Increase(histogram->counts[LatencyHistogram::GetBucket(nanoseconds)], 1);
+    Increase(histogram->total, nanoseconds);
+    if (nanoseconds > histogram->max.load(memory_order_relaxed)) {
+        histogram->max.store(nanoseconds, memory_order_relaxed);
+    }
+    Increase(histogram->count, 1);
+}
+
+void MetricsRegistry::AddCount(size_t id, uint64_t value) {
+    if (id == DROPPED_METRIC_ID) {
+        return;
+    }
+    Increase(GetThreadMetrics().counters[id], value);
+}
+
+MetricsSnapshot MetricsRegistry::GetSnapshot() const {
+    const size_t metric_count = metric_count_.load(memory_order_acquire);
+
+    MetricsSnapshot snapshot;
+    for (size_t id = 0; id < metric_count; ++id) {
+        MetricSnapshot metric;
+        metric.name = names_[id];
+        metric.type = types_[id];
+
+        vector<uint64_t> counts(LatencyHistogram::BUCKET_COUNT);
+        for (const ThreadMetrics* thread = threads_.load(memory_order_acquire); thread; thread = thread->next) {
+            if (metric.type == MetricType::COUNTER) {
+                metric.count += thread->counters[id].load(memory_order_relaxed);
+                continue;
+            }
+            const LatencyHistogram* histogram = thread->histograms[id].load(memory_order_acquire);
+            if (!histogram) {
+                continue;
+            }
+            metric.count += histogram->count.load(memory_order_relaxed);
+            metric.total_ns += histogram->total.load(memory_order_relaxed);
+            metric.max_ns = max(metric.max_ns, histogram->max.load(memory_order_relaxed));
+            for (size_t i = 0; i < counts.size(); ++i) {
+                counts[i] += histogram->counts[i].load(memory_order_relaxed);
+            }
+        }
+
+        if (metric.type == MetricType::TIMER) {
+            // counts of buckets may be newer than count of measurements
+            uint64_t total_count = 0;
+            for (const uint64_t count : counts) {
+                total_count += count;
+            }
+            // the greatest value of bucket may be greater than measurements in it
+            metric.p50_ns = min(GetPercentile(counts, total_count, 0.5), metric.max_ns);
+            metric.p90_ns = min(GetPercentile(counts, total_count, 0.9), metric.max_ns);
+            metric.p99_ns = min(GetPercentile(counts, total_count, 0.99), metric.max_ns);
+        }
+        snapshot.metrics.push_back(move(metric));
+    }
+
+    sort(snapshot.metrics.begin(), snapshot.metrics.end(),
+        [](const MetricSnapshot& lhs, const MetricSnapshot& rhs) {
+            return lhs.name < rhs.name;
+        });
+    return snapshot;
+}
+
+size_t MetricsRegistry::GetThreadMetricsCount() const {
+    lock_guard guard(mutex_);
+    return thread_metrics_count_;
+}
+
+MetricsRegistry::ThreadMetricsHandle::~ThreadMetricsHandle() {
+    if (!metrics) {
+        return;
+    }
+    // registry is never destroyed; values stay in sums of snapshots, the next owner adds to them
+    MetricsRegistry& registry = Instance();
+    lock_guard guard(registry.mutex_);
+    registry.released_threads_.push_back(metrics);
+}
+
+MetricsRegistry::ThreadMetrics& MetricsRegistry::GetThreadMetrics() {
+    thread_local ThreadMetricsHandle handle;
+    if (!handle.metrics) {
+        lock_guard guard(mutex_);
+        if (!released_threads_.empty()) {
+            // block of ended thread, the mutex orders its last writes before writes of this thread
+            handle.metrics = released_threads_.back();
+            released_threads_.pop_back();
+        }
+        else {
+            // added to list lock-free for snapshots, blocks aren't removed
+            ThreadMetrics* metrics = new ThreadMetrics;
+            metrics->next = threads_.load(memory_order_relaxed);
+            while (!threads_.compare_exchange_weak(metrics->next, metrics, memory_order_release, memory_order_relaxed)) {
+            }
+            ++thread_metrics_count_;
+            handle.metrics = metrics;
+        }
+    }
+    return *handle.metrics;
+}
+
+ScopedTimer::ScopedTimer(size_t id) :
+    id_(id), start_(chrono::steady_clock::now()) {
+
+}
+
+ScopedTimer::~ScopedTimer() {
+    const auto duration = chrono::steady_clock::now() - start_;
+    MetricsRegistry::Instance().RecordDuration(id_, chrono::duration_cast<chrono::nanoseconds>(duration).count());
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Metrics of search server: scoped timers with nanosecond resolution and counters.
+// Every thread writes to its own histograms and counters (no locks, no shared cache lines),
+// snapshot sums values of all threads without locks; block of ended thread is reused by new thread.
+// Names are hierarchical: "find_top_documents.parse" is a child of "find_top_documents".
+// METRICS_TIMER/METRICS_COUNT compile to nothing if SEARCH_SERVER_NO_METRICS is defined.
+
+const size_t MAX_METRIC_COUNT = 64;
+// id of metric which isn't registered by macros (registry is full or name has other type), values are dropped
+const size_t DROPPED_METRIC_ID = MAX_METRIC_COUNT;
+
+enum class MetricType {
+    TIMER,
+    COUNTER,
+};
+
+// HDR histogram of durations (ns): 16 sub-buckets per power of two (error < 1/16),
+// values up to 2^40 ns (~18 min), greater values are counted as the greatest
+struct LatencyHistogram {
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS;
+    static constexpr int MAX_VALUE_BITS = 40;
+    static constexpr size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    static size_t GetBucket(uint64_t value);
+    // the greatest value of bucket
+    static uint64_t GetBucketValue(size_t bucket);
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts = {};
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> total = 0;
+    std::atomic<uint64_t> max = 0;
+};
+
+struct MetricSnapshot {
+    std::string name;
+    MetricType type = MetricType::COUNTER;
+    // timer: count of measurements, counter: sum of values
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+};
+
+struct MetricsSnapshot {
+    // sorted by name: parents go before children
+    std::vector<MetricSnapshot> metrics;
+
+    // tree of metrics, one metric per line
+    std::string ToText() const;
+    std::string ToJson() const;
+};
+
+class MetricsRegistry {
+public:
+    static MetricsRegistry& Instance();
+
+    // id of metric (the same for the same name), throws invalid_argument if name is registered
+    // with other type or there are MAX_METRIC_COUNT metrics
+    size_t Register(std::string_view name, MetricType type);
+    // the same, DROPPED_METRIC_ID instead of exception (macros register metrics on the first measurement)
+    size_t RegisterOrDrop(std::string_view name, MetricType type);
+
+    void RecordDuration(size_t id, uint64_t nanoseconds);
+    void AddCount(size_t id, uint64_t value);
+
+    MetricsSnapshot GetSnapshot() const;
+
+    // blocks of metrics of threads: metrics of ended thread stay in its block which is reused by new
+    // thread, so count is the max count of threads writing metrics at the same time
+    size_t GetThreadMetricsCount() const;
+
+private:
+    struct ThreadMetrics {
+        std::array<std::atomic<uint64_t>, MAX_METRIC_COUNT> counters = {};
+        // histograms are allocated on the first measurement of thread
+        std::array<std::atomic<LatencyHistogram*>, MAX_METRIC_COUNT> histograms = {};
+        ThreadMetrics* next = nullptr;
+
+        ~ThreadMetrics();
+    };
+
+    // block of thread, released at the end of thread
+    struct ThreadMetricsHandle {
+        ThreadMetrics* metrics = nullptr;
+
+        ~ThreadMetricsHandle();
+    };
+
+    // registration and released blocks
+    mutable std::mutex mutex_;
+    std::map<std::string, size_t, std::less<>> ids_;
+
+    std::array<std::string, MAX_METRIC_COUNT> names_;
+    std::array<MetricType, MAX_METRIC_COUNT> types_ = {};
+    std::atomic<size_t> metric_count_ = 0;
+
+    // list of blocks of threads, blocks are only added
+    std::atomic<ThreadMetrics*> threads_ = nullptr;
+    size_t thread_metrics_count_ = 0;
+    // blocks of ended threads
+    std::vector<ThreadMetrics*> released_threads_;
+
+    MetricsRegistry() = default;
+    ~MetricsRegistry();
+
+    ThreadMetrics& GetThreadMetrics();
+};
+
+// adds duration of scope to timer with id
+class ScopedTimer {
+public:
+    explicit ScopedTimer(size_t id);
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer();
+
+private:
+    size_t id_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#define METRICS_CONCAT_INTERNAL(X, Y) X##Y
+#define METRICS_CONCAT(X, Y) METRICS_CONCAT_INTERNAL(X, Y)
+
+#ifndef SEARCH_SERVER_NO_METRICS
+// timer of the rest of scope, name must be the same on every call
+#define METRICS_TIMER(name) \
+    static const size_t METRICS_CONCAT(metric_id_, __LINE__) = MetricsRegistry::Instance().RegisterOrDrop(name, MetricType::TIMER); \
+    ScopedTimer METRICS_CONCAT(metric_timer_, __LINE__)(METRICS_CONCAT(metric_id_, __LINE__))
+#define METRICS_COUNT(name, value) \
+    do { \
+        static const size_t metric_id = MetricsRegistry::Instance().RegisterOrDrop(name, MetricType::COUNTER); \
+        MetricsRegistry::Instance().AddCount(metric_id, value); \
+    } while (false)
+#else
+#define METRICS_TIMER(name)
+#define METRICS_COUNT(name, value) do { (void)sizeof(value); } while (false)
+#endif
@@ -0,0 +1,42 @@
+#include "paginator.h"
+
+using namespace std;
+
+SearchPaginator::SearchPaginator(const SearchServer& server, string raw_query, size_t page_size, DocumentStatus status) :
+    server_(server), raw_query_(move(raw_query)), page_size_(page_size), status_(status) {
+    if (page_size_ == 0) {
+        throw invalid_argument("Page size must be positive"s);
+    }
+}
+
+bool SearchPaginator::HasNextPage() const {
+    return has_next_page_;
+}
+
+vector<Document> SearchPaginator::NextPage() {
+    if (!has_next_page_) {
+        return {};
+    }
+
+    // one more document shows if there is the next page
+    PageRequest page;
+    page.limit = page_size_ + 1;
+    page.search_after = cursor_;
+    vector<Document> documents = server_.FindTopDocuments(raw_query_, page, status_);
+
+    has_next_page_ = documents.size() > page_size_;
+    if (has_next_page_) {
+        documents.pop_back();
+    }
+    if (!documents.empty()) {
+        cursor_ = SearchCursor::After(documents.back());
+    }
+    return documents;
+}
+
+vector<Document> SearchPaginator::GetPage(size_t page_number) const {
+    PageRequest page;
+    page.offset = page_number * page_size_;
+    page.limit = page_size_;
+    return server_.FindTopDocuments(raw_query_, page, status_);
+}
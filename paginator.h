@@ -1,6 +1,9 @@
 #pragma once
 #include <iostream>
+#include <optional>
+#include <string>
 #include <vector>
+#include "search_server.h"
 
 //Class Page = 2 iterators [begin_; end_) of Documents
 template <typename Iterator>
@@ -103,3 +106,27 @@ auto Paginate(const Container& c, int page_size) {
     return Paginator(begin(c), end(c), page_size);
 }
 
+// Pages of search results which are found by server on demand:
+// the next page is the TOP documents after the last document of the previous page.
+class SearchPaginator {
+public:
+    SearchPaginator(const SearchServer& server, std::string raw_query, size_t page_size,
+        DocumentStatus status = DocumentStatus::ACTUAL);
+
+    bool HasNextPage() const;
+
+    // empty page if there are no more documents
+    std::vector<Document> NextPage();
+
+    // page by number (from 0), doesn't change the next page
+    std::vector<Document> GetPage(size_t page_number) const;
+
+private:
+    const SearchServer& server_;
+    const std::string raw_query_;
+    const size_t page_size_;
+    const DocumentStatus status_;
+    // the last document of the previous page
+    std::optional<SearchCursor> cursor_;
+    bool has_next_page_ = true;
+};
@@ -1,5 +1,4 @@
 #include "process_queries.h"
-#include <execution>
 
 using namespace std;
 
@@ -7,8 +6,8 @@ vector<vector<Document>> ProcessQueries( const SearchServer& search_server, cons
 	vector<vector<Document>> res;
 	res.resize(queries.size());
 
-	transform(execution::par, queries.begin(), queries.end(), res.begin(), [&search_server](const string& query) {
-		return search_server.FindTopDocuments(query);
+	search_server.GetExecutor().ParallelFor(queries.size(), [&](size_t i) {
+		res[i] = search_server.FindTopDocuments(queries[i]);
 		});
 	return res;
 }
@@ -0,0 +1,87 @@
+#include "quantized_scoring.h"
+#include <stdexcept>
+
+using namespace std;
+
+uint32_t GetImpactScale(ScoringMode mode) {
+    switch (mode) {
+    case ScoringMode::QUANTIZED_8:
+        return UINT8_MAX;
+    case ScoringMode::QUANTIZED_16:
+        return UINT16_MAX;
+    default:
+        throw invalid_argument("Scoring mode is not quantized"s);
+    }
+}
+
+uint32_t QuantizeIdf(double inverse_document_freq) {
+    return static_cast<uint32_t>(lround(max(inverse_document_freq, 0.0) * (1 << IDF_FRACTION_BITS)));
+}
+
+double GetQuantizationErrorBound(ScoringMode mode, const vector<double>& inverse_document_freqs) {
+    const double scale = GetImpactScale(mode);
+    double bound = 0;
+    for (const double inverse_document_freq : inverse_document_freqs) {
+        bound += inverse_document_freq / scale + 1.0 / (1 << IDF_FRACTION_BITS);
+    }
+    return bound;
+}
+
+QuantizedPostings::QuantizedPostings(const allocator_type& allocator) :
+    slots(allocator), impacts8(allocator), impacts16(allocator) {
+
+}
+
+void QuantizedPostings::Add(ScoringMode mode, uint32_t slot, double term_freq) {
+    slots.push_back(slot);
+    if (mode == ScoringMode::QUANTIZED_8) {
+        impacts8.push_back(QuantizeTermFreq<uint8_t>(term_freq, UINT8_MAX));
+    }
+    else {
+        impacts16.push_back(QuantizeTermFreq<uint16_t>(term_freq, UINT16_MAX));
+    }
+}
+
+void QuantizedPostings::Remove(uint32_t slot) {
+    // order of postings doesn't matter: the last one takes place of removed
+    const size_t index = find(slots.begin(), slots.end(), slot) - slots.begin();
+    slots[index] = slots.back();
+    slots.pop_back();
+    if (!impacts8.empty()) {
+        impacts8[index] = impacts8.back();
+        impacts8.pop_back();
+    }
+    else {
+        impacts16[index] = impacts16.back();
+        impacts16.pop_back();
+    }
+}
+
+bool QuantizedPostings::IsEmpty() const {
+    return slots.empty();
+}
+
+void QuantizedPostings::Renumber(const vector<uint32_t>& new_slots) {
+    for (uint32_t& slot : slots) {
+        slot = new_slots[slot];
+    }
+}
+
+ScoreAccumulator& ScoreAccumulator::ForThread(size_t slot_count) {
+    thread_local ScoreAccumulator accumulator;
+    if (accumulator.scores_.size() < slot_count) {
+        accumulator.scores_.resize(slot_count);
+        accumulator.states_.resize(slot_count);
+    }
+    return accumulator;
+}
+
+void ScoreAccumulator::Exclude(const uint32_t* slots, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t slot = slots[i];
+        if (states_[slot] == UNTOUCHED) {
+            touched_.push_back(slot);
+        }
+        states_[slot] = EXCLUDED;
+    }
+}
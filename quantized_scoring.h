@@ -0,0 +1,122 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory_resource>
+#include <type_traits>
+#include <vector>
+
+// Quantized scoring: TF is stored as 8 or 16-bit impact q = round(tf * S), S = 2^bits - 1 (q >= 1),
+// IDF is fixed point with IDF_FRACTION_BITS fractional bits, relevance = sum(q * idf_q) / (S * 2^IDF_FRACTION_BITS).
+// Error of TF is <= 1/(2S) (<= 1/S for tf < 1/(2S) which becomes 1), error of IDF is <= 2^-(IDF_FRACTION_BITS + 1),
+// so relevance of document differs from exact one by no more than
+//     sum over plus words of document (idf / S + 2^-IDF_FRACTION_BITS),
+// and documents which exact relevances differ by more than twice the bound are ranked in the same order.
+enum class ScoringMode {
+    EXACT,
+    QUANTIZED_8,
+    QUANTIZED_16,
+};
+
+const int IDF_FRACTION_BITS = 16;
+// postings which products are computed together before they are added to scores
+const size_t SCORING_BLOCK_SIZE = 64;
+
+// S of mode
+uint32_t GetImpactScale(ScoringMode mode);
+
+uint32_t QuantizeIdf(double inverse_document_freq);
+
+template <typename Impact>
+Impact QuantizeTermFreq(double term_freq, uint32_t scale) {
+    return static_cast<Impact>(std::clamp<long>(std::lround(term_freq * scale), 1, scale));
+}
+
+// bound of difference between quantized and exact relevance for words with inverse_document_freqs
+double GetQuantizationErrorBound(ScoringMode mode, const std::vector<double>& inverse_document_freqs);
+
+// postings of word in quantized index: slots of documents and impacts (of mode)
+struct QuantizedPostings {
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    explicit QuantizedPostings(const allocator_type& allocator = {});
+
+    std::pmr::vector<uint32_t> slots;
+    std::pmr::vector<uint8_t> impacts8;
+    std::pmr::vector<uint16_t> impacts16;
+
+    void Add(ScoringMode mode, uint32_t slot, double term_freq);
+    void Remove(uint32_t slot);
+    bool IsEmpty() const;
+    // slot -> new_slots[slot]
+    void Renumber(const std::vector<uint32_t>& new_slots);
+
+    // impacts8 or impacts16
+    template <typename Impact>
+    const Impact* GetImpacts() const {
+        if constexpr (std::is_same_v<Impact, uint8_t>) {
+            return impacts8.data();
+        }
+        else {
+            return impacts16.data();
+        }
+    }
+};
+
+// scores of slots of documents, one per thread (cleared after query)
+class ScoreAccumulator {
+public:
+    enum State : uint8_t {
+        UNTOUCHED,
+        SCORED,
+        EXCLUDED,
+    };
+
+    static ScoreAccumulator& ForThread(size_t slot_count);
+
+    // products of block are computed without dependencies (vectorized), then added to scores
+    template <typename Impact>
+    void Accumulate(const uint32_t* slots, const Impact* impacts, size_t count, uint32_t inverse_document_freq);
+
+    void Exclude(const uint32_t* slots, size_t count);
+
+    // calling function(slot, score) for scored and not excluded slots, clearing scores
+    template <typename Function>
+    void Collect(Function function);
+
+private:
+    std::vector<uint64_t> scores_;
+    std::vector<uint8_t> states_;
+    std::vector<uint32_t> touched_;
+};
+
+template <typename Impact>
+void ScoreAccumulator::Accumulate(const uint32_t* slots, const Impact* impacts, size_t count, uint32_t inverse_document_freq) {
+    uint64_t products[SCORING_BLOCK_SIZE];
+    for (size_t begin = 0; begin < count; begin += SCORING_BLOCK_SIZE) {
+        const size_t size = std::min(SCORING_BLOCK_SIZE, count - begin);
+        for (size_t i = 0; i < size; ++i) {
+            products[i] = static_cast<uint64_t>(impacts[begin + i]) * inverse_document_freq;
+        }
+        for (size_t i = 0; i < size; ++i) {
+            const uint32_t slot = slots[begin + i];
+            scores_[slot] += products[i];
+            if (states_[slot] == UNTOUCHED) {
+                states_[slot] = SCORED;
+                touched_.push_back(slot);
+            }
+        }
+    }
+}
+
+template <typename Function>
+void ScoreAccumulator::Collect(Function function) {
+    for (const uint32_t slot : touched_) {
+        if (states_[slot] == SCORED) {
+            function(slot, scores_[slot]);
+        }
+        scores_[slot] = 0;
+        states_[slot] = UNTOUCHED;
+    }
+    touched_.clear();
+}
@@ -0,0 +1,43 @@
+#include "query_arena.h"
+#include <memory>
+#include <optional>
+
+using namespace std;
+
+namespace {
+
+struct ThreadArena {
+    unique_ptr<byte[]> buffer;
+    optional<pmr::monotonic_buffer_resource> resource;
+    int depth = 0;
+};
+
+ThreadArena& GetThreadArena() {
+    thread_local ThreadArena arena;
+    return arena;
+}
+
+}
+
+QueryArenaScope::QueryArenaScope() {
+    ThreadArena& arena = GetThreadArena();
+    if (arena.depth++ == 0) {
+        if (!arena.buffer) {
+            arena.buffer = make_unique<byte[]>(QUERY_ARENA_BUFFER_SIZE);
+        }
+        arena.resource.emplace(arena.buffer.get(), QUERY_ARENA_BUFFER_SIZE, pmr::new_delete_resource());
+    }
+}
+
+QueryArenaScope::~QueryArenaScope() {
+    ThreadArena& arena = GetThreadArena();
+    if (--arena.depth == 0) {
+        // memory taken from heap is released, the buffer is reused by the next query
+        arena.resource.reset();
+    }
+}
+
+pmr::memory_resource* GetQueryResource() {
+    ThreadArena& arena = GetThreadArena();
+    return arena.depth > 0 ? &*arena.resource : pmr::get_default_resource();
+}
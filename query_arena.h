@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+
+// bytes of buffer of arena which are allocated once per thread, larger queries take memory from heap
+const size_t QUERY_ARENA_BUFFER_SIZE = 64 * 1024;
+
+// scope of query on current thread: while it is active temporaries of query are allocated in monotonic
+// arena of thread (deallocation does nothing), arena is reset when the outermost scope of thread ends;
+// memory of arena must not be used after the scope or by other threads after it
+class QueryArenaScope {
+public:
+    QueryArenaScope();
+    ~QueryArenaScope();
+
+    QueryArenaScope(const QueryArenaScope&) = delete;
+    QueryArenaScope& operator=(const QueryArenaScope&) = delete;
+};
+
+// arena of active scope of current thread or default resource if there is no scope
+std::pmr::memory_resource* GetQueryResource();
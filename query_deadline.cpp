@@ -0,0 +1,38 @@
+#include "query_deadline.h"
+
+using namespace std;
+
+QueryDeadline QueryDeadline::After(chrono::steady_clock::duration timeout, ExpiryPolicy on_expiry) {
+    return { chrono::steady_clock::now() + timeout, nullopt, on_expiry };
+}
+
+QueryDeadlineCheck::QueryDeadlineCheck(const QueryDeadline& deadline) :
+    deadline_(deadline) {
+
+}
+
+bool QueryDeadlineCheck::IsExpired() const {
+    if (is_expired_.load(memory_order_relaxed)) {
+        return true;
+    }
+    if ((deadline_.time && chrono::steady_clock::now() >= *deadline_.time)
+        || (deadline_.cancellation && deadline_.cancellation->IsCancelled())) {
+        is_expired_.store(true, memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool QueryDeadlineCheck::WasExpired() const {
+    return is_expired_.load(memory_order_relaxed);
+}
+
+void QueryDeadlineCheck::ThrowIfExpired() const {
+    if (!WasExpired() || deadline_.on_expiry != ExpiryPolicy::THROW) {
+        return;
+    }
+    if (deadline_.cancellation && deadline_.cancellation->IsCancelled()) {
+        throw TaskCancelledError("Query is cancelled"s);
+    }
+    throw QueryTimeoutError("Deadline of query has passed"s);
+}
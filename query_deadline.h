@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include "thread_pool.h"
+
+// postings scored between checks of deadline of query
+const size_t QUERY_CHECK_BLOCK_SIZE = 1024;
+
+// what query does when its deadline passes or it is cancelled
+enum class ExpiryPolicy {
+    // TOP of documents scored before expiry (rarer words are scored first), flagged as partial
+    PARTIAL,
+    // QueryTimeoutError or TaskCancelledError
+    THROW,
+};
+
+// thrown when deadline of query passes before it is done
+class QueryTimeoutError : public TaskCancelledError {
+public:
+    using TaskCancelledError::TaskCancelledError;
+};
+
+// limits of query: it is stopped at the next block of postings after time or cancellation of token
+struct QueryDeadline {
+    std::optional<std::chrono::steady_clock::time_point> time;
+    std::optional<CancellationToken> cancellation;
+    ExpiryPolicy on_expiry = ExpiryPolicy::PARTIAL;
+
+    // deadline in timeout from now
+    static QueryDeadline After(std::chrono::steady_clock::duration timeout, ExpiryPolicy on_expiry = ExpiryPolicy::PARTIAL);
+};
+
+// state of deadline of one query, shared by its tasks
+class QueryDeadlineCheck {
+public:
+    explicit QueryDeadlineCheck(const QueryDeadline& deadline);
+
+    // checking clock and token, the first expiry is remembered
+    bool IsExpired() const;
+    // expiry found by previous checks
+    bool WasExpired() const;
+
+    // throwing error of expiry if it was found and policy is THROW
+    void ThrowIfExpired() const;
+
+private:
+    const QueryDeadline& deadline_;
+    mutable std::atomic<bool> is_expired_ = false;
+};
@@ -0,0 +1,97 @@
+#include "query_log.h"
+#include "binary_io.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const string QUERY_LOG_MAGIC = "SSQL"s;
+
+} // namespace
+
+QueryLogWriter::QueryLogWriter(ostream& output, Clock::time_point start) :
+    output_(output), start_(start) {
+    output_.write(QUERY_LOG_MAGIC.data(), QUERY_LOG_MAGIC.size());
+    WriteUint(output_, QUERY_LOG_VERSION, sizeof(uint32_t));
+}
+
+void QueryLogWriter::Write(const QueryLogRecord& record) {
+    if (record.query.size() > MAX_LOGGED_QUERY_SIZE) {
+        lock_guard lock(mutex_);
+        ++dropped_record_count_;
+        return;
+    }
+    // record is encoded out of lock
+    ostringstream buffer;
+    WriteUint(buffer, record.time.count(), sizeof(uint64_t));
+    WriteUint(buffer, static_cast<uint8_t>(record.filter), sizeof(uint8_t));
+    WriteUint(buffer, static_cast<uint8_t>(record.status), sizeof(uint8_t));
+    WriteUint(buffer, record.result_count, sizeof(uint32_t));
+    WriteString(buffer, record.query);
+    const string data = buffer.str();
+
+    lock_guard lock(mutex_);
+    output_.write(data.data(), data.size());
+    ++record_count_;
+}
+
+void QueryLogWriter::Write(QueryLogRecord record, Clock::time_point time) {
+    record.time = chrono::duration_cast<chrono::microseconds>(max(time, start_) - start_);
+    Write(record);
+}
+
+void QueryLogWriter::Flush() {
+    lock_guard lock(mutex_);
+    output_.flush();
+}
+
+size_t QueryLogWriter::GetRecordCount() const {
+    lock_guard lock(mutex_);
+    return record_count_;
+}
+
+size_t QueryLogWriter::GetDroppedRecordCount() const {
+    lock_guard lock(mutex_);
+    return dropped_record_count_;
+}
+
+QueryLogReader::QueryLogReader(istream& input) :
+    input_(input) {
+    string magic(QUERY_LOG_MAGIC.size(), '\0');
+    if (!input_.read(magic.data(), magic.size()) || magic != QUERY_LOG_MAGIC) {
+        throw invalid_argument("Stream isn't query log"s);
+    }
+    if (ReadUint(input_, sizeof(uint32_t)) != QUERY_LOG_VERSION) {
+        throw invalid_argument("Unknown version of query log"s);
+    }
+}
+
+optional<QueryLogRecord> QueryLogReader::Next() {
+    if (input_.peek() == istream::traits_type::eof()) {
+        return nullopt;
+    }
+    QueryLogRecord record;
+    record.time = chrono::microseconds(ReadUint(input_, sizeof(uint64_t)));
+    const uint64_t filter = ReadUint(input_, sizeof(uint8_t));
+    const uint64_t status = ReadUint(input_, sizeof(uint8_t));
+    if (filter > static_cast<uint8_t>(QueryFilter::PREDICATE) || status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+        throw invalid_argument("Broken record of query log"s);
+    }
+    record.filter = static_cast<QueryFilter>(filter);
+    record.status = static_cast<DocumentStatus>(status);
+    record.result_count = ReadUint(input_, sizeof(uint32_t));
+    record.query = ReadString(input_, MAX_LOGGED_QUERY_SIZE);
+    return record;
+}
+
+vector<QueryLogRecord> ReadQueryLog(istream& input) {
+    QueryLogReader reader(input);
+    vector<QueryLogRecord> records;
+    while (auto record = reader.Next()) {
+        records.push_back(move(*record));
+    }
+    return records;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "document.h"
+
+// Binary log of find requests, integers are little-endian:
+// header: "SSQL" | u32 version
+// record: u64 time_us | u8 filter | u8 status | u32 result_count | u32 size | query bytes
+
+const uint32_t QUERY_LOG_VERSION = 1;
+const size_t MAX_LOGGED_QUERY_SIZE = 1 << 20;
+
+// filter of logged request: predicates can't be saved, they are replayed without filter
+enum class QueryFilter : uint8_t {
+    STATUS,
+    PREDICATE,
+};
+
+struct QueryLogRecord {
+    // time of request since start of log (see QueryLogWriter)
+    std::chrono::microseconds time{ 0 };
+    QueryFilter filter = QueryFilter::STATUS;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    uint32_t result_count = 0;
+    std::string query;
+};
+
+// Writer of log shared by threads (e.g. by several RequestQueues), stream must outlive it.
+class QueryLogWriter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // header is written at once, times of records are counted from start
+    explicit QueryLogWriter(std::ostream& output, Clock::time_point start = Clock::now());
+
+    // record with its time, query longer than MAX_LOGGED_QUERY_SIZE is dropped (reader would reject it)
+    void Write(const QueryLogRecord& record);
+    // record of request at time (earlier than start - at start)
+    void Write(QueryLogRecord record, Clock::time_point time);
+
+    void Flush();
+
+    size_t GetRecordCount() const;
+    // records dropped for too long query
+    size_t GetDroppedRecordCount() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::ostream& output_;
+    const Clock::time_point start_;
+    size_t record_count_ = 0;
+    size_t dropped_record_count_ = 0;
+};
+
+class QueryLogReader {
+public:
+    // throws invalid_argument if stream isn't log of known version
+    explicit QueryLogReader(std::istream& input);
+
+    // next record or nullopt at the end of log, throws invalid_argument if record is broken
+    std::optional<QueryLogRecord> Next();
+
+private:
+    std::istream& input_;
+};
+
+// all records of log
+std::vector<QueryLogRecord> ReadQueryLog(std::istream& input);
@@ -0,0 +1,112 @@
+#include "query_protocol.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const size_t SIZE_FIELD = sizeof(uint32_t);
+const size_t DOCUMENT_SIZE = sizeof(int32_t) + sizeof(double) + sizeof(int32_t);
+
+void AppendUint(string& buffer, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint64_t ReadUint(string_view& buffer, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(buffer[i])) << (8 * i);
+    }
+    buffer.remove_prefix(bytes);
+    return value;
+}
+
+// size of complete frame or 0, frame body is left in buffer
+size_t ReadFrame(string_view& buffer, size_t min_body_size) {
+    if (buffer.size() < SIZE_FIELD) {
+        return 0;
+    }
+    const size_t body_size = ReadUint(buffer, SIZE_FIELD);
+    if (body_size > MAX_FRAME_SIZE || body_size < min_body_size) {
+        throw invalid_argument("Broken frame size"s);
+    }
+    if (buffer.size() < body_size) {
+        return 0;
+    }
+    buffer = buffer.substr(0, body_size);
+    return SIZE_FIELD + body_size;
+}
+
+// writing size of frame started at position start
+void FinishFrame(string& buffer, size_t start) {
+    const uint64_t body_size = buffer.size() - start - SIZE_FIELD;
+    for (size_t i = 0; i < SIZE_FIELD; ++i) {
+        buffer[start + i] = static_cast<char>((body_size >> (8 * i)) & 0xFF);
+    }
+}
+
+} // namespace
+
+void AppendRequest(string& buffer, const QueryRequest& request) {
+    const size_t start = buffer.size();
+    AppendUint(buffer, 0, SIZE_FIELD);
+    AppendUint(buffer, request.request_id, sizeof(uint32_t));
+    AppendUint(buffer, static_cast<uint8_t>(request.status), sizeof(uint8_t));
+    buffer += request.query;
+    FinishFrame(buffer, start);
+}
+
+void AppendResponse(string& buffer, const QueryResponse& response) {
+    const size_t start = buffer.size();
+    AppendUint(buffer, 0, SIZE_FIELD);
+    AppendUint(buffer, response.request_id, sizeof(uint32_t));
+    AppendUint(buffer, static_cast<uint8_t>(response.result), sizeof(uint8_t));
+    AppendUint(buffer, response.documents.size(), sizeof(uint32_t));
+    for (const Document& document : response.documents) {
+        uint64_t relevance;
+        memcpy(&relevance, &document.relevance, sizeof(relevance));
+        AppendUint(buffer, static_cast<uint32_t>(document.id), sizeof(int32_t));
+        AppendUint(buffer, relevance, sizeof(double));
+        AppendUint(buffer, static_cast<uint32_t>(document.rating), sizeof(int32_t));
+    }
+    FinishFrame(buffer, start);
+}
+
+size_t ReadRequest(string_view buffer, QueryRequest& request) {
+    const size_t frame_size = ReadFrame(buffer, sizeof(uint32_t) + sizeof(uint8_t));
+    if (frame_size == 0) {
+        return 0;
+    }
+    request.request_id = static_cast<uint32_t>(ReadUint(buffer, sizeof(uint32_t)));
+    const auto status = ReadUint(buffer, sizeof(uint8_t));
+    if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+        throw invalid_argument("Broken document status"s);
+    }
+    request.status = static_cast<DocumentStatus>(status);
+    request.query = buffer;
+    return frame_size;
+}
+
+size_t ReadResponse(string_view buffer, QueryResponse& response) {
+    const size_t frame_size = ReadFrame(buffer, sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t));
+    if (frame_size == 0) {
+        return 0;
+    }
+    response.request_id = static_cast<uint32_t>(ReadUint(buffer, sizeof(uint32_t)));
+    response.result = static_cast<QueryResult>(ReadUint(buffer, sizeof(uint8_t)));
+    const size_t count = ReadUint(buffer, sizeof(uint32_t));
+    if (buffer.size() != count * DOCUMENT_SIZE) {
+        throw invalid_argument("Broken count of documents"s);
+    }
+    response.documents.resize(count);
+    for (Document& document : response.documents) {
+        document.id = static_cast<int32_t>(ReadUint(buffer, sizeof(int32_t)));
+        const uint64_t relevance = ReadUint(buffer, sizeof(double));
+        memcpy(&document.relevance, &relevance, sizeof(relevance));
+        document.rating = static_cast<int32_t>(ReadUint(buffer, sizeof(int32_t)));
+    }
+    return frame_size;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "document.h"
+
+// Binary frames of query service, integers are little-endian:
+// request:  u32 size | u32 request_id | u8 status | query bytes
+// response: u32 size | u32 request_id | u8 result | u32 count | count * (i32 id | f64 relevance | i32 rating)
+// size - count of bytes after size field
+
+const size_t MAX_FRAME_SIZE = 1 << 20;
+
+enum class QueryResult : uint8_t {
+    OK,
+    INVALID_QUERY,
+    // query failed for other reason (out of memory, etc.)
+    SERVER_ERROR,
+};
+
+struct QueryRequest {
+    uint32_t request_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::string query;
+};
+
+struct QueryResponse {
+    uint32_t request_id = 0;
+    QueryResult result = QueryResult::OK;
+    std::vector<Document> documents;
+};
+
+// adding frame to the end of buffer
+void AppendRequest(std::string& buffer, const QueryRequest& request);
+void AppendResponse(std::string& buffer, const QueryResponse& response);
+
+// reading the first frame of buffer: size of frame or 0 if frame is not complete
+// throws invalid_argument if frame is broken
+size_t ReadRequest(std::string_view buffer, QueryRequest& request);
+size_t ReadResponse(std::string_view buffer, QueryResponse& response);
@@ -0,0 +1,498 @@
+#include "query_service.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+using namespace std;
+
+struct QueryService::Connection {
+    explicit Connection(int fd_) : fd(fd_) {
+    }
+
+    const int fd;
+
+    // used by event loop only
+    string input;
+    string output;
+    size_t in_flight = 0;
+    uint32_t events = 0;
+    bool closed = false;
+    // client has shut down its sending side: buffered requests are answered, then connection is closed
+    bool read_closed = false;
+
+    // filled by workers
+    mutex ready_mutex;
+    string ready_output;
+    size_t ready_count = 0;
+};
+
+static void ThrowSystemError(const string& what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+QueryService::QueryService(const SearchServer& search_server, QueryServiceConfig config) :
+    server_(search_server), config_(config) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        ThrowSystemError("epoll_create1"s);
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        close(epoll_fd_);
+        ThrowSystemError("eventfd"s);
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+
+    workers_ = make_unique<ThreadPool>(config_.worker_count, config_.max_queue_size);
+}
+
+QueryService::~QueryService() {
+    // workers use connections and wake_fd_
+    workers_.reset();
+    for (const auto& [fd, _] : connections_) {
+        close(fd);
+    }
+    for (int fd : listen_fds_) {
+        close(fd);
+    }
+    close(wake_fd_);
+    close(epoll_fd_);
+}
+
+uint16_t QueryService::ListenTcp(const string& address, uint16_t port) {
+    sockaddr_in socket_address{};
+    socket_address.sin_family = AF_INET;
+    socket_address.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) != 1) {
+        throw invalid_argument("Invalid IPv4 address "s + address);
+    }
+
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket"s);
+    }
+    const int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    socklen_t length = sizeof(socket_address);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&socket_address), length) < 0
+        || listen(fd, SOMAXCONN) < 0
+        || getsockname(fd, reinterpret_cast<sockaddr*>(&socket_address), &length) < 0) {
+        const int error = errno;
+        close(fd);
+        throw system_error(error, generic_category(), "listen "s + address);
+    }
+    AddListener(fd);
+    return ntohs(socket_address.sin_port);
+}
+
+void QueryService::ListenUnix(const string& path) {
+    sockaddr_un socket_address{};
+    socket_address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(socket_address.sun_path)) {
+        throw invalid_argument("Too long Unix socket path "s + path);
+    }
+    strcpy(socket_address.sun_path, path.c_str());
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("socket"s);
+    }
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&socket_address), sizeof(socket_address)) < 0
+        || listen(fd, SOMAXCONN) < 0) {
+        const int error = errno;
+        close(fd);
+        throw system_error(error, generic_category(), "listen "s + path);
+    }
+    AddListener(fd);
+}
+
+void QueryService::Run() {
+    vector<epoll_event> events(64);
+    while (!stopped_) {
+        const int count = epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait"s);
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == wake_fd_) {
+                uint64_t value;
+                [[maybe_unused]] auto _ = read(wake_fd_, &value, sizeof(value));
+                CollectResponses();
+                continue;
+            }
+            if (find(listen_fds_.begin(), listen_fds_.end(), fd) != listen_fds_.end()) {
+                Accept(fd);
+                continue;
+            }
+
+            const auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            const auto connection = it->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                Close(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                Read(*connection);
+                if (connection->closed) {
+                    continue;
+                }
+                DispatchRequests(connection);
+            }
+            if (events[i].events & EPOLLOUT) {
+                Write(*connection);
+            }
+            if (!connection->closed) {
+                UpdateEvents(*connection);
+            }
+        }
+    }
+}
+
+void QueryService::Stop() {
+    stopped_ = true;
+    Wake();
+}
+
+void QueryService::AddListener(int fd) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+        const int error = errno;
+        close(fd);
+        throw system_error(error, generic_category(), "epoll_ctl"s);
+    }
+    listen_fds_.push_back(fd);
+}
+
+void QueryService::Accept(int listen_fd) {
+    while (true) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return; // EAGAIN or client has gone
+        }
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)); // fails for Unix sockets
+
+        auto connection = make_shared<Connection>(fd);
+        connection->events = EPOLLIN;
+        epoll_event event{};
+        event.events = connection->events;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            continue;
+        }
+        connections_.emplace(fd, move(connection));
+    }
+}
+
+void QueryService::Read(Connection& connection) {
+    char buffer[64 * 1024];
+    // not complete frame can't be greater than MAX_FRAME_SIZE
+    while (connection.input.size() <= MAX_FRAME_SIZE) {
+        const ssize_t size = recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (size > 0) {
+            connection.input.append(buffer, size);
+            continue;
+        }
+        if (size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size == 0) {
+            connection.read_closed = true;
+            return;
+        }
+        Close(connection.fd);
+        return;
+    }
+}
+
+void QueryService::Write(Connection& connection) {
+    size_t sent = 0;
+    while (sent < connection.output.size()) {
+        const ssize_t size = send(connection.fd, connection.output.data() + sent, connection.output.size() - sent, MSG_NOSIGNAL);
+        if (size >= 0) {
+            sent += size;
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        Close(connection.fd);
+        return;
+    }
+    connection.output.erase(0, sent);
+}
+
+void QueryService::Close(int fd) {
+    const auto it = connections_.find(fd);
+    if (it == connections_.end()) {
+        return;
+    }
+    it->second->closed = true;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    waiting_fds_.erase(fd);
+    connections_.erase(it);
+}
+
+void QueryService::DispatchRequests(const shared_ptr<Connection>& connection) {
+    waiting_fds_.erase(connection->fd);
+
+    size_t dispatched = 0;
+    while (connection->in_flight < config_.max_in_flight) {
+        vector<QueryRequest> batch;
+        size_t batch_end = dispatched;
+        while (batch.size() < config_.max_batch_size && connection->in_flight + batch.size() < config_.max_in_flight) {
+            QueryRequest request;
+            size_t size = 0;
+            try {
+                size = ReadRequest(string_view(connection->input).substr(batch_end), request);
+            }
+            catch (const invalid_argument&) {
+                Close(connection->fd);
+                return;
+            }
+            if (size == 0) {
+                break;
+            }
+            batch_end += size;
+            batch.push_back(move(request));
+        }
+        if (batch.empty()) {
+            break;
+        }
+
+        const size_t batch_size = batch.size();
+        // back-pressure: requests stay in input, connection isn't read until workers are free
+        if (!workers_->TrySubmit([this, connection, batch = move(batch)] { ProcessBatch(connection, batch); })) {
+            waiting_fds_.insert(connection->fd);
+            break;
+        }
+        connection->in_flight += batch_size;
+        dispatched = batch_end;
+    }
+    connection->input.erase(0, dispatched);
+}
+
+void QueryService::ProcessBatch(const shared_ptr<Connection>& connection, const vector<QueryRequest>& batch) {
+    string output;
+    for (const QueryRequest& request : batch) {
+        QueryResponse response;
+        response.request_id = request.request_id;
+        try {
+            response.documents = server_.FindTopDocuments(request.query, request.status);
+        }
+        catch (const invalid_argument&) {
+            response.result = QueryResult::INVALID_QUERY;
+        }
+        catch (const exception&) {
+            // every request gets response, so in_flight of connection is decremented
+            response.documents.clear();
+            response.result = QueryResult::SERVER_ERROR;
+        }
+        AppendResponse(output, response);
+    }
+
+    {
+        lock_guard guard(connection->ready_mutex);
+        connection->ready_output += output;
+        connection->ready_count += batch.size();
+    }
+    {
+        lock_guard guard(ready_mutex_);
+        ready_connections_.push_back(connection);
+    }
+    Wake();
+}
+
+void QueryService::CollectResponses() {
+    vector<shared_ptr<Connection>> ready_connections;
+    {
+        lock_guard guard(ready_mutex_);
+        ready_connections.swap(ready_connections_);
+    }
+
+    for (const auto& connection : ready_connections) {
+        if (connection->closed) {
+            continue;
+        }
+        {
+            lock_guard guard(connection->ready_mutex);
+            connection->output += connection->ready_output;
+            connection->ready_output.clear();
+            connection->in_flight -= connection->ready_count;
+            connection->ready_count = 0;
+        }
+        Write(*connection);
+        if (connection->closed) {
+            continue;
+        }
+        DispatchRequests(connection);
+        if (!connection->closed) {
+            UpdateEvents(*connection);
+        }
+    }
+
+    // workers have taken some tasks, so queue may have space
+    const vector<int> waiting_fds(waiting_fds_.begin(), waiting_fds_.end());
+    for (int fd : waiting_fds) {
+        const auto it = connections_.find(fd);
+        if (it == connections_.end()) {
+            continue;
+        }
+        const auto connection = it->second;
+        DispatchRequests(connection);
+        if (!connection->closed) {
+            UpdateEvents(*connection);
+        }
+    }
+}
+
+void QueryService::UpdateEvents(Connection& connection) {
+    // the rest of input of half-closed connection is not complete frame when nothing is in flight or waiting
+    if (connection.read_closed && connection.in_flight == 0 && waiting_fds_.count(connection.fd) == 0
+        && connection.output.empty()) {
+        Close(connection.fd);
+        return;
+    }
+    const bool can_read = !connection.read_closed
+        && connection.in_flight < config_.max_in_flight
+        && waiting_fds_.count(connection.fd) == 0
+        && connection.input.size() <= MAX_FRAME_SIZE;
+    const uint32_t events = (can_read ? static_cast<uint32_t>(EPOLLIN) : 0u) | (connection.output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    if (events == connection.events) {
+        return;
+    }
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = connection.fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+void QueryService::Wake() {
+    const uint64_t value = 1;
+    [[maybe_unused]] auto _ = write(wake_fd_, &value, sizeof(value));
+}
+
+QueryClient::QueryClient(const string& address, uint16_t port) {
+    sockaddr_in socket_address{};
+    socket_address.sin_family = AF_INET;
+    socket_address.sin_port = htons(port);
+    if (inet_pton(AF_INET, address.c_str(), &socket_address.sin_addr) != 1) {
+        throw invalid_argument("Invalid IPv4 address "s + address);
+    }
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        ThrowSystemError("socket"s);
+    }
+    if (connect(fd_, reinterpret_cast<sockaddr*>(&socket_address), sizeof(socket_address)) < 0) {
+        const int error = errno;
+        close(fd_);
+        throw system_error(error, generic_category(), "connect "s + address);
+    }
+    const int enable = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+QueryClient::QueryClient(const string& path) {
+    sockaddr_un socket_address{};
+    socket_address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(socket_address.sun_path)) {
+        throw invalid_argument("Too long Unix socket path "s + path);
+    }
+    strcpy(socket_address.sun_path, path.c_str());
+    fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        ThrowSystemError("socket"s);
+    }
+    if (connect(fd_, reinterpret_cast<sockaddr*>(&socket_address), sizeof(socket_address)) < 0) {
+        const int error = errno;
+        close(fd_);
+        throw system_error(error, generic_category(), "connect "s + path);
+    }
+}
+
+QueryClient::~QueryClient() {
+    close(fd_);
+}
+
+void QueryClient::Send(const QueryRequest& request) {
+    Send(vector<QueryRequest>{ request });
+}
+
+void QueryClient::Send(const vector<QueryRequest>& requests) {
+    string output;
+    for (const QueryRequest& request : requests) {
+        AppendRequest(output, request);
+    }
+    size_t sent = 0;
+    while (sent < output.size()) {
+        const ssize_t size = send(fd_, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("send"s);
+        }
+        sent += size;
+    }
+}
+
+QueryResponse QueryClient::Receive() {
+    char buffer[64 * 1024];
+    while (true) {
+        QueryResponse response;
+        const size_t size = ReadResponse(input_, response);
+        if (size > 0) {
+            input_.erase(0, size);
+            return response;
+        }
+        const ssize_t received = recv(fd_, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0) {
+            ThrowSystemError("recv"s);
+        }
+        if (received == 0) {
+            throw runtime_error("Connection is closed by service"s);
+        }
+        input_.append(buffer, received);
+    }
+}
+
+void QueryClient::CloseSending() {
+    if (shutdown(fd_, SHUT_WR) < 0) {
+        ThrowSystemError("shutdown"s);
+    }
+}
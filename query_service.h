@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "query_protocol.h"
+#include "search_server.h"
+#include "thread_pool.h"
+
+struct QueryServiceConfig {
+    // threads calling FindTopDocuments
+    size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+    // batches of requests waiting for workers, connections aren't read while queue is full
+    size_t max_queue_size = 1024;
+    // requests of one connection processed by one task
+    size_t max_batch_size = 32;
+    // requests of one connection without response, connection isn't read while limit is reached
+    size_t max_in_flight = 256;
+};
+
+// Network frontend of SearchServer (Linux, epoll).
+// Clients may send requests without waiting for responses (pipelining),
+// responses are matched with requests by request_id and may come in other order.
+class QueryService {
+public:
+    explicit QueryService(const SearchServer& search_server, QueryServiceConfig config = {});
+
+    QueryService(const QueryService&) = delete;
+    QueryService& operator=(const QueryService&) = delete;
+
+    ~QueryService();
+
+    // listening to TCP port (0 - any free port), returns port
+    uint16_t ListenTcp(const std::string& address, uint16_t port);
+
+    // listening to Unix socket, file of socket is replaced
+    void ListenUnix(const std::string& path);
+
+    // event loop, returns after Stop()
+    void Run();
+
+    // can be called from any thread
+    void Stop();
+
+private:
+    struct Connection;
+
+    const SearchServer& server_;
+    const QueryServiceConfig config_;
+
+    int epoll_fd_ = -1;
+    // wakes event loop when responses are ready or service is stopped
+    int wake_fd_ = -1;
+    std::vector<int> listen_fds_;
+    std::atomic<bool> stopped_ = false;
+
+    // event loop data
+    std::map<int, std::shared_ptr<Connection>> connections_;
+
+    // connections with requests which were not sent to workers because of full queue
+    std::set<int> waiting_fds_;
+
+    // connections with responses from workers
+    std::mutex ready_mutex_;
+    std::vector<std::shared_ptr<Connection>> ready_connections_;
+
+    std::unique_ptr<ThreadPool> workers_;
+
+    void AddListener(int fd);
+    void Accept(int listen_fd);
+    void Read(Connection& connection);
+    void Write(Connection& connection);
+    void Close(int fd);
+
+    // sending complete requests to workers as batches while limits allow
+    void DispatchRequests(const std::shared_ptr<Connection>& connection);
+    void ProcessBatch(const std::shared_ptr<Connection>& connection, const std::vector<QueryRequest>& batch);
+    void CollectResponses();
+
+    // subscribing to reading/writing according to connection state, half-closed connection is closed
+    // when all its responses are sent
+    void UpdateEvents(Connection& connection);
+    void Wake();
+};
+
+// blocking client of QueryService
+class QueryClient {
+public:
+    // connecting to TCP port
+    QueryClient(const std::string& address, uint16_t port);
+    // connecting to Unix socket
+    explicit QueryClient(const std::string& path);
+
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    ~QueryClient();
+
+    void Send(const QueryRequest& request);
+
+    // sending all requests by one write
+    void Send(const std::vector<QueryRequest>& requests);
+
+    // waiting for the next response
+    QueryResponse Receive();
+
+    // shutting down sending side: service answers requests already sent, then closes connection
+    void CloseSending();
+
+private:
+    int fd_ = -1;
+    std::string input_;
+};
@@ -3,7 +3,7 @@
 
 using namespace std; 
 
-set<string_view> ExtractKeys(const map<string_view, double>& words) { // w * O(log w)
+set<string_view> ExtractKeys(const WordFrequencies& words) { // w * O(log w)
     set<string_view> keys;
     for (const auto& [word, _] : words) { //w
         keys.insert(word); // O(log w)
@@ -3,6 +3,6 @@
 #include <map>
 #include "search_server.h"
 
-std::set<std::string_view> ExtractKeys(const std::map<std::string_view, double>& words);
+std::set<std::string_view> ExtractKeys(const WordFrequencies& words);
 void RemoveDuplicates(SearchServer& search_server);
 
@@ -1,39 +1,132 @@
 #include "request_queue.h"
+#include <stdexcept>
+#include <thread>
 
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server) :
-    server_(search_server), time_(0), empty_requests_(0) {
+uint64_t RequestStats::GetLatencyPercentile(double percentile) const {
+    const double rank = percentile * request_count;
+    uint64_t count = 0;
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+        count += latency_histogram[i];
+        if (count > 0 && count >= rank) {
+            return uint64_t(1) << i;
+        }
+    }
+    return 0;
+}
 
+RequestQueue::RequestQueue(const SearchServer& search_server, RequestQueueConfig config) :
+    server_(search_server), config_(move(config)), start_(config_.clock()) {
+    if (config_.bucket_count == 0 || config_.bucket_duration.count() <= 0) {
+        throw invalid_argument("Window of request queue must not be empty"s);
+    }
+    buckets_ = make_unique<Bucket[]>(config_.bucket_count);
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
+    const auto start_time = config_.clock();
     auto request = server_.FindTopDocuments(raw_query, status);
-    NewRequest(request);
+    NewRequest(request, start_time, raw_query, QueryFilter::STATUS, status);
     return request;
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
+    const auto start_time = config_.clock();
     auto request = server_.FindTopDocuments(raw_query);
-    NewRequest(request);
+    NewRequest(request, start_time, raw_query, QueryFilter::STATUS, DocumentStatus::ACTUAL);
     return request;
 }
 
 size_t RequestQueue::GetNoResultRequests() const {
-    return empty_requests_;
+    return GetStats().no_result_count;
 }
 
-void RequestQueue::NewRequest(vector<Document> request) {
-    ++time_;
-    while (!requests_.empty() && min_in_day_ <= time_ - requests_.front().request_time) {
-        if (requests_.front().empty) {
-            --empty_requests_;
+RequestStats RequestQueue::GetStats() const {
+    const auto now = config_.clock();
+    const int64_t epoch = GetEpoch(now);
+    const int64_t bucket_count = config_.bucket_count;
+
+    RequestStats stats;
+    for (size_t i = 0; i < config_.bucket_count; ++i) {
+        const Bucket& bucket = buckets_[i];
+        const int64_t bucket_epoch = bucket.epoch.load(memory_order_acquire);
+        if (bucket_epoch < 0 || bucket_epoch <= epoch - bucket_count || bucket_epoch > epoch) {
+            continue;
+        }
+        stats.request_count += bucket.request_count.load(memory_order_relaxed);
+        stats.no_result_count += bucket.no_result_count.load(memory_order_relaxed);
+        for (size_t j = 0; j < LATENCY_BUCKET_COUNT; ++j) {
+            stats.latency_histogram[j] += bucket.latency_histogram[j].load(memory_order_relaxed);
         }
-        requests_.pop_front();
     }
-    bool isEmpty = request.empty();
-    if (isEmpty) {
-        ++empty_requests_;
+
+    const chrono::duration<double> window = config_.bucket_duration * config_.bucket_count;
+    const chrono::duration<double> elapsed = now - start_;
+    const double seconds = min(window, elapsed).count();
+    if (seconds > 0) {
+        stats.qps = stats.request_count / seconds;
+    }
+    if (stats.request_count > 0) {
+        stats.no_result_rate = static_cast<double>(stats.no_result_count) / stats.request_count;
+    }
+    return stats;
+}
+
+int64_t RequestQueue::GetEpoch(Clock::time_point time) const {
+    return (time - start_) / config_.bucket_duration;
+}
+
+RequestQueue::Bucket* RequestQueue::AcquireBucket(int64_t epoch) {
+    Bucket& bucket = buckets_[epoch % config_.bucket_count];
+    int64_t bucket_epoch = bucket.epoch.load(memory_order_acquire);
+    while (bucket_epoch != epoch) {
+        if (bucket_epoch > epoch) {
+            return nullptr; // request is older than the window
+        }
+        if (bucket_epoch != RESETTING && bucket.epoch.compare_exchange_weak(bucket_epoch, RESETTING, memory_order_acquire)) {
+            bucket.request_count.store(0, memory_order_relaxed);
+            bucket.no_result_count.store(0, memory_order_relaxed);
+            for (auto& count : bucket.latency_histogram) {
+                count.store(0, memory_order_relaxed);
+            }
+            bucket.epoch.store(epoch, memory_order_release);
+            break;
+        }
+        if (bucket_epoch == RESETTING) {
+            this_thread::yield(); // other thread is clearing the bucket
+            bucket_epoch = bucket.epoch.load(memory_order_acquire);
+        }
+    }
+    return &bucket;
+}
+
+void RequestQueue::NewRequest(const vector<Document>& request, Clock::time_point start_time, const string& raw_query,
+    QueryFilter filter, DocumentStatus status) {
+    const auto end_time = config_.clock();
+    if (config_.query_log) {
+        QueryLogRecord record;
+        record.filter = filter;
+        record.status = status;
+        record.result_count = request.size();
+        record.query = raw_query;
+        config_.query_log->Write(move(record), start_time);
+    }
+
+    Bucket* bucket = AcquireBucket(GetEpoch(end_time));
+    if (!bucket) {
+        return;
+    }
+
+    const uint64_t latency_us = chrono::duration_cast<chrono::microseconds>(end_time - start_time).count();
+    size_t latency_bucket = 0;
+    while (latency_bucket + 1 < LATENCY_BUCKET_COUNT && (uint64_t(1) << latency_bucket) <= latency_us) {
+        ++latency_bucket;
+    }
+
+    bucket->request_count.fetch_add(1, memory_order_relaxed);
+    if (request.empty()) {
+        bucket->no_result_count.fetch_add(1, memory_order_relaxed);
     }
-    requests_.push_back({ time_, isEmpty });
+    bucket->latency_histogram[latency_bucket].fetch_add(1, memory_order_relaxed);
 }
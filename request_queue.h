@@ -1,13 +1,52 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <vector>
-#include <deque>
 #include <string>
 #include "search_server.h"
 #include "document.h"
+#include "query_log.h"
 
+// histogram buckets of latency: bucket 0 - less than 1 us, bucket i - [2^(i-1), 2^i) us
+const size_t LATENCY_BUCKET_COUNT = 32;
+
+struct RequestQueueConfig {
+    using Clock = std::chrono::steady_clock;
+
+    // window of statistics = bucket_count * bucket_duration
+    std::chrono::milliseconds bucket_duration = std::chrono::seconds(1);
+    size_t bucket_count = 60;
+    // source of time (may be replaced in tests)
+    std::function<Clock::time_point()> clock = Clock::now;
+    // log of requests (may be shared by queues), times of records are counted from start of writer
+    // (by this clock); nullptr - requests aren't logged
+    QueryLogWriter* query_log = nullptr;
+};
+
+// statistics of requests of the last window
+struct RequestStats {
+    size_t request_count = 0;
+    size_t no_result_count = 0;
+    // requests per second over the window (or over time since start if it is shorter)
+    double qps = 0;
+    double no_result_rate = 0;
+    // counts of requests by LATENCY_BUCKET_COUNT buckets of latency
+    std::array<uint64_t, LATENCY_BUCKET_COUNT> latency_histogram = {};
+
+    // upper bound of latency (us) of the bucket where percentile (0..1) of requests is reached
+    uint64_t GetLatencyPercentile(double percentile) const;
+};
+
+// Queue of find requests with statistics over sliding window of wall-clock time.
+// AddFindRequest may be called from many threads: requests are counted in ring buffer
+// of time buckets by atomic counters, the bucket is cleared by the first request of new time.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    explicit RequestQueue(const SearchServer& search_server, RequestQueueConfig config = {});
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
@@ -16,26 +55,42 @@ public:
 
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
+    // requests of the window without result
     size_t GetNoResultRequests() const;
 
+    RequestStats GetStats() const;
+
 private:
-    struct QueryResult {
-        size_t request_time;
-        bool empty;
+    using Clock = RequestQueueConfig::Clock;
+
+    struct Bucket {
+        // number of bucket duration since start, RESETTING while bucket is cleared
+        std::atomic<int64_t> epoch = -1;
+        std::atomic<uint64_t> request_count = 0;
+        std::atomic<uint64_t> no_result_count = 0;
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT> latency_histogram = {};
     };
 
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
+    static constexpr int64_t RESETTING = -2;
+
     const SearchServer& server_;
-    size_t time_;
-    size_t empty_requests_;
+    const RequestQueueConfig config_;
+    const Clock::time_point start_;
+    std::unique_ptr<Bucket[]> buckets_;
+
+    int64_t GetEpoch(Clock::time_point time) const;
+
+    // bucket of epoch cleared if it has older requests, nullptr if it already has newer ones
+    Bucket* AcquireBucket(int64_t epoch);
 
-    void NewRequest(std::vector<Document> request);
+    void NewRequest(const std::vector<Document>& request, Clock::time_point start_time, const std::string& raw_query,
+        QueryFilter filter, DocumentStatus status);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    const auto start_time = config_.clock();
     auto request = server_.FindTopDocuments(raw_query, document_predicate);
-    NewRequest(request);
+    NewRequest(request, start_time, raw_query, QueryFilter::PREDICATE, DocumentStatus::ACTUAL);
     return request;
 }
@@ -1,25 +1,56 @@
 #include "search_server.h"
 #include "string_processing.h"
+#include "binary_io.h"
 #include <numeric>
 #include <cmath>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
 
 using namespace std;
 
-SearchServer::SearchServer(const string& text) {
+namespace {
+
+// snapshot: "SSNP" | u32 version | u8 flags | u32 count | count * stop-word | u32 count | count * document,
+// document: i32 id | u8 status | i32 rating | text, strings are u32 size | bytes; version 1 has no flags
+const string SNAPSHOT_MAGIC = "SSNP"s;
+const uint32_t SNAPSHOT_VERSION = 2;
+// stop-words are of shared dictionary, server is loaded attached to it
+const uint8_t SNAPSHOT_SHARED_DICTIONARY = 1;
+const size_t MAX_SNAPSHOT_STRING_SIZE = 1 << 26;
+
+} // namespace
+
+SearchServer::SearchServer(const string& text, shared_ptr<Executor> executor, pmr::memory_resource* memory_resource) :
+    memory_(make_unique<MemoryResources>(memory_resource)),
+    executor_(MakeExecutor(move(executor))) {
     for (const auto& word : SplitIntoWords(text)) {
         if (!IsValidWord(word)) {
             throw invalid_argument("Invalid stop-word (contains symbols from 0 to 31)");
         }
-        stop_words_.insert(static_cast<string>(word));
+        stop_words_.emplace(word);
+    }
+}
+
+SearchServer::SearchServer(shared_ptr<const SharedDictionary> dictionary, shared_ptr<Executor> executor,
+    pmr::memory_resource* memory_resource) :
+    memory_(make_unique<MemoryResources>(memory_resource)),
+    dictionary_(move(dictionary)),
+    executor_(MakeExecutor(move(executor))) {
+    if (!dictionary_) {
+        throw invalid_argument("Dictionary of server must not be nullptr");
     }
 }
 
-SearchServer::SearchServer(string_view text) {
+SearchServer::SearchServer(string_view text, shared_ptr<Executor> executor, pmr::memory_resource* memory_resource) :
+    memory_(make_unique<MemoryResources>(memory_resource)),
+    executor_(MakeExecutor(move(executor))) {
     for (const auto& word : SplitIntoWords(text)) {
         if (!IsValidWord(word)) {
             throw invalid_argument("Invalid stop-word (contains symbols from 0 to 31)");
         }
-        stop_words_.insert(static_cast<string>(word));
+        stop_words_.emplace(word);
     }
 }
 
@@ -28,74 +59,337 @@ void SearchServer::AddDocument(int document_id, string_view document, const Docu
         throw invalid_argument("Document ID is wrong (below 0)");
     }
 
-    if (documents_.count(document_id) > 0) {
+    if (document_ordinals_.count(document_id) > 0) {
         throw invalid_argument("Document ID has already been created");
     }
 
-    DocumentData data{ ComputeAverageRating(ratings), status, static_cast<string>(document) };
-    documents_.emplace(document_id, data);
-    order_of_adding_.insert(document_id);
+    const auto text = document_texts_.emplace(document_texts_.end(), document);
+    vector<string_view> words;
+    try {
+        words = SplitIntoWordsNoStop(*text);
+    }
+    catch (...) {
+        document_texts_.erase(text);
+        throw;
+    }
 
-    const vector<string_view> words = SplitIntoWordsNoStop(documents_.at(document_id).text);
-    const double inv_word_count = 1.0 / words.size();
+    // duplicates are found before document is added
+    vector<string_view> unique_words;
+    uint64_t signature = 0;
+    if (duplicate_policy_ != DuplicatePolicy::NONE) {
+        unique_words = words;
+        RemoveDuplicates(unique_words);
+        signature = ComputeSignature(unique_words);
+        const vector<DocumentOrdinal> duplicates = FindDuplicates(signature, unique_words);
+        if (!duplicates.empty() && duplicate_policy_ == DuplicatePolicy::REJECT) {
+            document_texts_.erase(text);
+            throw DuplicateDocumentError(document_id, documents_[duplicates.front()].id);
+        }
+        if (duplicate_policy_ == DuplicatePolicy::REPLACE) {
+            vector<int> duplicate_ids;
+            for (const DocumentOrdinal duplicate : duplicates) {
+                duplicate_ids.push_back(documents_[duplicate].id);
+            }
+            // ordinals can be compacted by removal
+            for (const int duplicate_id : duplicate_ids) {
+                RemoveDocument(duplicate_id);
+            }
+        }
+    }
 
+    // the next ordinal keeps order of adding
+    const DocumentOrdinal ordinal = static_cast<DocumentOrdinal>(documents_.size());
+    documents_.push_back({ document_id, ComputeAverageRating(ratings), status, text });
+    if (ordinal % FILTER_BLOCK_SIZE == 0) {
+        filter_blocks_.emplace_back();
+    }
+    filter_blocks_.back().Add(status, documents_.back().rating);
+    document_ordinals_.emplace(document_id, ordinal);
+    WordFrequencies& word_freqs = document_to_word_freqs_.emplace_back();
+
+    const double inv_word_count = 1.0 / words.size();
     for (const auto& word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word] += inv_word_count;
+        const auto [it, is_new_word] = word_to_document_freqs_.try_emplace(InternWord(word));
+        it->second[ordinal] += inv_word_count;
+        word_freqs[word] += inv_word_count;
+        if (is_new_word && fuzzy_index_) {
+            fuzzy_index_->Add(it->first);
+        }
+    }
+
+    // new keys of additional indexes view the same strings as keys of word_to_document_freqs_ do
+    if (scoring_mode_ != ScoringMode::EXACT) {
+        for (const auto& [word, term_freq] : word_freqs) {
+            word_to_quantized_postings_[InternWord(word)].Add(scoring_mode_, ordinal, term_freq);
+        }
     }
+    if (impact_ordered_) {
+        for (const auto& [word, term_freq] : word_freqs) {
+            word_to_impact_postings_[InternWord(word)].insert({ term_freq, ordinal });
+        }
+    }
+    if (bloom_parameters_) {
+        document_filters_.push_back(BuildDocumentFilter(ordinal));
+    }
+    AddToHotTerms(ordinal);
+    if (duplicate_policy_ != DuplicatePolicy::NONE) {
+        AddSignature(ordinal, signature, unique_words);
+    }
+}
+
+SearchServer::MemoryResources::MemoryResources(pmr::memory_resource* upstream) :
+    stop_words(upstream), inverted_index(upstream), forward_index(upstream), quantized_index(upstream),
+    impact_index(upstream), duplicate_index(upstream), bloom_filters(upstream), fuzzy_index(upstream), document_texts(upstream), document_metadata(upstream) {
 
-    documents_.emplace(document_id, move(data));
-    order_of_adding_.insert(document_id);
 }
 
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const DocumentStatus& status) const {
-    return FindTopDocuments(raw_query,
+SearchServer::DocumentIdIterator SearchServer::begin() const {
+    return DocumentIdIterator(documents_.data(), documents_.data() + documents_.size());
+}
+
+SearchServer::DocumentIdIterator SearchServer::end() const {
+    return DocumentIdIterator(documents_.data() + documents_.size(), documents_.data() + documents_.size());
+}
+
+SearchServer::DocumentIdIterator::DocumentIdIterator(const DocumentData* current, const DocumentData* end) :
+    current_(current), end_(end) {
+    SkipRemoved();
+}
+
+SearchServer::DocumentIdIterator::reference SearchServer::DocumentIdIterator::operator*() const {
+    return current_->id;
+}
+
+SearchServer::DocumentIdIterator& SearchServer::DocumentIdIterator::operator++() {
+    ++current_;
+    SkipRemoved();
+    return *this;
+}
+
+SearchServer::DocumentIdIterator SearchServer::DocumentIdIterator::operator++(int) {
+    DocumentIdIterator old = *this;
+    ++*this;
+    return old;
+}
+
+bool SearchServer::DocumentIdIterator::operator==(const DocumentIdIterator& other) const {
+    return current_ == other.current_;
+}
+
+bool SearchServer::DocumentIdIterator::operator!=(const DocumentIdIterator& other) const {
+    return current_ != other.current_;
+}
+
+void SearchServer::DocumentIdIterator::SkipRemoved() {
+    while (current_ != end_ && current_->id == REMOVED_DOCUMENT_ID) {
+        ++current_;
+    }
+}
+
+template <typename Words>
+void RemoveDuplicateWords(Words& vec, Executor* executor) {
+    if (executor) {
+        ParallelSort(*executor, vec.begin(), vec.end(), less<string_view>());
+    }
+    else {
+        sort(vec.begin(), vec.end());
+    }
+    vec.erase(unique(vec.begin(), vec.end()), vec.end());
+}
+
+void RemoveDuplicates(vector<string_view>& vec, Executor* executor) {
+    RemoveDuplicateWords(vec, executor);
+}
+
+void RemoveDuplicates(QueryWords& vec, Executor* executor) {
+    RemoveDuplicateWords(vec, executor);
+}
+
+void SelectTopDocuments(vector<Document>& documents, Executor* executor, size_t count) {
+    if (executor) {
+        ParallelSort(*executor, documents.begin(), documents.end(), IsMoreRelevant);
+    }
+    else if (documents.size() > count) {
+        nth_element(documents.begin(), documents.begin() + count, documents.end(), IsMoreRelevant);
+        sort(documents.begin(), documents.begin() + count, IsMoreRelevant);
+    }
+    else {
+        sort(documents.begin(), documents.end(), IsMoreRelevant);
+    }
+    if (documents.size() > count) {
+        documents.resize(count);
+    }
+}
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        if (lhs.rating == rhs.rating) {
+            return lhs.id < rhs.id;
+        }
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+DuplicateDocumentError::DuplicateDocumentError(int document_id, int original_id) :
+    invalid_argument("Document "s + to_string(document_id) + " is a duplicate of document "s + to_string(original_id)),
+    original_id_(original_id) {
+
+}
+
+int DuplicateDocumentError::GetOriginalId() const {
+    return original_id_;
+}
+
+SearchCursor SearchCursor::After(const Document& document) {
+    return { document.relevance, document.rating, document.id };
+}
+
+string SearchCursor::ToString() const {
+    // hexadecimal relevance is exact
+    ostringstream out;
+    out << hexfloat << relevance << ':' << rating << ':' << id;
+    return out.str();
+}
+
+SearchCursor SearchCursor::FromString(string_view text) {
+    const string data(text);
+    SearchCursor cursor;
+    char* end = nullptr;
+    cursor.relevance = strtod(data.c_str(), &end);
+    int length = 0;
+    if (end == data.c_str() || sscanf(end, ":%d:%d%n", &cursor.rating, &cursor.id, &length) != 2
+        || end + length != data.c_str() + data.size()) {
+        throw invalid_argument("Invalid search cursor"s);
+    }
+    return cursor;
+}
+
+string QueryPlan::ToString() const {
+    ostringstream out;
+    for (const QueryPlanStep& step : steps) {
+        out << (step.is_minus ? "exclude \""s : step.is_skipped ? "skip \""s : "score \""s) << step.word << "\": "s;
+        if (step.posting_count == 0) {
+            out << "not in index"s;
+        }
+        else {
+            out << step.posting_count << " postings"s;
+            if (!step.is_minus) {
+                out << ", idf "s << step.inverse_document_freq << (step.is_skipped ? ", all excluded"s : ""s);
+            }
+        }
+        out << (step.is_required ? ", required"s : ""s) << '\n';
+    }
+    out << "excluded documents: "s << excluded_document_count << '\n';
+    return out.str();
+}
+
+vector<Document> SearchServer::FindTopDocuments(const AdaptivePolicy& policy, string_view raw_query, const DocumentStatus& status) const {
+    return FindTopDocuments(policy, raw_query, StatusPredicate{ status });
+}
+
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const PageRequest& page, const DocumentStatus& status) const {
+    return FindTopDocuments(raw_query, page,
         [status](const int document_id, const DocumentStatus& local_status, const int rating) {
             return status == local_status;
         });
 }
 
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, const DocumentStatus& status) const {
+    return FindTopDocuments(execution::seq, raw_query, status);
+}
+
 //REMOVE
 /*vector<Document>SearchServer::FindTopDocuments(string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }*/
 
-size_t SearchServer::GetDocumentCount() const {
-    return documents_.size();
+future<vector<Document>> SearchServer::FindTopDocumentsAsync(string raw_query, const DocumentStatus& status, QueryTaskOptions options) const {
+    return FindTopDocumentsAsync(move(raw_query),
+        [status](const int document_id, const DocumentStatus& local_status, const int rating) {
+            return status == local_status;
+        },
+        move(options));
 }
 
-tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, const int document_id) const {
-    if (!documents_.count(document_id)) {
-        throw out_of_range("Document ID is not found"s);
-    }
+void SearchServer::SetThreadPool(size_t thread_count, size_t max_queue_size) {
+    executor_ = make_shared<ThreadPool>(thread_count, max_queue_size);
+}
 
-    Query query = ParseQuery(raw_query);
+const shared_ptr<const SharedDictionary>& SearchServer::GetDictionary() const {
+    return dictionary_;
+}
 
-    RemoveDuplicates(execution::seq, query.minus_words);
-    RemoveDuplicates(execution::seq, query.plus_words);
+Executor& SearchServer::GetExecutor() const {
+    return *executor_;
+}
 
-    vector<string_view> matched_words;
+void SearchServer::SetCostModel(const ExecutionCostModel& model) {
+    cost_model_ = model;
+}
 
-    for (const auto& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { matched_words, documents_.at(document_id).status };
+const ExecutionCostModel& SearchServer::GetCostModel() const {
+    return cost_model_;
+}
+
+double SearchServer::EstimateQueryCost(string_view raw_query) const {
+    QueryArenaScope arena;
+    Query query = ParseQuery(raw_query);
+    RemoveDuplicates(query.minus_words);
+    RemoveDuplicates(query.plus_words);
+    return EstimateQueryCost(query);
+}
+
+size_t SearchServer::GetAdaptiveFanOut(string_view raw_query) const {
+    return ChooseFanOut(EstimateQueryCost(raw_query));
+}
+
+double SearchServer::EstimateQueryCost(const Query& query) const {
+    double cost = 0;
+    for (const auto& words : { &query.plus_words, &query.minus_words }) {
+        for (const string_view word : *words) {
+            cost += cost_model_.word_cost;
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end()) {
+                cost += it->second.size();
+            }
         }
     }
+    return cost;
+}
 
-    matched_words.reserve(query.plus_words.size());
-    for (const auto& word : query.plus_words) {
+size_t SearchServer::ChooseFanOut(double cost) const {
+    if (cost < cost_model_.parallel_threshold) {
+        return 1;
+    }
+    const double task_count = cost / max(cost_model_.cost_per_task, 1.0);
+    const size_t concurrency = executor_->GetConcurrency();
+    return max<size_t>(2, task_count < concurrency ? static_cast<size_t>(task_count) : concurrency);
+}
 
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
-        }        
+shared_ptr<Executor> SearchServer::MakeExecutor(shared_ptr<Executor> executor) {
+    if (executor) {
+        return executor;
     }
-    return { matched_words, documents_.at(document_id).status };
+    ThreadPoolConfig config;
+    config.max_queue_size = MAX_QUEUED_QUERY_COUNT;
+    return make_shared<ThreadPool>(config);
+}
+
+size_t SearchServer::GetDocumentCount() const {
+    return document_ordinals_.size();
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, const int document_id) const {
+    const DocumentOrdinal ordinal = GetOrdinal(document_id);
+    QueryArenaScope arena;
+
+    Query query = ParseQuery(raw_query);
+
+    RemoveDuplicates(query.minus_words);
+    RemoveDuplicates(query.plus_words);
+
+    return MatchQuery(query, ordinal);
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy& policy, string_view raw_query, const int document_id) const {
@@ -103,59 +397,111 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const exe
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy& policy, string_view raw_query, const int document_id) const {
-    if (!documents_.count(document_id)) {
-        throw out_of_range("Document ID is not found"s);
-    }
-
-    Query query = ParseQuery(raw_query);
+    const DocumentOrdinal ordinal = GetOrdinal(document_id);
+    QueryArenaScope arena;
+    return MatchQueryParallel(ParseQuery(raw_query), ordinal);
+}
 
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchQueryParallel(const Query& query, DocumentOrdinal ordinal) const {
     vector<string_view> matched_words;
     
-    auto& words = document_to_word_freqs_.at(document_id);
+    auto& words = document_to_word_freqs_[ordinal];
 
-    if (any_of(policy, query.minus_words.begin(),
-        query.minus_words.end(),
-        [&words](string_view word) {
-            return words.count(word);
-        })) {
-        return { matched_words, documents_.at(document_id).status };
+    atomic<bool> has_minus_word = false;
+    executor_->ParallelFor(query.minus_words.size(),
+        [&](size_t i) {
+            if (!has_minus_word.load(memory_order_relaxed) && MayContainWord(ordinal, query.minus_words[i])
+                && words.count(query.minus_words[i])) {
+                has_minus_word = true;
+            }
+        });
+    if (has_minus_word) {
+        return { matched_words, documents_[ordinal].status };
     }
 
-    matched_words.resize(query.plus_words.size());
+    for (const auto& word : query.required_words) {
+        if (words.count(word) == 0) {
+            return { matched_words, documents_[ordinal].status };
+        }
+    }
+    for (const auto& group : query.required_groups) {
+        if (none_of(group.begin(), group.end(), [&words](string_view word) { return words.count(word) > 0; })) {
+            return { matched_words, documents_[ordinal].status };
+        }
+    }
 
-    auto last = copy_if(policy, query.plus_words.begin(),
-        query.plus_words.end(),
-        matched_words.begin(),
-        [&words](string_view word) {
-            return words.count(word);
+    pmr::vector<char> is_matched(query.plus_words.size(), GetQueryResource());
+    executor_->ParallelFor(query.plus_words.size(),
+        [&](size_t i) {
+            is_matched[i] = MayContainWord(ordinal, query.plus_words[i]) && words.count(query.plus_words[i]) > 0;
         });
 
-    matched_words.erase(last, matched_words.end());
-    RemoveDuplicates(policy, matched_words);
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (is_matched[i]) {
+            matched_words.push_back(query.plus_words[i]);
+        }
+    }
+    RemoveDuplicates(matched_words, executor_.get());
+
+    return { matched_words, documents_[ordinal].status };
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const AdaptivePolicy& policy, string_view raw_query, const int document_id) const {
+    const DocumentOrdinal ordinal = GetOrdinal(document_id);
+    QueryArenaScope arena;
+
+    Query query = ParseQuery(raw_query);
+
+    const double lookup_cost = cost_model_.word_cost + log2(document_to_word_freqs_[ordinal].size() + 1);
+    const double cost = (query.plus_words.size() + query.minus_words.size()) * lookup_cost;
+    if (cost >= cost_model_.match_parallel_threshold) {
+        return MatchQueryParallel(query, ordinal);
+    }
+
+    RemoveDuplicates(query.minus_words);
+    RemoveDuplicates(query.plus_words);
 
-    return { matched_words, documents_.at(document_id).status };
+    return MatchQuery(query, ordinal);
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    if (document_to_word_freqs_.find(document_id) == document_to_word_freqs_.end()) {
-        static const map<string_view, double> empty_map;
+const WordFrequencies& SearchServer::GetWordFrequencies(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        static const WordFrequencies empty_map;
         return empty_map;
     }
 
-    return document_to_word_freqs_.at(document_id);
+    return document_to_word_freqs_[it->second];
+}
+
+MemoryUsage SearchServer::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.stop_words = memory_->stop_words.GetAllocatedBytes();
+    usage.inverted_index = memory_->inverted_index.GetAllocatedBytes();
+    usage.forward_index = memory_->forward_index.GetAllocatedBytes();
+    usage.quantized_index = memory_->quantized_index.GetAllocatedBytes();
+    usage.impact_index = memory_->impact_index.GetAllocatedBytes();
+    usage.duplicate_index = memory_->duplicate_index.GetAllocatedBytes();
+    usage.bloom_filters = memory_->bloom_filters.GetAllocatedBytes();
+    usage.fuzzy_index = memory_->fuzzy_index.GetAllocatedBytes();
+    usage.document_texts = memory_->document_texts.GetAllocatedBytes();
+    usage.document_metadata = memory_->document_metadata.GetAllocatedBytes();
+    return usage;
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    if (order_of_adding_.find(document_id) == order_of_adding_.end()) {
+    const auto it = document_ordinals_.find(document_id); // O(1)
+    if (it == document_ordinals_.end()) {
         return;
     }
 
-    order_of_adding_.erase(document_id); // O(log N)
-    documents_.erase(document_id); // O (log N)
-    for (const auto& [word, _] : document_to_word_freqs_.at(document_id)) { // w
-        word_to_document_freqs_[word].erase(document_id); // O(log W) search word + O(log N) erase doc
+    const DocumentOrdinal ordinal = it->second;
+    for (const auto& [word, _] : document_to_word_freqs_[ordinal]) { // w
+        word_to_document_freqs_.at(word).erase(ordinal); // O(log W) search word + O(log N) erase doc
+        RemoveAdditionalPostings(word, ordinal); // O(log W + log N), O(postings) for quantized
+        DetachWord(word); // O(log W)
     }
-    document_to_word_freqs_.erase(document_id); //O(log N)
+    ReleaseOrdinal(ordinal); // text is released after all views on it are detached
 }
 
 void SearchServer::RemoveDocument(const execution::sequenced_policy& policy, int document_id) {
@@ -163,30 +509,709 @@ void SearchServer::RemoveDocument(const execution::sequenced_policy& policy, int
 }
 
 void SearchServer::RemoveDocument(const execution::parallel_policy& policy, int document_id) {
-    if (order_of_adding_.find(document_id) == order_of_adding_.end()) {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
         return;
     }
-
-    order_of_adding_.erase(document_id); // O(log N)
-    documents_.erase(document_id); // O (log N)
+    const DocumentOrdinal ordinal = it->second;
 
     vector<string_view> words;
-    words.resize(document_to_word_freqs_.at(document_id).size());
-    transform(document_to_word_freqs_.at(document_id).begin(), 
-        document_to_word_freqs_.at(document_id).end(), 
+    words.resize(document_to_word_freqs_[ordinal].size());
+    transform(document_to_word_freqs_[ordinal].begin(), 
+        document_to_word_freqs_[ordinal].end(), 
         words.begin(), 
         [](std::pair<string_view, double> p) {
             return p.first; 
         });
 
-    std::for_each(policy,
-        words.begin(),
-        words.end(),
-        [&](string_view str) {
-            word_to_document_freqs_[str].erase(document_id);
+    // postings are extracted in parallel and freed by this thread: resource of index may be not thread-safe
+    vector<DocumentFreqs::node_type> postings(words.size());
+    executor_->ParallelFor(words.size(),
+        [&](size_t i) {
+            postings[i] = word_to_document_freqs_.find(words[i])->second.extract(ordinal);
+        });
+    postings.clear();
+
+    // changes structure of inverted index, so it can't be parallel
+    for (string_view word : words) {
+        RemoveAdditionalPostings(word, ordinal);
+        DetachWord(word);
+    }
+
+    ReleaseOrdinal(ordinal);
+}
+
+void SearchServer::SetPrefixExpansionLimit(size_t limit) {
+    prefix_expansion_limit_ = limit;
+}
+
+void SearchServer::SetScoringMode(ScoringMode mode) {
+    word_to_quantized_postings_.clear();
+    scoring_mode_ = mode;
+    if (mode == ScoringMode::EXACT) {
+        return;
+    }
+    for (const auto& [word, document_freqs] : word_to_document_freqs_) {
+        QuantizedPostings& postings = word_to_quantized_postings_[word];
+        for (const auto& [ordinal, term_freq] : document_freqs) {
+            postings.Add(mode, ordinal, term_freq);
+        }
+    }
+}
+
+ScoringMode SearchServer::GetScoringMode() const {
+    return scoring_mode_;
+}
+
+void SearchServer::SetMatchMode(MatchMode mode) {
+    match_mode_ = mode;
+}
+
+MatchMode SearchServer::GetMatchMode() const {
+    return match_mode_;
+}
+
+QueryPlan SearchServer::ExplainQuery(string_view raw_query) const {
+    QueryArenaScope arena;
+    Query query = ParseQuery(raw_query);
+    RemoveDuplicates(query.minus_words);
+    RemoveDuplicates(query.plus_words);
+
+    const Plan plan = PlanQuery(query,
+        [this](string_view word) {
+            return ComputeWordInverseDocumentFreq(word);
         });
+    QueryPlan result;
+    for (const auto* steps : { &plan.minus_words, &plan.plus_words }) {
+        for (const PlannedWord& step : *steps) {
+            result.steps.push_back({ string(step.word), steps == &plan.minus_words, step.postings ? step.postings->size() : 0,
+                step.inverse_document_freq, step.is_skipped, step.is_required });
+        }
+    }
+    result.excluded_document_count = plan.excluded_document_count;
+    return result;
+}
 
-    document_to_word_freqs_.erase(document_id); //O(log N)
+double SearchServer::GetScoreErrorBound(string_view raw_query) const {
+    if (scoring_mode_ == ScoringMode::EXACT) {
+        return 0;
+    }
+    QueryArenaScope arena;
+    Query query = ParseQuery(raw_query);
+    RemoveDuplicates(query.plus_words);
+
+    vector<double> inverse_document_freqs;
+    for (const string_view word : query.plus_words) {
+        if (word_to_document_freqs_.count(word) > 0) {
+            inverse_document_freqs.push_back(ComputeWordInverseDocumentFreq(word));
+        }
+    }
+    return GetQuantizationErrorBound(scoring_mode_, inverse_document_freqs);
+}
+
+void SearchServer::SetImpactOrderedPostings(bool enabled) {
+    word_to_impact_postings_.clear();
+    impact_ordered_ = enabled;
+    if (!enabled) {
+        return;
+    }
+    for (const auto& [word, document_freqs] : word_to_document_freqs_) {
+        ImpactPostings& postings = word_to_impact_postings_[word];
+        for (const auto& [ordinal, term_freq] : document_freqs) {
+            postings.insert({ term_freq, ordinal });
+        }
+    }
+}
+
+bool SearchServer::HasImpactOrderedPostings() const {
+    return impact_ordered_;
+}
+
+bool SearchServer::IsImpactOrderedQuery(const Query& query) const {
+    return impact_ordered_ && scoring_mode_ == ScoringMode::EXACT && !query.HasRequiredWords() && query.word_weights.empty()
+        && !query.plus_words.empty() && query.plus_words.size() <= MAX_IMPACT_ORDERED_WORD_COUNT;
+}
+
+void SearchServer::SetFuzzySearch(const FuzzySearchOptions& options) {
+    if (options.max_distance > MAX_FUZZY_DISTANCE) {
+        throw invalid_argument("Edit distance of typo-tolerant search is too large"s);
+    }
+    if (!(options.penalty > 0 && options.penalty <= 1)) {
+        throw invalid_argument("Penalty of typo-tolerant search must be in (0, 1]"s);
+    }
+    fuzzy_index_.reset();
+    fuzzy_options_ = options;
+    if (options.max_distance == 0) {
+        return;
+    }
+    fuzzy_index_.emplace(options.max_distance, &memory_->fuzzy_index);
+    for (const auto& [word, _] : word_to_document_freqs_) {
+        fuzzy_index_->Add(word);
+    }
+}
+
+const FuzzySearchOptions& SearchServer::GetFuzzySearchOptions() const {
+    return fuzzy_options_;
+}
+
+void SearchServer::SetBloomFilters(double false_positive_rate) {
+    document_filters_.clear();
+    document_filters_.shrink_to_fit();
+    bloom_parameters_.reset();
+    if (false_positive_rate == 0) {
+        return;
+    }
+    bloom_parameters_.emplace(false_positive_rate);
+    document_filters_.reserve(documents_.size());
+    for (DocumentOrdinal ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        document_filters_.push_back(BuildDocumentFilter(ordinal));
+    }
+}
+
+double SearchServer::GetBloomFilterRate() const {
+    return bloom_parameters_ ? bloom_parameters_->false_positive_rate : 0;
+}
+
+void SearchServer::SaveSnapshot(ostream& output) const {
+    output.write(SNAPSHOT_MAGIC.data(), SNAPSHOT_MAGIC.size());
+    WriteUint(output, SNAPSHOT_VERSION, sizeof(uint32_t));
+    WriteUint(output, dictionary_ ? SNAPSHOT_SHARED_DICTIONARY : 0, sizeof(uint8_t));
+    if (dictionary_) {
+        WriteUint(output, dictionary_->GetStopWords().size(), sizeof(uint32_t));
+        for (const string_view word : dictionary_->GetStopWords()) {
+            WriteString(output, word);
+        }
+    }
+    else {
+        WriteUint(output, stop_words_.size(), sizeof(uint32_t));
+        for (const auto& word : stop_words_) {
+            WriteString(output, word);
+        }
+    }
+    WriteUint(output, document_ordinals_.size(), sizeof(uint32_t));
+    for (const DocumentData& data : documents_) {
+        if (data.id == REMOVED_DOCUMENT_ID) {
+            continue;
+        }
+        WriteUint(output, static_cast<uint32_t>(data.id), sizeof(int32_t));
+        WriteUint(output, static_cast<uint8_t>(data.status), sizeof(uint8_t));
+        WriteUint(output, static_cast<uint32_t>(data.rating), sizeof(int32_t));
+        WriteString(output, *data.text);
+    }
+    if (!output) {
+        throw runtime_error("Failed to write snapshot"s);
+    }
+}
+
+SearchServer SearchServer::LoadSnapshot(istream& input, shared_ptr<Executor> executor, pmr::memory_resource* memory_resource) {
+    return LoadSnapshot(input, nullptr, move(executor), memory_resource);
+}
+
+SearchServer SearchServer::LoadSnapshot(istream& input, shared_ptr<const SharedDictionary> dictionary,
+    shared_ptr<Executor> executor, pmr::memory_resource* memory_resource) {
+    string magic(SNAPSHOT_MAGIC.size(), '\0');
+    if (!input.read(magic.data(), magic.size()) || magic != SNAPSHOT_MAGIC) {
+        throw invalid_argument("Stream isn't snapshot of search server"s);
+    }
+    const uint64_t version = ReadUint(input, sizeof(uint32_t));
+    if (version == 0 || version > SNAPSHOT_VERSION) {
+        throw invalid_argument("Unknown version of snapshot"s);
+    }
+    const uint64_t flags = version > 1 ? ReadUint(input, sizeof(uint8_t)) : 0;
+    if ((flags & SNAPSHOT_SHARED_DICTIONARY) && !dictionary) {
+        throw invalid_argument("Snapshot of server attached to dictionary is loaded without it"s);
+    }
+    // count of broken snapshot may be huge, so words are read one by one
+    vector<string> stop_words;
+    const size_t stop_word_count = ReadUint(input, sizeof(uint32_t));
+    for (size_t i = 0; i < stop_word_count; ++i) {
+        stop_words.push_back(ReadString(input, MAX_SNAPSHOT_STRING_SIZE));
+    }
+    if (dictionary) {
+        sort(stop_words.begin(), stop_words.end());
+        if (!equal(stop_words.begin(), stop_words.end(), dictionary->GetStopWords().begin(), dictionary->GetStopWords().end())) {
+            throw invalid_argument("Stop-words of snapshot differ from stop-words of dictionary"s);
+        }
+    }
+    SearchServer server = dictionary ? SearchServer(move(dictionary), move(executor), memory_resource)
+        : SearchServer(stop_words, move(executor), memory_resource);
+
+    const size_t document_count = ReadUint(input, sizeof(uint32_t));
+    for (size_t i = 0; i < document_count; ++i) {
+        const int id = static_cast<int32_t>(ReadUint(input, sizeof(int32_t)));
+        const uint64_t status = ReadUint(input, sizeof(uint8_t));
+        if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+            throw invalid_argument("Broken status of document in snapshot"s);
+        }
+        // average of one rating is the rating
+        const int rating = static_cast<int32_t>(ReadUint(input, sizeof(int32_t)));
+        const string text = ReadString(input, MAX_SNAPSHOT_STRING_SIZE);
+        server.AddDocument(id, text, static_cast<DocumentStatus>(status), { rating });
+    }
+    return server;
+}
+
+bool SearchServer::MayContainWord(DocumentOrdinal ordinal, string_view word) const {
+    return !bloom_parameters_ || document_filters_[ordinal].MayContain(HashBloomKey(word));
+}
+
+BlockedBloomFilter SearchServer::BuildDocumentFilter(DocumentOrdinal ordinal) const {
+    const WordFrequencies& word_freqs = document_to_word_freqs_[ordinal];
+    BlockedBloomFilter filter(word_freqs.size(), *bloom_parameters_, document_filters_.get_allocator());
+    for (const auto& [word, _] : word_freqs) {
+        filter.Add(HashBloomKey(word));
+    }
+    return filter;
+}
+
+void SearchServer::SetDuplicatePolicy(DuplicatePolicy policy) {
+    // buckets of hash table are released only with it
+    signature_to_documents_ = decltype(signature_to_documents_)(&memory_->duplicate_index);
+    duplicates_.clear();
+    duplicate_policy_ = policy;
+    if (policy == DuplicatePolicy::NONE) {
+        return;
+    }
+    for (DocumentOrdinal ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        if (documents_[ordinal].id != REMOVED_DOCUMENT_ID) {
+            const vector<string_view> words = GetDocumentWords(ordinal);
+            AddSignature(ordinal, ComputeSignature(words), words);
+        }
+    }
+}
+
+DuplicatePolicy SearchServer::GetDuplicatePolicy() const {
+    return duplicate_policy_;
+}
+
+const pmr::map<int, int>& SearchServer::GetDuplicates() const {
+    return duplicates_;
+}
+
+uint64_t SearchServer::ComputeSignature(const vector<string_view>& words) {
+    // FNV-1a over hashes of words
+    uint64_t signature = 14695981039346656037ULL;
+    for (const string_view word : words) {
+        signature = (signature ^ hash<string_view>{}(word)) * 1099511628211ULL;
+    }
+    return signature;
+}
+
+vector<string_view> SearchServer::GetDocumentWords(DocumentOrdinal ordinal) const {
+    vector<string_view> words;
+    words.reserve(document_to_word_freqs_[ordinal].size());
+    for (const auto& [word, _] : document_to_word_freqs_[ordinal]) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+vector<SearchServer::DocumentOrdinal> SearchServer::FindDuplicates(uint64_t signature, const vector<string_view>& words) const {
+    vector<DocumentOrdinal> duplicates;
+    const auto [begin, end] = signature_to_documents_.equal_range(signature);
+    for (auto it = begin; it != end; ++it) {
+        const DocumentOrdinal ordinal = document_ordinals_.at(it->second);
+        const WordFrequencies& word_freqs = document_to_word_freqs_[ordinal];
+        // signatures can collide
+        if (word_freqs.size() == words.size() && equal(words.begin(), words.end(), word_freqs.begin(),
+            [](string_view word, const auto& word_freq) {
+                return word == word_freq.first;
+            })) {
+            duplicates.push_back(ordinal);
+        }
+    }
+    sort(duplicates.begin(), duplicates.end());
+    return duplicates;
+}
+
+void SearchServer::AddSignature(DocumentOrdinal ordinal, uint64_t signature, const vector<string_view>& words) {
+    const vector<DocumentOrdinal> duplicates = FindDuplicates(signature, words);
+    const int document_id = documents_[ordinal].id;
+    if (!duplicates.empty()) {
+        duplicates_[document_id] = documents_[duplicates.front()].id;
+    }
+    signature_to_documents_.emplace(signature, document_id);
+}
+
+void SearchServer::RemoveSignature(DocumentOrdinal ordinal) {
+    if (duplicate_policy_ == DuplicatePolicy::NONE) {
+        return;
+    }
+    const int document_id = documents_[ordinal].id;
+    const vector<string_view> words = GetDocumentWords(ordinal);
+    const uint64_t signature = ComputeSignature(words);
+    const auto [begin, end] = signature_to_documents_.equal_range(signature);
+    signature_to_documents_.erase(find_if(begin, end,
+        [document_id](const auto& document) {
+            return document.second == document_id;
+        }));
+
+    if (duplicates_.erase(document_id) > 0) {
+        return;
+    }
+    // original is removed: the earliest duplicate becomes original of the others
+    const vector<DocumentOrdinal> duplicates = FindDuplicates(signature, words);
+    if (duplicates.empty()) {
+        return;
+    }
+    const int original_id = documents_[duplicates.front()].id;
+    duplicates_.erase(original_id);
+    for (auto it = next(duplicates.begin()); it != duplicates.end(); ++it) {
+        duplicates_[documents_[*it].id] = original_id;
+    }
+}
+
+void SearchServer::SetHotTermCount(size_t term_count) {
+    hot_terms_.reset();
+    if (term_count > 0) {
+        hot_terms_ = make_unique<HotTerms>(term_count);
+    }
+}
+
+vector<string> SearchServer::GetHotTerms() const {
+    vector<string> words;
+    if (hot_terms_) {
+        shared_lock lock(hot_terms_->mutex);
+        for (const auto& [word, _] : hot_terms_->terms) {
+            words.push_back(word);
+        }
+    }
+    return words;
+}
+
+SearchServer::HotTerms::HotTerms(size_t term_count) :
+    term_count(term_count), sketch(HOT_TERM_SKETCH_WIDTH, HOT_TERM_SKETCH_DEPTH, HOT_TERM_SKETCH_DECAY_PERIOD) {
+
+}
+
+bool SearchServer::HotPosting::operator<(const HotPosting& other) const {
+    if (term_freq != other.term_freq) {
+        return term_freq > other.term_freq;
+    }
+    if (rating != other.rating) {
+        return rating > other.rating;
+    }
+    return id < other.id;
+}
+
+optional<vector<Document>> SearchServer::FindHotTermTop(const Query& query, DocumentStatus status) const {
+    if (!hot_terms_ || scoring_mode_ != ScoringMode::EXACT) {
+        return nullopt;
+    }
+    // TOP lists keep exact relevance, so expansions of misspelled words are scored by search
+    if (query.plus_words.size() != 1 || !query.minus_words.empty() || !query.word_weights.empty()
+        || word_to_document_freqs_.count(query.plus_words[0]) == 0) {
+        return nullopt;
+    }
+    const string_view word = query.plus_words[0];
+
+    HotTerms& hot_terms = *hot_terms_;
+    const uint32_t frequency = hot_terms.sketch.Add(word);
+    {
+        shared_lock lock(hot_terms.mutex);
+        const auto it = hot_terms.terms.find(word);
+        if (it != hot_terms.terms.end()) {
+            return FindHotTermTop(it->second, word, status);
+        }
+        // word is admitted if it is more frequent than the coldest hot term, estimates are compared
+        // at the same moment, so both are decayed by the sketch
+        if (hot_terms.terms.size() >= hot_terms.term_count) {
+            uint32_t min_frequency = numeric_limits<uint32_t>::max();
+            for (const auto& [term_word, _] : hot_terms.terms) {
+                min_frequency = min(min_frequency, hot_terms.sketch.Estimate(term_word));
+            }
+            if (frequency <= min_frequency) {
+                return nullopt;
+            }
+        }
+    }
+
+    // lists are built out of the exclusive lock (index isn't changed while queries run),
+    // so readers of other hot terms wait only for the publication
+    HotTerm term = BuildHotTerm(word);
+    lock_guard lock(hot_terms.mutex);
+    const auto it = hot_terms.terms.try_emplace(string(word), move(term)).first;
+    if (hot_terms.terms.size() > hot_terms.term_count) {
+        auto coldest = hot_terms.terms.end();
+        uint32_t min_frequency = numeric_limits<uint32_t>::max();
+        for (auto term_it = hot_terms.terms.begin(); term_it != hot_terms.terms.end(); ++term_it) {
+            const uint32_t term_frequency = hot_terms.sketch.Estimate(term_it->first);
+            if (term_it != it && term_frequency < min_frequency) {
+                min_frequency = term_frequency;
+                coldest = term_it;
+            }
+        }
+        hot_terms.terms.erase(coldest);
+    }
+    return FindHotTermTop(it->second, word, status);
+}
+
+optional<vector<Document>> SearchServer::FindHotTermTop(const HotTerm& term, string_view word, DocumentStatus status) const {
+    const HotTermTop& top = term[static_cast<size_t>(status)];
+    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+    vector<Document> documents;
+    documents.reserve(top.postings.size());
+    for (const HotPosting& posting : top.postings) {
+        documents.push_back({ posting.id, posting.term_freq * inverse_document_freq, posting.rating });
+    }
+    SelectTopDocuments(documents);
+
+    // documents out of the list are after the last document of TOP if they are less relevant by EPSILON
+    // or have the same TF (then they are after it by rating and ID)
+    if (top.unlisted_term_freq >= 0) {
+        if (documents.size() < MAX_RESULT_DOCUMENT_COUNT) {
+            return nullopt;
+        }
+        const int last_id = documents.back().id;
+        const double last_term_freq = find_if(top.postings.begin(), top.postings.end(),
+            [last_id](const HotPosting& posting) {
+                return posting.id == last_id;
+            })->term_freq;
+        auto is_less_relevant = [&](double term_freq) {
+            return term_freq < 0 || term_freq * inverse_document_freq <= documents.back().relevance - EPSILON;
+        };
+        if (!is_less_relevant(top.unlisted_lower_term_freq)
+            || (top.unlisted_term_freq != last_term_freq && !is_less_relevant(top.unlisted_term_freq))) {
+            return nullopt;
+        }
+    }
+    METRICS_COUNT("find_top_documents.hot_term_hits", 1);
+    return documents;
+}
+
+SearchServer::HotTerm SearchServer::BuildHotTerm(string_view word) const {
+    HotTerm term;
+    const auto it = word_to_document_freqs_.find(word);
+    if (it == word_to_document_freqs_.end()) {
+        return term;
+    }
+    for (const auto& [ordinal, term_freq] : it->second) {
+        const DocumentData& data = documents_[ordinal];
+        term[static_cast<size_t>(data.status)].postings.push_back({ term_freq, data.rating, data.id });
+    }
+    for (HotTermTop& top : term) {
+        auto& postings = top.postings;
+        if (postings.size() > HOT_TERM_TOP_CAPACITY) {
+            nth_element(postings.begin(), postings.begin() + HOT_TERM_TOP_CAPACITY, postings.end());
+            for (auto it = postings.begin() + HOT_TERM_TOP_CAPACITY; it != postings.end(); ++it) {
+                top.AddUnlisted(it->term_freq);
+            }
+            postings.resize(HOT_TERM_TOP_CAPACITY);
+        }
+        sort(postings.begin(), postings.end());
+        postings.shrink_to_fit();
+    }
+    return term;
+}
+
+void SearchServer::HotTermTop::AddUnlisted(double term_freq) {
+    if (term_freq > unlisted_term_freq) {
+        unlisted_lower_term_freq = unlisted_term_freq;
+        unlisted_term_freq = term_freq;
+    }
+    else if (term_freq < unlisted_term_freq) {
+        unlisted_lower_term_freq = max(unlisted_lower_term_freq, term_freq);
+    }
+}
+
+void SearchServer::InsertHotPosting(HotTermTop& top, const HotPosting& posting) {
+    top.postings.insert(upper_bound(top.postings.begin(), top.postings.end(), posting), posting);
+    if (top.postings.size() > HOT_TERM_TOP_CAPACITY) {
+        top.AddUnlisted(top.postings.back().term_freq);
+        top.postings.pop_back();
+    }
+}
+
+void SearchServer::AddToHotTerms(DocumentOrdinal ordinal) {
+    if (!hot_terms_) {
+        return;
+    }
+    const DocumentData& data = documents_[ordinal];
+    const WordFrequencies& word_freqs = document_to_word_freqs_[ordinal];
+    for (auto& [word, term] : hot_terms_->terms) {
+        const auto it = word_freqs.find(word);
+        if (it != word_freqs.end()) {
+            InsertHotPosting(term[static_cast<size_t>(data.status)], { it->second, data.rating, data.id });
+        }
+    }
+}
+
+void SearchServer::RemoveFromHotTerms(DocumentOrdinal ordinal) {
+    if (!hot_terms_) {
+        return;
+    }
+    const DocumentData& data = documents_[ordinal];
+    const WordFrequencies& word_freqs = document_to_word_freqs_[ordinal];
+    for (auto& [word, term] : hot_terms_->terms) {
+        if (word_freqs.count(word) == 0) {
+            continue;
+        }
+        HotTermTop& top = term[static_cast<size_t>(data.status)];
+        const auto it = find_if(top.postings.begin(), top.postings.end(),
+            [&data](const HotPosting& posting) {
+                return posting.id == data.id;
+            });
+        if (it != top.postings.end()) {
+            top.postings.erase(it);
+        }
+        if (top.unlisted_term_freq >= 0 && top.postings.size() < MAX_RESULT_DOCUMENT_COUNT) {
+            term = BuildHotTerm(word);
+        }
+    }
+}
+
+void SearchServer::RemoveAdditionalPostings(string_view word, DocumentOrdinal ordinal) {
+    if (scoring_mode_ != ScoringMode::EXACT) {
+        word_to_quantized_postings_.at(word).Remove(ordinal);
+    }
+    if (impact_ordered_) {
+        const double term_freq = document_to_word_freqs_[ordinal].find(word)->second;
+        word_to_impact_postings_.at(word).erase({ term_freq, ordinal });
+    }
+}
+
+SearchServer::DocumentOrdinal SearchServer::GetOrdinal(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        throw out_of_range("Document ID is not found"s);
+    }
+    return it->second;
+}
+
+void SearchServer::ReleaseOrdinal(DocumentOrdinal ordinal) {
+    RemoveFromHotTerms(ordinal);
+    RemoveSignature(ordinal);
+    if (bloom_parameters_) {
+        document_filters_[ordinal].Clear();
+    }
+    DocumentData& data = documents_[ordinal];
+    document_ordinals_.erase(data.id);
+    document_to_word_freqs_[ordinal].clear();
+    document_texts_.erase(data.text);
+    data = {};
+
+    if (documents_.size() - document_ordinals_.size() > documents_.size() * MAX_REMOVED_ORDINAL_SHARE) {
+        CompactOrdinals();
+    }
+}
+
+void SearchServer::CompactOrdinals() {
+    vector<DocumentOrdinal> new_ordinals(documents_.size());
+    DocumentOrdinal next = 0;
+    for (DocumentOrdinal ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        if (documents_[ordinal].id == REMOVED_DOCUMENT_ID) {
+            continue;
+        }
+        new_ordinals[ordinal] = next;
+        if (ordinal != next) {
+            documents_[next] = documents_[ordinal];
+            document_to_word_freqs_[next] = move(document_to_word_freqs_[ordinal]);
+            if (bloom_parameters_) {
+                document_filters_[next] = move(document_filters_[ordinal]);
+            }
+        }
+        ++next;
+    }
+    documents_.resize(next);
+    documents_.shrink_to_fit();
+    RebuildFilterBlocks();
+    document_to_word_freqs_.resize(next);
+    document_to_word_freqs_.shrink_to_fit();
+    if (bloom_parameters_) {
+        document_filters_.resize(next);
+        document_filters_.shrink_to_fit();
+    }
+
+    decltype(document_ordinals_) document_ordinals(document_ordinals_.get_allocator());
+    for (DocumentOrdinal ordinal = 0; ordinal < next; ++ordinal) {
+        document_ordinals.emplace(documents_[ordinal].id, ordinal);
+    }
+    document_ordinals_ = move(document_ordinals);
+
+    // renumbering keeps order, so postings are appended to the end of new containers
+    for (auto& [_, document_freqs] : word_to_document_freqs_) {
+        DocumentFreqs renumbered(document_freqs.get_allocator());
+        for (const auto& [ordinal, term_freq] : document_freqs) {
+            renumbered.emplace_hint(renumbered.end(), new_ordinals[ordinal], term_freq);
+        }
+        document_freqs = move(renumbered);
+    }
+    for (auto& [_, postings] : word_to_quantized_postings_) {
+        postings.Renumber(new_ordinals);
+    }
+    for (auto& [_, postings] : word_to_impact_postings_) {
+        ImpactPostings renumbered(postings.get_allocator());
+        for (const ImpactPosting& posting : postings) {
+            renumbered.emplace_hint(renumbered.end(), ImpactPosting{ posting.term_freq, new_ordinals[posting.ordinal] });
+        }
+        postings = move(renumbered);
+    }
+}
+
+void SearchServer::FilterBlock::Add(DocumentStatus status, int rating) {
+    min_rating = min(min_rating, rating);
+    max_rating = max(max_rating, rating);
+    statuses |= 1 << static_cast<int>(status);
+}
+
+bool SearchServer::FilterBlock::MayPass(const DocumentFilter& filter) const {
+    return (!filter.status || (statuses & (1 << static_cast<int>(*filter.status))))
+        && max_rating >= filter.min_rating && min_rating <= filter.max_rating;
+}
+
+void SearchServer::RebuildFilterBlocks() {
+    filter_blocks_.assign((documents_.size() + FILTER_BLOCK_SIZE - 1) / FILTER_BLOCK_SIZE, FilterBlock{});
+    filter_blocks_.shrink_to_fit();
+    for (DocumentOrdinal ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        filter_blocks_[ordinal / FILTER_BLOCK_SIZE].Add(documents_[ordinal].status, documents_[ordinal].rating);
+    }
+}
+
+void SearchServer::PlanFilter(const DocumentFilter& filter, Plan& plan) const {
+    METRICS_TIMER("find_top_documents.filter_planning");
+    const uint32_t block_count = static_cast<uint32_t>(filter_blocks_.size());
+    plan.next_passing_blocks.resize(block_count);
+    bool is_any_skipped = false;
+    // from the last block, so every block gets the nearest passing one after it
+    uint32_t next = block_count;
+    for (uint32_t block = block_count; block-- > 0;) {
+        if (filter_blocks_[block].MayPass(filter)) {
+            next = block;
+        }
+        else {
+            is_any_skipped = true;
+        }
+        plan.next_passing_blocks[block] = next;
+    }
+    if (!is_any_skipped) {
+        plan.next_passing_blocks.clear();
+    }
+}
+
+void SearchServer::DetachWord(string_view word) {
+    auto it = word_to_document_freqs_.find(word);
+    if (it->second.empty()) {
+        word_to_document_freqs_.erase(it);
+        word_to_quantized_postings_.erase(word);
+        word_to_impact_postings_.erase(word);
+        if (fuzzy_index_) {
+            fuzzy_index_->Remove(word);
+        }
+        return;
+    }
+
+    // key views text of removed document -> switch it to text of the first document left (terms of
+    // dictionary don't view texts)
+    if (it->first.data() == word.data()) {
+        const DocumentOrdinal ordinal = it->second.begin()->first;
+        const string_view key = document_to_word_freqs_[ordinal].find(word)->first;
+        RekeyWord(word_to_document_freqs_, word, key);
+        RekeyWord(word_to_quantized_postings_, word, key);
+        RekeyWord(word_to_impact_postings_, word, key);
+        if (fuzzy_index_) {
+            fuzzy_index_->Rekey(word, key);
+        }
+    }
 }
 
 bool SearchServer::IsValidWord(string_view word) {
@@ -196,7 +1221,16 @@ bool SearchServer::IsValidWord(string_view word) {
 }
 
 bool SearchServer::IsStopWord(string_view word) const {
-    return stop_words_.count(static_cast<string>(word)) > 0;
+    return dictionary_ ? dictionary_->IsStopWord(word) : stop_words_.count(word) > 0;
+}
+
+string_view SearchServer::InternWord(string_view word) const {
+    if (dictionary_) {
+        if (const string_view term = dictionary_->FindTerm(word); !term.empty()) {
+            return term;
+        }
+    }
+    return word;
 }
 
 vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
@@ -222,14 +1256,19 @@ int SearchServer::ComputeAverageRating(const vector<int>& ratings) {
 
 SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
     bool is_minus = false;
+    bool is_required = false;
 
     if (text[0] == '-') {
         is_minus = true;
         text = text.substr(1);
     }
+    else if (text[0] == '+') {
+        is_required = true;
+        text = text.substr(1);
+    }
 
     if (text.empty()) {
-        throw invalid_argument("Empty query minus-word");
+        throw invalid_argument(is_required ? "Empty query required word" : "Empty query minus-word");
     }
 
     if (!IsValidWord(text)) {
@@ -240,30 +1279,174 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
         throw invalid_argument("Invalid query minus-word (--)");
     }
 
-    return { text, is_minus, IsStopWord(text) };
+    if ((is_minus || is_required) && text[0] == '+') {
+        throw invalid_argument("Invalid query required word (-+ or ++)");
+    }
+
+    if (text.back() == '*') {
+        text.remove_suffix(1);
+        if (text.empty()) {
+            throw invalid_argument("Empty query prefix");
+        }
+        if (is_required) {
+            throw invalid_argument("Query prefix can't be required");
+        }
+        return { text, is_minus, false, true };
+    }
+
+    return { text, is_minus, IsStopWord(text), false, is_required };
 }
 
 SearchServer::Query SearchServer::ParseQuery(string_view text) const {
-    Query query;
-    auto words = SplitIntoWords(text);
-
-    for (auto word : SplitIntoWords(text)) {
-        const QueryWord query_word = ParseQueryWord(word);
+    return ParseQuery(text,
+        [this](string_view prefix, bool is_minus, QueryWords& words) {
+            ExpandPrefix(prefix, is_minus ? numeric_limits<size_t>::max() : prefix_expansion_limit_, words);
+        });
+}
 
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
-            }
-            else {
-                query.plus_words.push_back(query_word.data);
+void SearchServer::ExpandFuzzy(string_view word, bool is_required, Query& query) const {
+    METRICS_TIMER("find_top_documents.fuzzy_expansion");
+    auto candidates = fuzzy_index_->Find(word);
+    // the closest words first, then the most frequent ones
+    auto document_count_of = [this](string_view candidate) {
+        return word_to_document_freqs_.find(candidate)->second.size();
+    };
+    const size_t count = min(candidates.size(), fuzzy_options_.max_expansions);
+    partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(),
+        [&document_count_of](const auto& lhs, const auto& rhs) {
+            if (lhs.second != rhs.second) {
+                return lhs.second < rhs.second;
             }
+            const size_t lhs_count = document_count_of(lhs.first);
+            const size_t rhs_count = document_count_of(rhs.first);
+            return lhs_count > rhs_count || (lhs_count == rhs_count && lhs.first < rhs.first);
+        });
+    for (size_t i = 0; i < count; ++i) {
+        const auto& [candidate, distance] = candidates[i];
+        query.word_weights.emplace_back(candidate, pow(fuzzy_options_.penalty, distance));
+    }
+    // required word without expansions is an empty group: no document matches
+    if (is_required) {
+        QueryWords& group = query.required_groups.emplace_back();
+        for (size_t i = 0; i < count; ++i) {
+            group.push_back(candidates[i].first);
+        }
+    }
+}
+
+void SearchServer::AddFuzzyWords(Query& query) {
+    if (query.word_weights.empty()) {
+        return;
+    }
+    // expansion of several words keeps the largest weight
+    auto& weights = query.word_weights;
+    sort(weights.begin(), weights.end(),
+        [](const auto& lhs, const auto& rhs) {
+            return lhs.first < rhs.first || (lhs.first == rhs.first && lhs.second > rhs.second);
+        });
+    weights.erase(unique(weights.begin(), weights.end(),
+        [](const auto& lhs, const auto& rhs) {
+            return lhs.first == rhs.first;
+        }), weights.end());
+
+    // words of query which aren't only expansions are scored without penalty
+    QueryWords other_words(query.plus_words, query.plus_words.get_allocator());
+    RemoveDuplicates(other_words);
+    weights.erase(remove_if(weights.begin(), weights.end(),
+        [&other_words](const auto& weight) {
+            return binary_search(other_words.begin(), other_words.end(), weight.first);
+        }), weights.end());
+    for (const auto& [word, _] : weights) {
+        query.plus_words.push_back(word);
+    }
+}
+
+double SearchServer::Query::GetWordWeight(string_view word) const {
+    if (word_weights.empty()) {
+        return 1;
+    }
+    const auto it = lower_bound(word_weights.begin(), word_weights.end(), word,
+        [](const auto& weight, string_view value) {
+            return weight.first < value;
+        });
+    return it != word_weights.end() && it->first == word ? it->second : 1;
+}
+
+void SearchServer::ExpandPrefix(string_view prefix, size_t limit, QueryWords& words) const {
+    // dictionary is sorted, so words with the prefix follow each other: O(log W + limit)
+    size_t expanded = 0;
+    for (auto it = word_to_document_freqs_.lower_bound(prefix);
+        it != word_to_document_freqs_.end() && expanded < limit;
+        ++it, ++expanded) {
+        if (it->first.substr(0, prefix.size()) != prefix) {
+            break;
         }
+        words.push_back(it->first);
     }
-    return query;
 }
 
 double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
     return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
 }
 
+SearchServer::DocumentFreqs::const_iterator SearchServer::SeekPosting(const DocumentFreqs& postings,
+    DocumentFreqs::const_iterator it, DocumentOrdinal ordinal) {
+    // close documents are reached by steps, far ones by search in tree
+    for (size_t step = 0; step < LINEAR_SEEK_STEPS; ++step, ++it) {
+        if (it == postings.end() || it->first >= ordinal) {
+            return it;
+        }
+    }
+    return postings.lower_bound(ordinal);
+}
+
+bool SearchServer::IsScoredBefore(string_view lhs_word, double lhs_inverse_document_freq,
+    string_view rhs_word, double rhs_inverse_document_freq) {
+    if (lhs_inverse_document_freq != rhs_inverse_document_freq) {
+        return lhs_inverse_document_freq > rhs_inverse_document_freq;
+    }
+    return lhs_word < rhs_word;
+}
+
+tuple<vector<string_view>, DocumentStatus> SearchServer::MatchQuery(const Query& query, DocumentOrdinal ordinal) const {
+    vector<string_view> matched_words;
+
+    // filter of document skips lookups of words which are absent (the common case for minus-words)
+    for (const auto& word : query.minus_words) {
+        if (!MayContainWord(ordinal, word) || word_to_document_freqs_.count(word) == 0) {
+            continue;
+        }
+        if (word_to_document_freqs_.at(word).count(ordinal)) {
+            return { matched_words, documents_[ordinal].status };
+        }
+    }
+
+    const auto& words = document_to_word_freqs_[ordinal];
+    for (const auto& word : query.required_words) {
+        if (!MayContainWord(ordinal, word) || words.count(word) == 0) {
+            return { matched_words, documents_[ordinal].status };
+        }
+    }
+    for (const auto& group : query.required_groups) {
+        if (none_of(group.begin(), group.end(),
+            [this, ordinal, &words](string_view word) {
+                return MayContainWord(ordinal, word) && words.count(word) > 0;
+            })) {
+            return { matched_words, documents_[ordinal].status };
+        }
+    }
+
+    matched_words.reserve(query.plus_words.size());
+    for (const auto& word : query.plus_words) {
+
+        if (!MayContainWord(ordinal, word) || word_to_document_freqs_.count(word) == 0) {
+            continue;
+        }
+        if (word_to_document_freqs_.at(word).count(ordinal)) {
+            matched_words.push_back(word);
+        }        
+    }
+    return { matched_words, documents_[ordinal].status };
+}
+
 
@@ -7,52 +7,239 @@
 #include <string>
 #include <stdexcept>
 #include <execution>
+#include <future>
+#include <optional>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <array>
+#include <shared_mutex>
+#include <iostream>
 #include "document.h"
 #include "concurrent_map.h"
-#include "log_duration.h"
+#include "string_processing.h"
+#include "executor.h"
+#include "execution_cost.h"
+#include "thread_pool.h"
+#include "memory_usage.h"
+#include "metrics.h"
+#include "quantized_scoring.h"
+#include "query_arena.h"
+#include "query_deadline.h"
+#include "count_min_sketch.h"
+#include "bloom_filter.h"
+#include "fuzzy_index.h"
+#include "shared_dictionary.h"
 
 using namespace std::string_literals; //for ""s
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double EPSILON = 1e-6;
-const int THREAD_COUNT = 16;
+const size_t MAX_PREFIX_EXPANSION = 64;
+const size_t MAX_QUEUED_QUERY_COUNT = 1024;
+// buckets of ConcurrentMap of parallel query per thread of executor
+const size_t BUCKETS_PER_THREAD = 4;
+// max count of plus-words of query which is answered by impact-ordered postings
+const size_t MAX_IMPACT_ORDERED_WORD_COUNT = 2;
+// internal numbers of documents are renumbered when share of removed ones is larger
+const double MAX_REMOVED_ORDINAL_SHARE = 0.5;
+// steps forward in postings before searching from the root of the tree (galloping search)
+const size_t LINEAR_SEEK_STEPS = 4;
+// postings kept in TOP list of hot term for every status
+const size_t HOT_TERM_TOP_CAPACITY = 2 * MAX_RESULT_DOCUMENT_COUNT;
+// sketch of frequencies of single-word queries
+const size_t HOT_TERM_SKETCH_WIDTH = 4096;
+const size_t HOT_TERM_SKETCH_DEPTH = 4;
+const uint64_t HOT_TERM_SKETCH_DECAY_PERIOD = 10 * HOT_TERM_SKETCH_WIDTH;
+// typo-tolerant search: max edit distance, expansions of misspelled word and penalty of IDF per edit
+const size_t MAX_FUZZY_DISTANCE = 2;
+const size_t MAX_FUZZY_EXPANSION = 8;
+const double FUZZY_PENALTY = 0.5;
+// documents excluded by minus-words are kept as bitset if they are more than this share of base (as sorted
+// list of ordinals otherwise), so exclusion costs O(excluded documents) per query
+const double EXCLUDED_BITSET_SHARE = 1.0 / 32;
+// documents per block of summary of ratings and statuses (see DocumentFilter)
+const size_t FILTER_BLOCK_SIZE = 64;
 
-template <class ExecutionPolicy>
-void RemoveDuplicates(ExecutionPolicy&& policy, std::vector<std::string_view>& vec) {
-    sort(policy, vec.begin(), vec.end());
-    auto last = unique(policy, vec.begin(), vec.end());
-    vec.erase(last, vec.end());
-}
+// ANY - documents with some plus-word (words with '+' are required: "+cat city"), ALL - documents with
+// all plus-words (words of prefixes are optional)
+enum class MatchMode {
+    ANY,
+    ALL,
+};
+
+// typo-tolerant search (see SearchServer::SetFuzzySearch)
+struct FuzzySearchOptions {
+    // max edit distance of expansions (1..MAX_FUZZY_DISTANCE), 0 - disabled
+    size_t max_distance = 0;
+    // max count of dictionary words a misspelled word is expanded into (the closest and most frequent ones)
+    size_t max_expansions = MAX_FUZZY_EXPANSION;
+    // IDF of expansion is multiplied by penalty^distance, (0, 1]
+    double penalty = FUZZY_PENALTY;
+};
+
+// words of query, allocated in arena of query (see QueryArenaScope)
+using QueryWords = std::pmr::vector<std::string_view>;
+
+// sorting words and erasing duplicates, executor = nullptr -> sequential sorting
+void RemoveDuplicates(std::vector<std::string_view>& vec, Executor* executor = nullptr);
+void RemoveDuplicates(QueryWords& vec, Executor* executor = nullptr);
+
+// order of search results: by relevance, documents with equal relevance - by rating, then by ID
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+// sorting documents in order of search results and keeping TOP count of them,
+// executor = nullptr -> sequential selection of TOP without sorting the rest
+void SelectTopDocuments(std::vector<Document>& documents, Executor* executor = nullptr, size_t count = MAX_RESULT_DOCUMENT_COUNT);
+
+// position in search results: results after it are more relevant
+struct SearchCursor {
+    double relevance = 0;
+    int rating = 0;
+    int id = 0;
+
+    // cursor of the last document of page
+    static SearchCursor After(const Document& document);
+
+    // opaque text for clients
+    std::string ToString() const;
+    // throws invalid_argument if text isn't made by ToString
+    static SearchCursor FromString(std::string_view text);
+};
+
+// page of search results: documents after search_after (if it is set), then offset and limit
+struct PageRequest {
+    size_t offset = 0;
+    size_t limit = MAX_RESULT_DOCUMENT_COUNT;
+    std::optional<SearchCursor> search_after;
+};
+
+// what AddDocument does with document which set of words is the same as of document in base
+enum class DuplicatePolicy {
+    // duplicates aren't detected
+    NONE,
+    // document isn't added, DuplicateDocumentError is thrown
+    REJECT,
+    // documents with the same set of words are removed, then document is added
+    REPLACE,
+    // document is added and recorded as duplicate (see SearchServer::GetDuplicates)
+    RECORD,
+};
+
+// thrown by AddDocument for duplicate if policy is REJECT
+class DuplicateDocumentError : public std::invalid_argument {
+public:
+    DuplicateDocumentError(int document_id, int original_id);
+
+    // the earliest document with the same set of words
+    int GetOriginalId() const;
+
+private:
+    int original_id_;
+};
+
+// TOP documents of query with deadline
+struct TopDocumentsResult {
+    std::vector<Document> documents;
+    // query was stopped by deadline or cancellation, documents are TOP of postings scored before it
+    bool is_partial = false;
+};
+
+// step of plan of query
+struct QueryPlanStep {
+    std::string word;
+    bool is_minus = false;
+    size_t posting_count = 0;
+    // IDF of plus-word
+    double inverse_document_freq = 0;
+    // word isn't in the index or all documents of plus-word are excluded
+    bool is_skipped = false;
+    // documents must contain plus-word (its postings are intersected)
+    bool is_required = false;
+};
+
+// plan of search: minus-words build set of excluded documents first, then plus-words are scored from
+// the shortest postings to the longest ones (by descending IDF), plus-words which documents are all
+// excluded are skipped
+struct QueryPlan {
+    // minus-words, then plus-words in order of evaluation
+    std::vector<QueryPlanStep> steps;
+    size_t excluded_document_count = 0;
+
+    // one line per step
+    std::string ToString() const;
+};
+
+// frequencies of words of document
+using WordFrequencies = std::pmr::map<std::string_view, double>;
+
+// options of asynchronous query
+struct QueryTaskOptions {
+    TaskPriority priority = TaskPriority::NORMAL;
+    // query is not started or stopped at the next block of postings if token is cancelled,
+    // future gets TaskCancelledError
+    CancellationToken cancellation;
+    // query is stopped at the next block of postings after time, future gets QueryTimeoutError
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+};
+
+// structured predicate of search: documents with status (any if it isn't set) and rating in
+// [min_rating, max_rating]; unlike lambda it is known to the server, so sequential search skips blocks of
+// postings which documents can't pass it by summaries of blocks
+struct DocumentFilter {
+    std::optional<DocumentStatus> status;
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+
+    bool operator()(int, DocumentStatus document_status, int rating) const {
+        return (!status || *status == document_status) && rating >= min_rating && rating <= max_rating;
+    }
+};
 
 class SearchServer {
 public:
     //construct SearchServer from string containing stop-words
-    explicit SearchServer(const std::string& text);
-    explicit SearchServer(std::string_view text);
+    //executor runs asynchronous queries and parallel stages of queries (nullptr -> own ThreadPool
+    //with hardware_concurrency threads and MAX_QUEUED_QUERY_COUNT queue); executor shared by
+    //several servers must not have tasks of destroyed server
+    //memory_resource allocates memory of index and base (e.g. huge pages), it must outlive the server; it is
+    //used only by the thread calling methods of the server, so it needn't be thread-safe
+    explicit SearchServer(const std::string& text, std::shared_ptr<Executor> executor = nullptr,
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
+    explicit SearchServer(std::string_view text, std::shared_ptr<Executor> executor = nullptr,
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
 
     //construct SearchServer from container of stop-words (set, vector, etc.)
     template<class Contaner>
-    explicit SearchServer(const Contaner& words);
+    explicit SearchServer(const Contaner& words, std::shared_ptr<Executor> executor = nullptr,
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
+
+    //construct SearchServer attached to shared dictionary of stop-words and terms (see SharedDictionary):
+    //no stop-words are copied, throws invalid_argument if dictionary is nullptr
+    explicit SearchServer(std::shared_ptr<const SharedDictionary> dictionary, std::shared_ptr<Executor> executor = nullptr,
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
+
+    SearchServer(SearchServer&&) = default;
+    // containers of other server use its memory resources
+    SearchServer& operator=(SearchServer&&) = delete;
 
     //adding document in our base
     void AddDocument(int document_id, std::string_view document, const DocumentStatus& status, const std::vector<int>& ratings);
 
-    auto begin() const {
-        return order_of_adding_.cbegin();
-    }
-
-    auto end() const {
-        return order_of_adding_.cend();
-    }
+    //IDs of documents in order of adding
+    class DocumentIdIterator;
+    DocumentIdIterator begin() const;
+    DocumentIdIterator end() const;
 
     //finding top MAX_RESULT_DOCUMENT_COUNT documents by status - ver. 1
     std::vector<Document>  FindTopDocuments(std::string_view raw_query, const DocumentStatus& status = DocumentStatus::ACTUAL) const;
     template <typename ExecutionPolicy>
     std::vector<Document>  FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentStatus& status = DocumentStatus::ACTUAL) const {
-        return FindTopDocuments(policy, raw_query,
-            [status](const int document_id, const DocumentStatus& local_status, const int rating) {
-                return status == local_status;
-            });
+        return FindTopDocuments(policy, raw_query, StatusPredicate{ status });
     }
 
     //finding top MAX_RESULT_DOCUMENT_COUNT documents with status ACTUAL - ver. 2
@@ -64,6 +251,56 @@ public:
     template <typename ExecutionPolicy, typename Predicate>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate) const; 
 
+    //finding top documents before deadline or cancellation of query (see QueryDeadline): postings are
+    //checked by blocks of QUERY_CHECK_BLOCK_SIZE, on expiry documents scored so far are flagged as partial
+    //or error is thrown (ExpiryPolicy)
+    template <typename ExecutionPolicy>
+    TopDocumentsResult FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentStatus& status,
+        const QueryDeadline& deadline) const {
+        return FindTopDocuments(policy, raw_query,
+            [status](const int document_id, const DocumentStatus& local_status, const int rating) {
+                return status == local_status;
+            }, deadline);
+    }
+    template <typename ExecutionPolicy, typename Predicate>
+    TopDocumentsResult FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate,
+        const QueryDeadline& deadline) const;
+
+    //predicate may be DocumentFilter: sequential exact search (ANY and ALL modes) skips blocks of
+    //FILTER_BLOCK_SIZE documents which ratings and statuses can't pass it
+
+    //finding page of documents by status or predicate, only TOP offset + limit documents are sorted
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const PageRequest& page,
+        const DocumentStatus& status = DocumentStatus::ACTUAL) const;
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const PageRequest& page, Predicate predicate) const;
+
+    //sequential or parallel search chosen by estimated cost of query (see ExecutionCostModel)
+    std::vector<Document> FindTopDocuments(const AdaptivePolicy& policy, std::string_view raw_query, const DocumentStatus& status = DocumentStatus::ACTUAL) const;
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(const AdaptivePolicy& policy, std::string_view raw_query, Predicate predicate) const;
+
+    //finding top documents by thread pool of server, throws runtime_error if queue of pool is full
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query, const DocumentStatus& status = DocumentStatus::ACTUAL,
+        QueryTaskOptions options = {}) const;
+    template <typename Predicate>
+    std::future<std::vector<Document>> FindTopDocumentsAsync(std::string raw_query, Predicate predicate, QueryTaskOptions options = {}) const;
+
+    //replacing executor by own ThreadPool
+    void SetThreadPool(size_t thread_count, size_t max_queue_size = MAX_QUEUED_QUERY_COUNT);
+
+    Executor& GetExecutor() const;
+
+    //thresholds of adaptive execution (e.g. from CalibrateCostModel)
+    void SetCostModel(const ExecutionCostModel& model);
+    const ExecutionCostModel& GetCostModel() const;
+
+    //estimated cost of FindTopDocuments for query
+    double EstimateQueryCost(std::string_view raw_query) const;
+
+    //count of tasks of adaptive FindTopDocuments for query, 1 - sequential
+    size_t GetAdaptiveFanOut(std::string_view raw_query) const;
+
     //getting count of documents in base
     size_t GetDocumentCount() const;
 
@@ -71,36 +308,259 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, const int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy& policy, std::string_view raw_query, const int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, const int document_id) const; 
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const AdaptivePolicy& policy, std::string_view raw_query, const int document_id) const;
     
     //return frequencies of all words in document
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    const WordFrequencies& GetWordFrequencies(int document_id) const;
+
+    //bytes used by every structure of the server, O(1)
+    MemoryUsage GetMemoryUsage() const;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy& policy, int document_id);
     void RemoveDocument(const std::execution::parallel_policy& policy, int document_id);
 
+    //max count of dictionary words a prefix query word (e.g. "cat*") is expanded into; minus prefix (e.g.
+    //"-cat*") is expanded into all its words, so every matched document is excluded
+    void SetPrefixExpansionLimit(size_t limit);
+
+    //sequential search by exact or quantized scores (see quantized_scoring.h), quantized index is
+    //built from the base (O(W + postings)) or released for EXACT
+    void SetScoringMode(ScoringMode mode);
+    ScoringMode GetScoringMode() const;
+
+    //plan of exact search of query
+    QueryPlan ExplainQuery(std::string_view raw_query) const;
+
+    //mode of queries: with required words documents are found by intersection of their postings
+    //(shortest first) and scored exactly
+    void SetMatchMode(MatchMode mode);
+    MatchMode GetMatchMode() const;
+
+    //max difference between quantized and exact relevance of document for query, 0 for EXACT
+    double GetScoreErrorBound(std::string_view raw_query) const;
+
+    //keeping postings of every word sorted by descending TF as well: sequential exact TOP of queries with
+    //no more than MAX_IMPACT_ORDERED_WORD_COUNT plus-words stops as soon as the rest of postings can't
+    //change it (the same results as full search)
+    void SetImpactOrderedPostings(bool enabled);
+    bool HasImpactOrderedPostings() const;
+
+    //keeping TOP lists of every status for term_count words of the most frequent single-word queries (by
+    //Count-Min sketch of queries): exact TOP of such query by status is taken from the list in O(K), lists
+    //are updated by AddDocument and RemoveDocument; 0 - disabled
+    void SetHotTermCount(size_t term_count);
+    //words with TOP lists (sorted)
+    std::vector<std::string> GetHotTerms() const;
+
+    //detection of duplicates (the same sets of words) by hash index of signatures of sets: AddDocument finds
+    //duplicate in O(words); index is built from the base, duplicates in it are recorded (NONE releases index)
+    void SetDuplicatePolicy(DuplicatePolicy policy);
+    DuplicatePolicy GetDuplicatePolicy() const;
+    //ID of duplicate -> ID of the earliest document with the same set of words, for all documents of
+    //base if detection is enabled (the earliest left document becomes original when original is removed)
+    const std::pmr::map<int, int>& GetDuplicates() const;
+
+    //keeping blocked Bloom filter of words of every document with false_positive_rate (0 - disabled):
+    //MatchDocument and checks of minus-words skip lookups of words which document definitely hasn't
+    void SetBloomFilters(double false_positive_rate);
+    //false positive rate of filters, 0 if they are disabled
+    double GetBloomFilterRate() const;
+
+    //typo-tolerant search: plus-words absent from dictionary are expanded into dictionary words within
+    //max_distance edits found by index of deletions (SymSpell, no scan of dictionary); expansions are scored
+    //with penalty, expansions of required word stay required as a group (document has some of them); index
+    //is built from the base (max_distance 0 releases it), throws invalid_argument for wrong options
+    void SetFuzzySearch(const FuzzySearchOptions& options);
+    const FuzzySearchOptions& GetFuzzySearchOptions() const;
+
+    //dictionary the server is attached to, nullptr if server has own stop-words
+    const std::shared_ptr<const SharedDictionary>& GetDictionary() const;
+
+    //snapshot of base: stop-words and documents (ID, status, rating, text) in order of adding, options of
+    //server (scoring mode, filters, etc.) aren't saved
+    void SaveSnapshot(std::ostream& output) const;
+    //server with base of snapshot (the same results of queries), throws invalid_argument if it is broken
+    //or it is snapshot of server attached to dictionary
+    static SearchServer LoadSnapshot(std::istream& input, std::shared_ptr<Executor> executor = nullptr,
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
+    //server attached to dictionary with base of snapshot, throws invalid_argument if stop-words of snapshot
+    //differ from stop-words of dictionary
+    static SearchServer LoadSnapshot(std::istream& input, std::shared_ptr<const SharedDictionary> dictionary,
+        std::shared_ptr<Executor> executor = nullptr,
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
 
 private:
+    // shards are SearchServers which are queried with global dictionary
+    friend class ShardedSearchServer;
 
-    struct DocumentData {
+    // internal number of document: documents are numbered in order of adding, IDs are translated
+    // to ordinals by public methods
+    using DocumentOrdinal = uint32_t;
+    static constexpr int REMOVED_DOCUMENT_ID = -1;
+
+    // frequencies of word in documents: ordinal -> tf
+    using DocumentFreqs = std::pmr::map<DocumentOrdinal, double>;
+
+    // posting of hot term in its TOP list
+    struct HotPosting {
+        double term_freq;
         int rating;
+        int id;
+
+        // by descending TF, then by rating and ID as in IsMoreRelevant
+        bool operator<(const HotPosting& other) const;
+    };
+
+    // best postings of hot term among documents of one status, documents out of the list go after all
+    // postings of the list (by HotPosting::operator<)
+    struct HotTermTop {
+        std::vector<HotPosting> postings;
+        // bounds of TF of documents of the status which aren't in postings: the max one and the max one
+        // less than it, -1 - there is no such document
+        double unlisted_term_freq = -1;
+        double unlisted_lower_term_freq = -1;
+
+        void AddUnlisted(double term_freq);
+    };
+
+    static constexpr size_t STATUS_COUNT = static_cast<size_t>(DocumentStatus::REMOVED) + 1;
+    using HotTerm = std::array<HotTermTop, STATUS_COUNT>;
+
+    // words of the most frequent single-word queries, lists are read and admitted by concurrent queries
+    struct HotTerms {
+        explicit HotTerms(size_t term_count);
+
+        size_t term_count;
+        CountMinSketch sketch;
+        std::shared_mutex mutex;
+        std::map<std::string, HotTerm, std::less<>> terms;
+    };
+
+    // predicate of status overloads of FindTopDocuments, their single-word queries are answered by hot terms
+    struct StatusPredicate {
         DocumentStatus status;
-        std::string text;
+
+        bool operator()(int, DocumentStatus document_status, int) const {
+            return document_status == status;
+        }
+    };
+
+    struct ImpactPosting {
+        double term_freq;
+        DocumentOrdinal ordinal;
+
+        // by descending TF, then by ordinal
+        bool operator<(const ImpactPosting& other) const {
+            return term_freq > other.term_freq || (term_freq == other.term_freq && ordinal < other.ordinal);
+        }
     };
+    using ImpactPostings = std::pmr::set<ImpactPosting>;
 
-    //order of adding documents, keep document ID
-    std::set<int> order_of_adding_;
+    using DocumentTexts = std::pmr::list<std::pmr::string>;
 
-    std::set<std::string, std::less<>> stop_words_;
+    struct DocumentData {
+        int id = REMOVED_DOCUMENT_ID;
+        int rating = 0;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+        // text in document_texts_, words of indexes view it
+        DocumentTexts::iterator text;
+    };
+
+    // summary of block of FILTER_BLOCK_SIZE ordinals: bounds of ratings and bits of statuses of its documents,
+    // removed documents are kept in it until ordinals are compacted
+    struct FilterBlock {
+        int min_rating = std::numeric_limits<int>::max();
+        int max_rating = std::numeric_limits<int>::min();
+        uint8_t statuses = 0;
+
+        void Add(DocumentStatus status, int rating);
+        // false only if no document of block passes filter
+        bool MayPass(const DocumentFilter& filter) const;
+    };
+
+    // counters of memory of structures, the first member: containers are destroyed before them
+    // (on heap, so containers keep valid resources when server is moved)
+    struct MemoryResources {
+        explicit MemoryResources(std::pmr::memory_resource* upstream);
 
-    // dictionary for calculations: word -> {(id, tf)}
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+        CountingMemoryResource stop_words;
+        CountingMemoryResource inverted_index;
+        CountingMemoryResource forward_index;
+        CountingMemoryResource quantized_index;
+        CountingMemoryResource impact_index;
+        CountingMemoryResource duplicate_index;
+        CountingMemoryResource bloom_filters;
+        CountingMemoryResource fuzzy_index;
+        CountingMemoryResource document_texts;
+        CountingMemoryResource document_metadata;
+    };
+    std::unique_ptr<MemoryResources> memory_;
+
+    // texts of documents: nodes of list aren't moved, so views of words stay valid
+    DocumentTexts document_texts_{ &memory_->document_texts };
+
+    // empty if server is attached to dictionary
+    std::pmr::set<std::pmr::string, std::less<>> stop_words_{ &memory_->stop_words };
+
+    // nullptr if server has own stop-words
+    std::shared_ptr<const SharedDictionary> dictionary_;
+
+    // dictionary for calculations: word -> {(ordinal, tf)}
+    std::pmr::map<std::string_view, DocumentFreqs> word_to_document_freqs_{ &memory_->inverted_index };
     
-    // dictionary: id -> {(word, tf)}
-    std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
+    // dictionary: ordinal -> {(word, tf)}, empty for removed documents
+    std::pmr::vector<WordFrequencies> document_to_word_freqs_{ &memory_->forward_index };
+
+    // base of documents: ordinal -> data, removed documents have REMOVED_DOCUMENT_ID
+    std::pmr::vector<DocumentData> documents_{ &memory_->document_metadata };
+
+    // ordinal / FILTER_BLOCK_SIZE -> summary of block
+    std::pmr::vector<FilterBlock> filter_blocks_{ &memory_->document_metadata };
+
+    // id -> ordinal of documents in base
+    std::pmr::unordered_map<int, DocumentOrdinal> document_ordinals_{ &memory_->document_metadata };
+
+    ScoringMode scoring_mode_ = ScoringMode::EXACT;
+
+    // word -> {(ordinal, impact)}, keys are the same as in word_to_document_freqs_ (empty for EXACT)
+    std::pmr::map<std::string_view, QuantizedPostings> word_to_quantized_postings_{ &memory_->quantized_index };
+
+    bool impact_ordered_ = false;
+
+    // word -> {(tf, ordinal)} by descending tf, keys are the same as in word_to_document_freqs_ (empty if disabled)
+    std::pmr::map<std::string_view, ImpactPostings> word_to_impact_postings_{ &memory_->impact_index };
+
+    size_t prefix_expansion_limit_ = MAX_PREFIX_EXPANSION;
+
+    MatchMode match_mode_ = MatchMode::ANY;
+
+    // nullptr if disabled
+    std::unique_ptr<HotTerms> hot_terms_;
+
+    DuplicatePolicy duplicate_policy_ = DuplicatePolicy::NONE;
+
+    // signature of set of words -> IDs of documents (empty if detection is disabled)
+    std::pmr::unordered_multimap<uint64_t, int> signature_to_documents_{ &memory_->duplicate_index };
+
+    // ID of duplicate -> ID of original
+    std::pmr::map<int, int> duplicates_{ &memory_->duplicate_index };
 
-    // base of documents: id -> data
-    std::map<int, DocumentData> documents_;
+    // nullopt if filters are disabled
+    std::optional<BloomFilterParameters> bloom_parameters_;
+
+    // filters of words of documents by ordinal (empty if disabled)
+    std::pmr::vector<BlockedBloomFilter> document_filters_{ &memory_->bloom_filters };
+
+    FuzzySearchOptions fuzzy_options_;
+
+    // deletions of words of word_to_document_freqs_ (viewing its keys), nullopt if typo-tolerant search is disabled
+    std::optional<DeletionIndex> fuzzy_index_;
+
+    ExecutionCostModel cost_model_;
+
+    // the last member: threads of own pool are joined before the base is destroyed
+    std::shared_ptr<Executor> executor_;
 
     // does word contain symbols from 0 to 31 ? true/false
     static bool IsValidWord(std::string_view word);
@@ -108,6 +568,9 @@ private:
     // is it stop word? true/false
     bool IsStopWord(std::string_view word) const;
 
+    // term of dictionary equal to word or word itself: key of indexes for word of added document
+    std::string_view InternWord(std::string_view word) const;
+
     // splitting text into words without stop words
     std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
 
@@ -118,38 +581,270 @@ private:
         std::string_view data;
         bool is_minus = false;
         bool is_stop = false;
+        bool is_prefix = false;
+        bool is_required = false;
     };
 
-    // getting query word without '-'
+    // getting query word without '-', '+' and '*'
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    // words are in arena of query if it is active on the thread
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        QueryWords plus_words{ GetQueryResource() };
+        QueryWords minus_words{ GetQueryResource() };
+        // plus-words which documents must contain (sorted, without duplicates)
+        QueryWords required_words{ GetQueryResource() };
+        // expansions of misspelled words (they are plus-words too) with weights of their IDF (sorted by word)
+        std::pmr::vector<std::pair<std::string_view, double>> word_weights{ GetQueryResource() };
+        // expansions of misspelled required words: documents must contain some word of each group
+        std::pmr::vector<QueryWords> required_groups{ GetQueryResource() };
+        // nullptr - query has no deadline
+        const QueryDeadlineCheck* deadline = nullptr;
+
+        bool IsExpired() const {
+            return deadline != nullptr && deadline->IsExpired();
+        }
+
+        // weight of IDF of plus-word, 1 for words which aren't expansions
+        double GetWordWeight(std::string_view word) const;
+
+        bool HasRequiredWords() const {
+            return !required_words.empty() || !required_groups.empty();
+        }
+    };
+
+    // word of query with its postings in plan
+    struct PlannedWord {
+        std::string_view word;
+        // nullptr if word isn't in the index
+        const DocumentFreqs* postings = nullptr;
+        double inverse_document_freq = 0;
+        bool is_skipped = false;
+        bool is_required = false;
+    };
+
+    // plan of query (see QueryPlan) in arena of query
+    struct Plan {
+        std::pmr::vector<PlannedWord> minus_words{ GetQueryResource() };
+        std::pmr::vector<PlannedWord> plus_words{ GetQueryResource() };
+        // sorted ordinals of documents excluded by minus-words (empty if excluded_bits are used)
+        std::pmr::vector<DocumentOrdinal> excluded{ GetQueryResource() };
+        // ordinal -> bit of excluded document, empty unless excluded share is larger than EXCLUDED_BITSET_SHARE
+        std::pmr::vector<uint64_t> excluded_bits{ GetQueryResource() };
+        size_t excluded_document_count = 0;
+        // required words or groups of query (see Query::required_groups)
+        bool has_required_words = false;
+        std::pmr::vector<QueryWords> required_groups{ GetQueryResource() };
+        const QueryDeadlineCheck* deadline = nullptr;
+        // block of ordinals -> the first block from it which documents may pass DocumentFilter (count of
+        // blocks if there is no such block), empty if every block may pass or predicate isn't DocumentFilter
+        std::pmr::vector<uint32_t> next_passing_blocks{ GetQueryResource() };
+
+        bool IsExpired() const {
+            return deadline != nullptr && deadline->IsExpired();
+        }
+
+        bool IsExcluded(DocumentOrdinal ordinal) const {
+            if (!excluded_bits.empty()) {
+                return (excluded_bits[ordinal / 64] >> (ordinal % 64)) & 1;
+            }
+            return !excluded.empty() && std::binary_search(excluded.begin(), excluded.end(), ordinal);
+        }
+
+        // the first ordinal >= ordinal which document may pass DocumentFilter
+        DocumentOrdinal SkipFilteredBlocks(DocumentOrdinal ordinal) const {
+            if (next_passing_blocks.empty()) {
+                return ordinal;
+            }
+            const uint32_t block = ordinal / FILTER_BLOCK_SIZE;
+            const uint32_t next = next_passing_blocks[block];
+            return next == block ? ordinal : static_cast<DocumentOrdinal>(next * FILTER_BLOCK_SIZE);
+        }
     };
 
     // parsing query into words
     Query ParseQuery(std::string_view text) const; 
+    template <typename PrefixExpander>
+    Query ParseQuery(std::string_view text, PrefixExpander expand_prefix) const;
+
+    // adding dictionary words starting with prefix (no more than limit)
+    void ExpandPrefix(std::string_view prefix, size_t limit, QueryWords& words) const;
+
+    // adding weighted expansions of misspelled word (no more than max_expansions), expansions of required
+    // word are its group (see Query::required_groups)
+    void ExpandFuzzy(std::string_view word, bool is_required, Query& query) const;
+    // merging weights of expansions and adding them to plus-words (other plus-words have weight 1)
+    static void AddFuzzyWords(Query& query);
+
+    // ordinal of document in base, throws out_of_range
+    DocumentOrdinal GetOrdinal(int document_id) const;
+
+    // removing document from base after it is removed from inverted indexes
+    void ReleaseOrdinal(DocumentOrdinal ordinal);
+
+    // renumbering documents without gaps of removed ones (order is kept), O(postings)
+    void CompactOrdinals();
+
+    // summaries of blocks of ordinals (see FilterBlock)
+    void RebuildFilterBlocks();
+    // filling next_passing_blocks of plan for filter
+    void PlanFilter(const DocumentFilter& filter, Plan& plan) const;
+
+    // removing document from postings of word in additional indexes
+    void RemoveAdditionalPostings(std::string_view word, DocumentOrdinal ordinal);
+
+    // false only if document definitely hasn't word (by its Bloom filter), true if filters are disabled
+    bool MayContainWord(DocumentOrdinal ordinal, std::string_view word) const;
+    // Bloom filter of words of document
+    BlockedBloomFilter BuildDocumentFilter(DocumentOrdinal ordinal) const;
+
+    // signature of set of words (sorted, without duplicates)
+    static uint64_t ComputeSignature(const std::vector<std::string_view>& words);
+    // sorted words of document
+    std::vector<std::string_view> GetDocumentWords(DocumentOrdinal ordinal) const;
+    // documents with set of words (sorted, without duplicates) and its signature, in order of adding
+    std::vector<DocumentOrdinal> FindDuplicates(uint64_t signature, const std::vector<std::string_view>& words) const;
+    // adding document to index of signatures (it is recorded as duplicate of the earliest document with its words)
+    void AddSignature(DocumentOrdinal ordinal, uint64_t signature, const std::vector<std::string_view>& words);
+    // removing document from index of signatures, the earliest duplicate left becomes original of the others
+    void RemoveSignature(DocumentOrdinal ordinal);
+
+    // exact TOP of parsed query which is a hot term (the term is admitted if it becomes hot),
+    // nullopt if the query isn't single word or documents out of the list can be in TOP
+    std::optional<std::vector<Document>> FindHotTermTop(const Query& query, DocumentStatus status) const;
+    std::optional<std::vector<Document>> FindHotTermTop(const HotTerm& term, std::string_view word, DocumentStatus status) const;
+
+    // TOP lists of word by its postings
+    HotTerm BuildHotTerm(std::string_view word) const;
+    static void InsertHotPosting(HotTermTop& top, const HotPosting& posting);
+
+    // updating TOP lists of hot terms of document (it is in postings of its words)
+    void AddToHotTerms(DocumentOrdinal ordinal);
+    // the list is rebuilt if it has less than MAX_RESULT_DOCUMENT_COUNT postings (document isn't in postings)
+    void RemoveFromHotTerms(DocumentOrdinal ordinal);
+
+    // switching key of word (if index has it) to key
+    template <typename Index>
+    static void RekeyWord(Index& index, std::string_view word, std::string_view key);
+
+    // removing word from inverted index if it has no documents or moving its key to document which still contains it
+    void DetachWord(std::string_view word);
 
     // calculating IDF
     double ComputeWordInverseDocumentFreq(std::string_view word) const;
 
+    // order of scoring of plus-words: by descending IDF, then by word, so relevance is summed in the same
+    // order by sequential, impact-ordered and conjunctive search and by shards (with global IDF); parallel
+    // search adds contributions of words in order of completion of tasks
+    static bool IsScoredBefore(std::string_view lhs_word, double lhs_inverse_document_freq,
+        std::string_view rhs_word, double rhs_inverse_document_freq);
+
+    // planning query (without duplicates), inverse_document_freq(word) -> IDF of word which is in the base
+    template <typename InverseDocumentFreq>
+    Plan PlanQuery(const Query& query, InverseDocumentFreq inverse_document_freq_of) const;
+
+    // executor of parallel stages for policy: nullptr for sequenced_policy
+    template <typename ExecutionPolicy>
+    Executor* GetExecutor(const ExecutionPolicy& policy) const;
+
+    static std::shared_ptr<Executor> MakeExecutor(std::shared_ptr<Executor> executor);
+
+    // cost of query (without duplicates) by cost_model_
+    double EstimateQueryCost(const Query& query) const;
+
+    // count of tasks for query cost, 1 - sequential
+    size_t ChooseFanOut(double cost) const;
+
+    // TOP documents of query which is stopped when deadline expires (nullptr - no deadline)
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocumentsUntil(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate,
+        const QueryDeadlineCheck* deadline) const;
+    template <typename Predicate>
+    std::vector<Document> FindTopDocumentsUntil(const AdaptivePolicy& policy, std::string_view raw_query, Predicate predicate,
+        const QueryDeadlineCheck* deadline) const;
+
+    // search of words matched with parsed query (without duplicates) in document
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchQuery(const Query& query, DocumentOrdinal ordinal) const;
+    // the same by tasks of executor, duplicates of query are allowed
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchQueryParallel(const Query& query, DocumentOrdinal ordinal) const;
+
     // finding ALL documents according to query
     template <typename Predicate>
     std::vector<Document> FindAllDocuments(const Query& query, Predicate predicate) const;
 
     template <typename ExecutionPolicy, typename Predicate>
     std::vector<Document> FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate) const; 
+
+    // inverse_document_freq(word) -> IDF of word which is in the base
+    template <typename ExecutionPolicy, typename Predicate, typename InverseDocumentFreq>
+    std::vector<Document> FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate,
+        InverseDocumentFreq inverse_document_freq) const;
+
+    // can sequential TOP of query be found by impact-ordered postings
+    bool IsImpactOrderedQuery(const Query& query) const;
+
+    // sorted TOP count documents by impact-ordered postings (threshold algorithm): postings are read in order
+    // of descending contribution, every new document is scored completely, reading stops when bound of
+    // relevance of unread documents is less than relevance of the last document of TOP by EPSILON
+    template <typename Predicate>
+    std::vector<Document> FindTopDocumentsByImpact(const Query& query, Predicate predicate, size_t count) const;
+
+    // documents with all required words of plan: postings of required words are intersected from the
+    // shortest one, cursors of other postings seek the candidate (see SeekPosting); postings of required
+    // group are intersected as their union
+    template <typename Predicate>
+    std::vector<Document> FindAllDocumentsConjunctive(const Plan& plan, Predicate predicate) const;
+
+    // the first posting of document >= ordinal after it: LINEAR_SEEK_STEPS steps, then lower_bound
+    static DocumentFreqs::const_iterator SeekPosting(const DocumentFreqs& postings, DocumentFreqs::const_iterator it,
+        DocumentOrdinal ordinal);
+
+    // sequential search by scores of scoring_mode_ with impacts of type Impact
+    template <typename Impact, typename Predicate, typename InverseDocumentFreq>
+    std::vector<Document> FindAllDocumentsQuantized(const Query& query, Predicate predicate,
+        InverseDocumentFreq inverse_document_freq_of) const;
+
+    // words of query are split among fan_out tasks of executor (fan_out >= count of words -> task per word)
+    template <typename Predicate, typename InverseDocumentFreq>
+    std::vector<Document> FindAllDocumentsParallel(size_t fan_out, const Query& query, Predicate predicate,
+        InverseDocumentFreq inverse_document_freq) const;
 };
 
 
+class SearchServer::DocumentIdIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const int*;
+    using reference = const int&;
+
+    // removed documents in [current, end) are skipped
+    DocumentIdIterator(const DocumentData* current, const DocumentData* end);
+
+    reference operator*() const;
+    DocumentIdIterator& operator++();
+    DocumentIdIterator operator++(int);
+
+    bool operator==(const DocumentIdIterator& other) const;
+    bool operator!=(const DocumentIdIterator& other) const;
+
+private:
+    const DocumentData* current_;
+    const DocumentData* end_;
+
+    void SkipRemoved();
+};
+
 template<class Contaner>
-SearchServer::SearchServer(const Contaner& words) {
+SearchServer::SearchServer(const Contaner& words, std::shared_ptr<Executor> executor, std::pmr::memory_resource* memory_resource) :
+    memory_(std::make_unique<MemoryResources>(memory_resource)),
+    executor_(MakeExecutor(std::move(executor))) {
     for (const auto& word : words) {
         if (!IsValidWord(word)) {
             throw std::invalid_argument("Invalid stop-word (contains symbols from 0 to 31)");
         }
-        stop_words_.insert(static_cast<std::string>(word)); 
+        stop_words_.emplace(std::string_view(word));
     }
 }
 
@@ -160,28 +855,207 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 
 template <typename ExecutionPolicy, typename Predicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate) const {
-    Query query = ParseQuery(raw_query);
+    return FindTopDocumentsUntil(policy, raw_query, predicate, nullptr);
+}
+
+template <typename ExecutionPolicy, typename Predicate>
+TopDocumentsResult SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate,
+    const QueryDeadline& deadline) const {
+    const QueryDeadlineCheck check(deadline);
+    TopDocumentsResult result;
+    result.documents = FindTopDocumentsUntil(policy, raw_query, predicate, &check);
+    result.is_partial = check.WasExpired();
+    if (result.is_partial) {
+        METRICS_COUNT("find_top_documents.expired", 1);
+    }
+    check.ThrowIfExpired();
+    return result;
+}
 
-    RemoveDuplicates(policy, query.minus_words);
-    RemoveDuplicates(policy, query.plus_words);
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsUntil(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate,
+    const QueryDeadlineCheck* deadline) const {
+    METRICS_TIMER("find_top_documents");
+    QueryArenaScope arena;
+    Query query;
+    {
+        METRICS_TIMER("find_top_documents.parse");
+        query = ParseQuery(raw_query);
+
+        RemoveDuplicates(query.minus_words, GetExecutor(policy));
+        RemoveDuplicates(query.plus_words, GetExecutor(policy));
+    }
+    query.deadline = deadline;
+
+    if constexpr (std::is_same_v<Predicate, StatusPredicate>) {
+        if (auto documents = FindHotTermTop(query, predicate.status)) {
+            return std::move(*documents);
+        }
+    }
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        if (IsImpactOrderedQuery(query)) {
+            return FindTopDocumentsByImpact(query, predicate, MAX_RESULT_DOCUMENT_COUNT);
+        }
+    }
 
     std::vector<Document> matched_documents = FindAllDocuments(policy, query, predicate);
 
-    std::sort(policy, matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            }
-            return lhs.relevance > rhs.relevance;
-        });
+    METRICS_TIMER("find_top_documents.top_k");
+    SelectTopDocuments(matched_documents, GetExecutor(policy));
+
+    return matched_documents;
+}
+
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, const PageRequest& page, Predicate predicate) const {
+    METRICS_TIMER("find_top_documents");
+    QueryArenaScope arena;
+    Query query;
+    {
+        METRICS_TIMER("find_top_documents.parse");
+        query = ParseQuery(raw_query);
+
+        RemoveDuplicates(query.minus_words);
+        RemoveDuplicates(query.plus_words);
+    }
+
+    // saturated: limit may be max of size_t (all documents)
+    const size_t count = page.offset + std::min(page.limit, std::numeric_limits<size_t>::max() - page.offset);
+    if (!page.search_after && IsImpactOrderedQuery(query)) {
+        std::vector<Document> matched_documents = FindTopDocumentsByImpact(query, predicate, count);
+        matched_documents.erase(matched_documents.begin(),
+            matched_documents.begin() + std::min(page.offset, matched_documents.size()));
+        return matched_documents;
+    }
+
+    std::vector<Document> matched_documents = FindAllDocuments(std::execution::seq, query, predicate);
+
+    METRICS_TIMER("find_top_documents.top_k");
+    if (page.search_after) {
+        const Document last(page.search_after->id, page.search_after->relevance, page.search_after->rating);
+        matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(),
+            [&last](const Document& document) {
+                return !IsMoreRelevant(last, document);
+            }), matched_documents.end());
+    }
+    SelectTopDocuments(matched_documents, nullptr, count);
+    matched_documents.erase(matched_documents.begin(),
+        matched_documents.begin() + std::min(page.offset, matched_documents.size()));
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    return matched_documents;
+}
+
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(const AdaptivePolicy& policy, std::string_view raw_query, Predicate predicate) const {
+    return FindTopDocumentsUntil(policy, raw_query, predicate, nullptr);
+}
+
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsUntil(const AdaptivePolicy& policy, std::string_view raw_query, Predicate predicate,
+    const QueryDeadlineCheck* deadline) const {
+    METRICS_TIMER("find_top_documents");
+    QueryArenaScope arena;
+    Query query;
+    {
+        METRICS_TIMER("find_top_documents.parse");
+        query = ParseQuery(raw_query);
+
+        RemoveDuplicates(query.minus_words);
+        RemoveDuplicates(query.plus_words);
+    }
+    query.deadline = deadline;
+
+    if constexpr (std::is_same_v<Predicate, StatusPredicate>) {
+        if (auto documents = FindHotTermTop(query, predicate.status)) {
+            return std::move(*documents);
+        }
+    }
+    const size_t fan_out = ChooseFanOut(EstimateQueryCost(query));
+    if (fan_out == 1 && IsImpactOrderedQuery(query)) {
+        return FindTopDocumentsByImpact(query, predicate, MAX_RESULT_DOCUMENT_COUNT);
     }
+    if (fan_out == 1) {
+        std::vector<Document> matched_documents = FindAllDocuments(std::execution::seq, query, predicate);
+        METRICS_TIMER("find_top_documents.top_k");
+        SelectTopDocuments(matched_documents);
+        return matched_documents;
+    }
+
+    std::vector<Document> matched_documents = FindAllDocumentsParallel(fan_out, query, predicate,
+        [this](std::string_view word) {
+            return ComputeWordInverseDocumentFreq(word);
+        });
+    METRICS_TIMER("find_top_documents.top_k");
+    SelectTopDocuments(matched_documents, executor_.get());
 
     return matched_documents;
 }
 
+template <typename Predicate>
+std::future<std::vector<Document>> SearchServer::FindTopDocumentsAsync(std::string raw_query, Predicate predicate, QueryTaskOptions options) const {
+    auto promise = std::make_shared<std::promise<std::vector<Document>>>();
+    auto result = promise->get_future();
+
+    auto task = [this, promise, raw_query = std::move(raw_query), predicate, cancellation = options.cancellation,
+        deadline = options.deadline] {
+        try {
+            if (cancellation.IsCancelled()) {
+                throw TaskCancelledError("Query is cancelled"s);
+            }
+            const QueryDeadline query_deadline{ deadline, cancellation, ExpiryPolicy::THROW };
+            promise->set_value(FindTopDocuments(std::execution::seq, raw_query, predicate, query_deadline).documents);
+        }
+        catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+    };
+
+    if (!executor_->TrySubmit(std::move(task), options.priority)) {
+        throw std::runtime_error("Queue of queries is full"s);
+    }
+    return result;
+}
+
+template <typename ExecutionPolicy>
+Executor* SearchServer::GetExecutor(const ExecutionPolicy& policy) const {
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        return nullptr;
+    }
+    else {
+        return executor_.get();
+    }
+}
+
+template <typename PrefixExpander>
+SearchServer::Query SearchServer::ParseQuery(std::string_view text, PrefixExpander expand_prefix) const {
+    Query query;
+
+    for (auto word : SplitIntoWords(text)) {
+        const QueryWord query_word = ParseQueryWord(word);
+
+        if (query_word.is_prefix) {
+            expand_prefix(query_word.data, query_word.is_minus, query_word.is_minus ? query.minus_words : query.plus_words);
+        }
+        else if (!query_word.is_stop) {
+            if (query_word.is_minus) {
+                query.minus_words.push_back(query_word.data);
+            }
+            else if (fuzzy_index_ && word_to_document_freqs_.count(query_word.data) == 0) {
+                ExpandFuzzy(query_word.data, query_word.is_required || match_mode_ == MatchMode::ALL, query);
+            }
+            else {
+                query.plus_words.push_back(query_word.data);
+                if (query_word.is_required || match_mode_ == MatchMode::ALL) {
+                    query.required_words.push_back(query_word.data);
+                }
+            }
+        }
+    }
+    RemoveDuplicates(query.required_words);
+    AddFuzzyWords(query);
+    return query;
+}
+
 template <typename Predicate>
 std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Predicate predicate) const {
     return FindAllDocuments(std::execution::seq, query, predicate);
@@ -189,74 +1063,489 @@ std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Predica
 
 template <typename ExecutionPolicy, typename Predicate>
 std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate) const {
+    return FindAllDocuments(policy, query, predicate,
+        [this](std::string_view word) {
+            return ComputeWordInverseDocumentFreq(word);
+        });
+}
+
+template <typename ExecutionPolicy, typename Predicate, typename InverseDocumentFreq>
+std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate,
+    InverseDocumentFreq inverse_document_freq_of) const {
     if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
-        std::map<int, double> document_to_relevance;
+        if (scoring_mode_ == ScoringMode::QUANTIZED_8 && !query.HasRequiredWords()) {
+            return FindAllDocumentsQuantized<uint8_t>(query, predicate, inverse_document_freq_of);
+        }
+        if (scoring_mode_ == ScoringMode::QUANTIZED_16 && !query.HasRequiredWords()) {
+            return FindAllDocumentsQuantized<uint16_t>(query, predicate, inverse_document_freq_of);
+        }
 
-        for (const auto& word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
+        Plan plan = PlanQuery(query, inverse_document_freq_of);
+        if constexpr (std::is_same_v<Predicate, DocumentFilter>) {
+            PlanFilter(predicate, plan);
+        }
+        if (plan.has_required_words) {
+            return FindAllDocumentsConjunctive(plan, predicate);
+        }
+        std::pmr::map<DocumentOrdinal, double> document_to_relevance(GetQueryResource());
+
+        for (const PlannedWord& step : plan.plus_words) {
+            if (step.is_skipped) {
                 continue;
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const DocumentData data = documents_.at(document_id);
-                if (predicate(document_id, data.status, data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+
+            METRICS_TIMER("find_top_documents.scoring");
+            size_t scanned_count = 0;
+            size_t filtered_count = 0;
+            size_t excluded_count = 0;
+            size_t skipped_block_count = 0;
+            for (auto it = step.postings->begin(); it != step.postings->end(); ++it) {
+                if constexpr (std::is_same_v<Predicate, DocumentFilter>) {
+                    // the posting found may be in other failing block
+                    while (it != step.postings->end()) {
+                        const DocumentOrdinal passing = plan.SkipFilteredBlocks(it->first);
+                        if (passing == it->first) {
+                            break;
+                        }
+                        ++skipped_block_count;
+                        it = SeekPosting(*step.postings, it, passing);
+                    }
+                    if (it == step.postings->end()) {
+                        break;
+                    }
+                }
+                if (scanned_count % QUERY_CHECK_BLOCK_SIZE == 0 && plan.IsExpired()) {
+                    break;
+                }
+                ++scanned_count;
+                const auto& [ordinal, term_freq] = *it;
+                if (plan.IsExcluded(ordinal)) {
+                    ++excluded_count;
+                    continue;
+                }
+                const DocumentData& data = documents_[ordinal];
+                if (predicate(data.id, data.status, data.rating)) {
+                    document_to_relevance[ordinal] += term_freq * step.inverse_document_freq;
+                }
+                else {
+                    ++filtered_count;
                 }
             }
+            METRICS_COUNT("find_top_documents.postings_scanned", scanned_count);
+            METRICS_COUNT("find_top_documents.filter_blocks_skipped", skipped_block_count);
+            METRICS_COUNT("find_top_documents.documents_filtered", filtered_count);
+            METRICS_COUNT("find_top_documents.documents_excluded", excluded_count);
+        }
+
+        std::vector<Document> matched_documents;
+        for (const auto& [ordinal, relevance] : document_to_relevance) {
+            matched_documents.push_back({ documents_[ordinal].id, relevance, documents_[ordinal].rating });
         }
 
+        return matched_documents;
+    }
+
+    return FindAllDocumentsParallel(std::numeric_limits<size_t>::max(), query, predicate, inverse_document_freq_of);
+}
+
+template <typename Index>
+void SearchServer::RekeyWord(Index& index, std::string_view word, std::string_view key) {
+    const auto it = index.find(word);
+    if (it == index.end()) {
+        return;
+    }
+    auto node = index.extract(it);
+    node.key() = key;
+    index.insert(std::move(node));
+}
+
+template <typename InverseDocumentFreq>
+SearchServer::Plan SearchServer::PlanQuery(const Query& query, InverseDocumentFreq inverse_document_freq_of) const {
+    METRICS_TIMER("find_top_documents.planning");
+    Plan plan;
+    plan.deadline = query.deadline;
+    auto find_postings = [this](std::string_view word) -> const DocumentFreqs* {
+        const auto it = word_to_document_freqs_.find(word);
+        return it == word_to_document_freqs_.end() ? nullptr : &it->second;
+    };
+
+    {
+        METRICS_TIMER("find_top_documents.minus_filtering");
         for (const auto& word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
+            const DocumentFreqs* postings = find_postings(word);
+            plan.minus_words.push_back({ word, postings, 0, postings == nullptr });
+        }
+        std::sort(plan.minus_words.begin(), plan.minus_words.end(),
+            [](const PlannedWord& lhs, const PlannedWord& rhs) {
+                return (lhs.postings ? lhs.postings->size() : 0) < (rhs.postings ? rhs.postings->size() : 0);
+            });
+        // postings are sorted, so ordinals of every word are merged into the list; scoring of expired query
+        // stops at its first posting, so incomplete list isn't used
+        size_t scanned_count = 0;
+        for (const PlannedWord& step : plan.minus_words) {
+            if (step.is_skipped) {
+                continue;
+            }
+            const size_t merged_count = plan.excluded.size();
+            for (const auto& [ordinal, _] : *step.postings) {
+                if (scanned_count++ % QUERY_CHECK_BLOCK_SIZE == 0 && plan.IsExpired()) {
+                    break;
+                }
+                plan.excluded.push_back(ordinal);
+            }
+            std::inplace_merge(plan.excluded.begin(), plan.excluded.begin() + merged_count, plan.excluded.end());
+            plan.excluded.erase(std::unique(plan.excluded.begin(), plan.excluded.end()), plan.excluded.end());
+        }
+        METRICS_COUNT("find_top_documents.minus_postings_scanned", scanned_count);
+        plan.excluded_document_count = plan.excluded.size();
+        if (plan.excluded.size() > documents_.size() * EXCLUDED_BITSET_SHARE) {
+            plan.excluded_bits.assign((documents_.size() + 63) / 64, 0);
+            for (const DocumentOrdinal ordinal : plan.excluded) {
+                plan.excluded_bits[ordinal / 64] |= uint64_t{ 1 } << (ordinal % 64);
+            }
+            plan.excluded.clear();
+        }
+    }
+
+    plan.has_required_words = query.HasRequiredWords();
+    plan.required_groups = query.required_groups;
+    for (const auto& word : query.plus_words) {
+        const bool is_required = std::binary_search(query.required_words.begin(), query.required_words.end(), word);
+        const DocumentFreqs* postings = find_postings(word);
+        if (postings == nullptr) {
+            plan.plus_words.push_back({ word, nullptr, 0, true, is_required });
+            continue;
+        }
+        // documents of short postings are often all excluded, the check stops at the first document left
+        const bool is_excluded = postings->size() <= plan.excluded_document_count
+            && std::all_of(postings->begin(), postings->end(),
+                [&plan](const auto& posting) {
+                    return plan.IsExcluded(posting.first);
+                });
+        plan.plus_words.push_back({ word, postings, query.GetWordWeight(word) * inverse_document_freq_of(word), is_excluded,
+            is_required });
+    }
+    std::sort(plan.plus_words.begin(), plan.plus_words.end(),
+        [](const PlannedWord& lhs, const PlannedWord& rhs) {
+            return IsScoredBefore(lhs.word, lhs.inverse_document_freq, rhs.word, rhs.inverse_document_freq);
+        });
+
+    return plan;
+}
+
+template <typename Predicate>
+std::vector<Document> SearchServer::FindAllDocumentsConjunctive(const Plan& plan, Predicate predicate) const {
+    METRICS_TIMER("find_top_documents.intersection");
+    std::vector<Document> matched_documents;
+
+    // cursors of not skipped plus-words (in order of plan)
+    std::pmr::vector<const PlannedWord*> steps(GetQueryResource());
+    std::pmr::vector<DocumentFreqs::const_iterator> cursors(GetQueryResource());
+    for (const PlannedWord& step : plan.plus_words) {
+        if (step.is_required && step.is_skipped) {
+            // required word isn't in the index or all its documents are excluded
+            return matched_documents;
+        }
+        if (!step.is_skipped) {
+            steps.push_back(&step);
+            cursors.push_back(step.postings->begin());
+        }
+    }
+    // intersected groups of steps: required word is a group of one step, document has some step of each group
+    std::pmr::vector<std::pmr::vector<size_t>> groups(GetQueryResource());
+    for (size_t i = 0; i < steps.size(); ++i) {
+        if (steps[i]->is_required) {
+            groups.emplace_back().push_back(i);
+        }
+    }
+    for (const QueryWords& words : plan.required_groups) {
+        auto& group = groups.emplace_back();
+        for (size_t i = 0; i < steps.size(); ++i) {
+            if (std::find(words.begin(), words.end(), steps[i]->word) != words.end()) {
+                group.push_back(i);
+            }
+        }
+        if (group.empty()) {
+            // expansions of misspelled required word aren't in the index or all their documents are excluded
+            return matched_documents;
+        }
+    }
+    auto count_postings = [&steps](const std::pmr::vector<size_t>& group) {
+        size_t count = 0;
+        for (const size_t i : group) {
+            count += steps[i]->postings->size();
+        }
+        return count;
+    };
+    std::sort(groups.begin(), groups.end(),
+        [&count_postings](const auto& lhs, const auto& rhs) {
+            return count_postings(lhs) < count_postings(rhs);
+        });
+
+    // the first document >= ordinal in postings of group, nullopt if all of them are passed
+    auto seek_group = [&steps, &cursors](const std::pmr::vector<size_t>& group, DocumentOrdinal ordinal) {
+        std::optional<DocumentOrdinal> first;
+        for (const size_t i : group) {
+            cursors[i] = SeekPosting(*steps[i]->postings, cursors[i], ordinal);
+            if (cursors[i] != steps[i]->postings->end() && (!first || cursors[i]->first < *first)) {
+                first = cursors[i]->first;
+            }
+        }
+        return first;
+    };
+
+    const auto& lead = groups.front();
+    std::optional<DocumentOrdinal> candidate = seek_group(lead, 0);
+    size_t scanned_count = 0;
+    size_t candidate_count = 0;
+    while (candidate) {
+        if (candidate_count++ % QUERY_CHECK_BLOCK_SIZE == 0 && plan.IsExpired()) {
+            break;
+        }
+        if constexpr (std::is_same_v<Predicate, DocumentFilter>) {
+            const DocumentOrdinal passing = plan.SkipFilteredBlocks(*candidate);
+            if (passing != *candidate) {
+                candidate = seek_group(lead, passing);
                 continue;
             }
-            for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
+        }
+        ++scanned_count;
+        // leapfrog: the first group which is past candidate moves the lead to its document
+        std::optional<DocumentOrdinal> next = candidate;
+        for (size_t i = 1; i < groups.size() && next == candidate; ++i) {
+            next = seek_group(groups[i], *candidate);
+            scanned_count += groups[i].size();
+        }
+        if (!next) {
+            break;
+        }
+        if (*next != *candidate) {
+            candidate = seek_group(lead, *next);
+            continue;
+        }
+
+        const DocumentData& data = documents_[*candidate];
+        if (!plan.IsExcluded(*candidate) && predicate(data.id, data.status, data.rating)) {
+            // summed in order of plan, words out of the groups are found in their postings
+            double relevance = 0;
+            for (size_t i = 0; i < steps.size(); ++i) {
+                cursors[i] = SeekPosting(*steps[i]->postings, cursors[i], *candidate);
+                if (cursors[i] != steps[i]->postings->end() && cursors[i]->first == *candidate) {
+                    relevance += cursors[i]->second * steps[i]->inverse_document_freq;
+                }
             }
+            matched_documents.push_back({ data.id, relevance, data.rating });
         }
+        candidate = seek_group(lead, *candidate + 1);
+    }
+    METRICS_COUNT("find_top_documents.postings_scanned", scanned_count);
 
+    return matched_documents;
+}
 
-        std::vector<Document> matched_documents;
-        for (const auto& [document_id, relevance] : document_to_relevance) {
-            matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const Query& query, Predicate predicate, size_t count) const {
+    METRICS_TIMER("find_top_documents.impact_ordered");
+    if (count == 0) {
+        return {};
+    }
+    struct PostingCursor {
+        std::string_view word;
+        ImpactPostings::const_iterator current;
+        ImpactPostings::const_iterator end;
+        const DocumentFreqs* document_freqs;
+        double inverse_document_freq;
+    };
+    // in order of plan: relevance is summed in the same order as in FindAllDocuments
+    std::vector<PostingCursor> cursors;
+    for (const auto& word : query.plus_words) {
+        const auto it = word_to_impact_postings_.find(word);
+        if (it != word_to_impact_postings_.end()) {
+            cursors.push_back({ it->first, it->second.begin(), it->second.end(), &word_to_document_freqs_.at(word),
+                ComputeWordInverseDocumentFreq(word) });
         }
+    }
+    std::sort(cursors.begin(), cursors.end(),
+        [](const PostingCursor& lhs, const PostingCursor& rhs) {
+            return IsScoredBefore(lhs.word, lhs.inverse_document_freq, rhs.word, rhs.inverse_document_freq);
+        });
 
-        return matched_documents;
+    std::vector<Document> top;
+    std::pmr::set<DocumentOrdinal> scored_documents(GetQueryResource());
+    size_t scanned_count = 0;
+    while (true) {
+        double bound = 0;
+        PostingCursor* next = nullptr;
+        double next_contribution = -1;
+        for (auto& cursor : cursors) {
+            if (cursor.current == cursor.end) {
+                continue;
+            }
+            const double contribution = cursor.current->term_freq * cursor.inverse_document_freq;
+            bound += contribution;
+            if (contribution > next_contribution) {
+                next_contribution = contribution;
+                next = &cursor;
+            }
+        }
+        if (next == nullptr || (top.size() == count && bound <= top.back().relevance - EPSILON)) {
+            break;
+        }
+        if (scanned_count % QUERY_CHECK_BLOCK_SIZE == 0 && query.IsExpired()) {
+            break;
+        }
+
+        const DocumentOrdinal ordinal = next->current->ordinal;
+        ++next->current;
+        ++scanned_count;
+        if (cursors.size() > 1 && !scored_documents.insert(ordinal).second) {
+            continue;
+        }
+        const DocumentData& data = documents_[ordinal];
+        if (!predicate(data.id, data.status, data.rating)) {
+            continue;
+        }
+        const bool is_excluded = std::any_of(query.minus_words.begin(), query.minus_words.end(),
+            [this, ordinal](std::string_view word) {
+                if (!MayContainWord(ordinal, word)) {
+                    return false;
+                }
+                const auto it = word_to_document_freqs_.find(word);
+                return it != word_to_document_freqs_.end() && it->second.count(ordinal) > 0;
+            });
+        if (is_excluded) {
+            continue;
+        }
+
+        double relevance = 0;
+        for (const auto& cursor : cursors) {
+            const auto it = cursor.document_freqs->find(ordinal);
+            if (it != cursor.document_freqs->end()) {
+                relevance += it->second * cursor.inverse_document_freq;
+            }
+        }
+        const Document document(data.id, relevance, data.rating);
+        top.insert(std::upper_bound(top.begin(), top.end(), document, IsMoreRelevant), document);
+        if (top.size() > count) {
+            top.pop_back();
+        }
     }
+    METRICS_COUNT("find_top_documents.postings_scanned", scanned_count);
 
-    ConcurrentMap<int, double> document_to_relevance(THREAD_COUNT);
+    return top;
+}
 
-    auto fn_plus = [&](std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            return;
+template <typename Impact, typename Predicate, typename InverseDocumentFreq>
+std::vector<Document> SearchServer::FindAllDocumentsQuantized(const Query& query, Predicate predicate,
+    InverseDocumentFreq inverse_document_freq_of) const {
+    ScoreAccumulator& accumulator = ScoreAccumulator::ForThread(documents_.size());
+
+    for (const auto& word : query.plus_words) {
+        const QuantizedPostings* postings = nullptr;
+        uint32_t inverse_document_freq = 0;
+        {
+            METRICS_TIMER("find_top_documents.posting_fetch");
+            const auto it = word_to_quantized_postings_.find(word);
+            if (it == word_to_quantized_postings_.end()) {
+                continue;
+            }
+            postings = &it->second;
+            inverse_document_freq = QuantizeIdf(query.GetWordWeight(word) * inverse_document_freq_of(word));
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
 
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const DocumentData data = documents_.at(document_id);
-            if (predicate(document_id, data.status, data.rating)) {
-                document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+        METRICS_TIMER("find_top_documents.scoring");
+        const size_t count = postings->slots.size();
+        size_t scanned_count = 0;
+        while (scanned_count < count && !query.IsExpired()) {
+            const size_t size = std::min(QUERY_CHECK_BLOCK_SIZE, count - scanned_count);
+            accumulator.Accumulate(postings->slots.data() + scanned_count, postings->GetImpacts<Impact>() + scanned_count,
+                size, inverse_document_freq);
+            scanned_count += size;
+        }
+        METRICS_COUNT("find_top_documents.postings_scanned", scanned_count);
+    }
+
+    {
+        METRICS_TIMER("find_top_documents.minus_filtering");
+        for (const auto& word : query.minus_words) {
+            const auto it = word_to_quantized_postings_.find(word);
+            if (it != word_to_quantized_postings_.end()) {
+                accumulator.Exclude(it->second.slots.data(), it->second.slots.size());
             }
         }
-    };
+    }
 
-    std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), fn_plus);
+    // predicate is checked once per document instead of once per posting
+    const double scale = 1.0 / (static_cast<double>(GetImpactScale(scoring_mode_)) * (1 << IDF_FRACTION_BITS));
+    std::vector<Document> matched_documents;
+    size_t filtered_count = 0;
+    accumulator.Collect([&](DocumentOrdinal ordinal, uint64_t score) {
+        const DocumentData& document = documents_[ordinal];
+        if (predicate(document.id, document.status, document.rating)) {
+            matched_documents.push_back({ document.id, score * scale, document.rating });
+        }
+        else {
+            ++filtered_count;
+        }
+    });
+    METRICS_COUNT("find_top_documents.documents_filtered", filtered_count);
+
+    return matched_documents;
+}
 
-    auto fn_minus = [&](std::string_view word) {
-        if (word_to_document_freqs_.count(word) == 0) {
+template <typename Predicate, typename InverseDocumentFreq>
+std::vector<Document> SearchServer::FindAllDocumentsParallel(size_t fan_out, const Query& query, Predicate predicate,
+    InverseDocumentFreq inverse_document_freq_of) const {
+    ConcurrentMap<DocumentOrdinal, double> document_to_relevance(std::min(fan_out, executor_->GetConcurrency()) * BUCKETS_PER_THREAD);
+
+    // excluded documents are known before scoring, so tasks only read the plan
+    const Plan plan = PlanQuery(query, inverse_document_freq_of);
+    if (plan.has_required_words) {
+        // intersection touches few postings, it isn't split
+        return FindAllDocumentsConjunctive(plan, predicate);
+    }
+
+    auto fn_plus = [&](const PlannedWord& step) {
+        if (step.is_skipped) {
             return;
         }
-        for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+
+        METRICS_TIMER("find_top_documents.scoring");
+        size_t scanned_count = 0;
+        size_t filtered_count = 0;
+        for (const auto& [ordinal, term_freq] : *step.postings) {
+            if (scanned_count % QUERY_CHECK_BLOCK_SIZE == 0 && plan.IsExpired()) {
+                break;
+            }
+            ++scanned_count;
+            if (plan.IsExcluded(ordinal)) {
+                continue;
+            }
+            const DocumentData& data = documents_[ordinal];
+            if (predicate(data.id, data.status, data.rating)) {
+                document_to_relevance[ordinal].ref_to_value += term_freq * step.inverse_document_freq;
+            }
+            else {
+                ++filtered_count;
+            }
         }
+        METRICS_COUNT("find_top_documents.postings_scanned", scanned_count);
+        METRICS_COUNT("find_top_documents.documents_filtered", filtered_count);
     };
 
-    std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), fn_minus);
+    const size_t plus_task_count = std::min(fan_out, plan.plus_words.size());
+    executor_->ParallelFor(plus_task_count,
+        [&](size_t task) {
+            for (size_t i = task; i < plan.plus_words.size(); i += plus_task_count) {
+                fn_plus(plan.plus_words[i]);
+            }
+        });
 
     std::vector<Document> matched_documents;
     auto whole = document_to_relevance.BuildOrdinaryMap();
     matched_documents.reserve(whole.size());
-    for (const auto& [document_id, relevance] : whole) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    for (const auto& [ordinal, relevance] : whole) {
+        matched_documents.push_back({ documents_[ordinal].id, relevance, documents_[ordinal].rating });
     }
 
     return matched_documents;
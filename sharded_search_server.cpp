@@ -0,0 +1,133 @@
+#include "sharded_search_server.h"
+#include <cmath>
+#include <functional>
+
+using namespace std;
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const string& text, shared_ptr<Executor> executor) :
+    ShardedSearchServer(shard_count, string_view(text), move(executor)) {
+
+}
+
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, string_view text, shared_ptr<Executor> executor) :
+    executor_(SearchServer::MakeExecutor(move(executor))) {
+    if (shard_count == 0) {
+        throw invalid_argument("Shard count must be positive");
+    }
+    const auto dictionary = make_shared<const SharedDictionary>(text);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(dictionary, executor_);
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, string_view document, const DocumentStatus& status, const vector<int>& ratings) {
+    SearchServer& shard = GetShard(document_id);
+    shard.AddDocument(document_id, document, status, ratings); // checks ID and words
+    document_ids_.insert(document_id);
+
+    for (const auto& [word, _] : shard.GetWordFrequencies(document_id)) {
+        auto it = document_freqs_.find(word);
+        if (it == document_freqs_.end()) {
+            document_freqs_.emplace(word, 1);
+        }
+        else {
+            ++it->second;
+        }
+    }
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(string_view raw_query, const DocumentStatus& status) const {
+    return FindTopDocuments(execution::par, raw_query, status);
+}
+
+size_t ShardedSearchServer::GetDocumentCount() const {
+    return document_ids_.size();
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(string_view raw_query, const int document_id) const {
+    QueryArenaScope arena;
+    if (!document_ids_.count(document_id)) {
+        throw out_of_range("Document ID is not found"s);
+    }
+
+    SearchServer::Query query = ParseQuery(raw_query);
+
+    RemoveDuplicates(query.minus_words);
+    RemoveDuplicates(query.plus_words);
+
+    const SearchServer& shard = GetShard(document_id);
+    return shard.MatchQuery(query, shard.GetOrdinal(document_id));
+}
+
+const WordFrequencies& ShardedSearchServer::GetWordFrequencies(int document_id) const {
+    return GetShard(document_id).GetWordFrequencies(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    if (document_ids_.find(document_id) == document_ids_.end()) {
+        return;
+    }
+
+    SearchServer& shard = GetShard(document_id);
+    for (const auto& [word, _] : shard.GetWordFrequencies(document_id)) {
+        auto it = document_freqs_.find(word);
+        if (--it->second == 0) {
+            document_freqs_.erase(it);
+        }
+    }
+
+    shard.RemoveDocument(document_id);
+    document_ids_.erase(document_id);
+}
+
+MemoryUsage ShardedSearchServer::GetMemoryUsage() const {
+    MemoryUsage usage;
+    for (const SearchServer& shard : shards_) {
+        usage += shard.GetMemoryUsage();
+    }
+    return usage;
+}
+
+void ShardedSearchServer::SetPrefixExpansionLimit(size_t limit) {
+    prefix_expansion_limit_ = limit;
+}
+
+void ShardedSearchServer::SetMatchMode(MatchMode mode) {
+    for (SearchServer& shard : shards_) {
+        shard.SetMatchMode(mode);
+    }
+}
+
+SearchServer& ShardedSearchServer::GetShard(int document_id) {
+    return shards_[hash<int>{}(document_id) % shards_.size()];
+}
+
+const SearchServer& ShardedSearchServer::GetShard(int document_id) const {
+    return shards_[hash<int>{}(document_id) % shards_.size()];
+}
+
+SearchServer::Query ShardedSearchServer::ParseQuery(string_view text) const {
+    // stop-words are the same in all shards
+    return shards_.front().ParseQuery(text,
+        [this](string_view prefix, bool is_minus, QueryWords& words) {
+            // minus prefix excludes documents of all its words
+            const size_t limit = is_minus ? numeric_limits<size_t>::max() : prefix_expansion_limit_;
+            size_t expanded = 0;
+            for (auto it = document_freqs_.lower_bound(prefix);
+                it != document_freqs_.end() && expanded < limit;
+                ++it, ++expanded) {
+                if (string_view(it->first).substr(0, prefix.size()) != prefix) {
+                    break;
+                }
+                words.push_back(it->first);
+            }
+        });
+}
+
+double ShardedSearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
+    return log(GetDocumentCount() * 1.0 / document_freqs_.find(word)->second);
+}
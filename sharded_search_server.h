@@ -0,0 +1,153 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <execution>
+#include "document.h"
+#include "search_server.h"
+
+// SearchServer split into shards by document ID hash.
+// Query is run on all shards, TOP documents of shards are merged.
+// Document frequencies of words are global, so results are the same as for one SearchServer.
+class ShardedSearchServer {
+public:
+    //construct ShardedSearchServer from string containing stop-words
+    //executor queries shards in parallel and is shared by shards (nullptr -> own ThreadPool), stop-words
+    //are shared by shards as well (see SharedDictionary)
+    ShardedSearchServer(size_t shard_count, const std::string& text, std::shared_ptr<Executor> executor = nullptr);
+    ShardedSearchServer(size_t shard_count, std::string_view text, std::shared_ptr<Executor> executor = nullptr);
+
+    //construct ShardedSearchServer from container of stop-words (set, vector, etc.)
+    template<class Contaner>
+    ShardedSearchServer(size_t shard_count, const Contaner& words, std::shared_ptr<Executor> executor = nullptr);
+
+    //adding document in shard chosen by document ID
+    void AddDocument(int document_id, std::string_view document, const DocumentStatus& status, const std::vector<int>& ratings);
+
+    auto begin() const {
+        return document_ids_.cbegin();
+    }
+
+    auto end() const {
+        return document_ids_.cend();
+    }
+
+    //finding top MAX_RESULT_DOCUMENT_COUNT documents by status, shards are queried in parallel
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, const DocumentStatus& status = DocumentStatus::ACTUAL) const;
+    template <typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, const DocumentStatus& status = DocumentStatus::ACTUAL) const {
+        return FindTopDocuments(policy, raw_query,
+            [status](const int document_id, const DocumentStatus& local_status, const int rating) {
+                return status == local_status;
+            });
+    }
+
+    //finding top MAX_RESULT_DOCUMENT_COUNT documents by predicate, shards are queried in parallel
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate predicate) const;
+    //policy defines how shards are queried (one by one or in parallel)
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate) const;
+
+    //getting count of documents in all shards
+    size_t GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+
+    //search of words matched with query in document with id
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, const int document_id) const;
+
+    //return frequencies of all words in document
+    const WordFrequencies& GetWordFrequencies(int document_id) const;
+
+    void RemoveDocument(int document_id);
+
+    //sum of memory usage of shards (global dictionary isn't counted)
+    MemoryUsage GetMemoryUsage() const;
+
+    //max count of dictionary words a prefix query word (e.g. "cat*") is expanded into
+    void SetPrefixExpansionLimit(size_t limit);
+
+    //mode of queries in all shards (see MatchMode)
+    void SetMatchMode(MatchMode mode);
+
+private:
+    // deque doesn't move shards when growing
+    std::deque<SearchServer> shards_;
+
+    std::set<int> document_ids_;
+
+    // global dictionary: word -> count of documents containing it in all shards
+    std::map<std::string, int, std::less<>> document_freqs_;
+
+    size_t prefix_expansion_limit_ = MAX_PREFIX_EXPANSION;
+
+    std::shared_ptr<Executor> executor_;
+
+    SearchServer& GetShard(int document_id);
+    const SearchServer& GetShard(int document_id) const;
+
+    // parsing query into words, prefixes are expanded by global dictionary
+    SearchServer::Query ParseQuery(std::string_view text) const;
+
+    // calculating global IDF
+    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+};
+
+template<class Contaner>
+ShardedSearchServer::ShardedSearchServer(size_t shard_count, const Contaner& words, std::shared_ptr<Executor> executor) :
+    executor_(SearchServer::MakeExecutor(std::move(executor))) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive");
+    }
+    const auto dictionary = std::make_shared<const SharedDictionary>(words);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(dictionary, executor_);
+    }
+}
+
+template <typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, Predicate predicate) const {
+    return FindTopDocuments(std::execution::par, raw_query, predicate);
+}
+
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate) const {
+    QueryArenaScope arena;
+    SearchServer::Query query = ParseQuery(raw_query);
+
+    RemoveDuplicates(query.minus_words);
+    RemoveDuplicates(query.plus_words);
+
+    auto inverse_document_freq = [this](std::string_view word) {
+        return ComputeWordInverseDocumentFreq(word);
+    };
+
+    // scatter: TOP documents of every shard
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    auto find_in_shard = [&](size_t i) {
+        shard_documents[i] = shards_[i].FindAllDocuments(std::execution::seq, query, predicate, inverse_document_freq);
+        SelectTopDocuments(shard_documents[i]);
+    };
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            find_in_shard(i);
+        }
+    }
+    else {
+        executor_->ParallelFor(shards_.size(), find_in_shard);
+    }
+
+    // gather: TOP of TOPs
+    std::vector<Document> matched_documents;
+    matched_documents.reserve(shards_.size() * MAX_RESULT_DOCUMENT_COUNT);
+    for (const auto& documents : shard_documents) {
+        matched_documents.insert(matched_documents.end(), documents.begin(), documents.end());
+    }
+    SelectTopDocuments(matched_documents);
+
+    return matched_documents;
+}
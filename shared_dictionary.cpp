@@ -0,0 +1,74 @@
+#include "shared_dictionary.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+bool FindSorted(const vector<string_view>& words, string_view word, string_view& found) {
+    const auto it = lower_bound(words.begin(), words.end(), word);
+    if (it == words.end() || *it != word) {
+        return false;
+    }
+    found = *it;
+    return true;
+}
+
+} // namespace
+
+SharedDictionary::SharedDictionary(const string& stop_words, const vector<string>& terms) :
+    SharedDictionary(string_view(stop_words), terms) {
+}
+
+SharedDictionary::SharedDictionary(string_view stop_words, const vector<string>& terms) {
+    Init(SplitIntoWords(stop_words), vector<string_view>(terms.begin(), terms.end()));
+}
+
+bool SharedDictionary::IsStopWord(string_view word) const {
+    string_view found;
+    return FindSorted(stop_words_, word, found);
+}
+
+string_view SharedDictionary::FindTerm(string_view word) const {
+    string_view found;
+    FindSorted(terms_, word, found);
+    return found;
+}
+
+const vector<string_view>& SharedDictionary::GetStopWords() const {
+    return stop_words_;
+}
+
+size_t SharedDictionary::GetTermCount() const {
+    return terms_.size();
+}
+
+size_t SharedDictionary::GetMemoryUsage() const {
+    return characters_.capacity() + (stop_words_.capacity() + terms_.capacity()) * sizeof(string_view);
+}
+
+void SharedDictionary::Init(vector<string_view> stop_words, vector<string_view> terms) {
+    size_t size = 0;
+    for (auto* words : { &stop_words, &terms }) {
+        words->erase(remove(words->begin(), words->end(), string_view()), words->end());
+        sort(words->begin(), words->end());
+        words->erase(unique(words->begin(), words->end()), words->end());
+        for (const string_view word : *words) {
+            if (any_of(word.begin(), word.end(), [](char c) { return c >= '\0' && c < ' '; })) {
+                throw invalid_argument("Invalid word of dictionary (contains symbols from 0 to 31)"s);
+            }
+            size += word.size();
+        }
+    }
+
+    // buffer isn't reallocated, so views of it stay valid
+    characters_.reserve(size);
+    for (auto [words, views] : { pair{ &stop_words, &stop_words_ }, pair{ &terms, &terms_ } }) {
+        views->reserve(words->size());
+        for (const string_view word : *words) {
+            views->push_back(string_view(characters_.data() + characters_.size(), word.size()));
+            characters_ += word;
+        }
+    }
+}
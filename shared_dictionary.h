@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "string_processing.h"
+
+// Immutable dictionary of stop-words and interned terms shared by many servers (e.g. servers of tenants):
+// attached server keeps no stop-words of its own and keys of its indexes view terms of the dictionary
+// instead of texts of documents. Strings are stored in one buffer, lookups are binary searches.
+class SharedDictionary {
+public:
+    //construct dictionary from string containing stop-words and container of terms
+    explicit SharedDictionary(const std::string& stop_words, const std::vector<std::string>& terms = {});
+    explicit SharedDictionary(std::string_view stop_words, const std::vector<std::string>& terms = {});
+
+    //construct dictionary from containers of stop-words and terms (set, vector, etc.)
+    template <typename StopWords, typename Terms = std::vector<std::string>>
+    explicit SharedDictionary(const StopWords& stop_words, const Terms& terms = {});
+
+    // views of copy would point to buffer of original, servers share dictionary by shared_ptr
+    SharedDictionary(const SharedDictionary&) = delete;
+    SharedDictionary& operator=(const SharedDictionary&) = delete;
+
+    bool IsStopWord(std::string_view word) const;
+
+    // term of dictionary equal to word, empty if there is no such term
+    std::string_view FindTerm(std::string_view word) const;
+
+    // sorted
+    const std::vector<std::string_view>& GetStopWords() const;
+    size_t GetTermCount() const;
+
+    // bytes of strings and views
+    size_t GetMemoryUsage() const;
+
+private:
+    std::string characters_;
+    std::vector<std::string_view> stop_words_;
+    std::vector<std::string_view> terms_;
+
+    // copying words into buffer, throws invalid_argument if word contains symbols from 0 to 31
+    void Init(std::vector<std::string_view> stop_words, std::vector<std::string_view> terms);
+};
+
+template <typename StopWords, typename Terms>
+SharedDictionary::SharedDictionary(const StopWords& stop_words, const Terms& terms) {
+    Init(std::vector<std::string_view>(stop_words.begin(), stop_words.end()),
+        std::vector<std::string_view>(terms.begin(), terms.end()));
+}
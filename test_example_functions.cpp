@@ -1,4 +1,14 @@
 #include "test_example_functions.h"
+#include "sharded_search_server.h"
+#include "query_service.h"
+#include "request_queue.h"
+#include "metrics.h"
+#include "paginator.h"
+#include "generators.h"
+#include <future>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
 
 using namespace std;
 
@@ -155,6 +165,1592 @@ void TestComplexSearchDocument() {
     }
 }
 
+// check prefix query words expansion
+void TestPrefixQuery() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "catalog of city"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "big city"s, DocumentStatus::ACTUAL, { 3 });
+    {
+        const auto found_docs = server.FindTopDocuments("cat*"s);
+        ASSERT_EQUAL_HINT(found_docs.size(), 2, "Prefix must be expanded into all dictionary words"s);
+    }
+    {
+        const auto found_docs = server.FindTopDocuments("city -catal*"s);
+        ASSERT_EQUAL_HINT(found_docs.size(), 1, "Minus prefix must exclude all matched documents"s);
+        ASSERT_EQUAL_HINT(found_docs[0].id, 3, "Wrong document is found"s);
+    }
+    {
+        const auto [words, _] = server.MatchDocument("ca* bi*"s, 2);
+        const vector<string_view> expected = { "catalog"sv };
+        ASSERT_EQUAL_HINT(words, expected, "Expanded words must be matched"s);
+    }
+    {
+        server.SetPrefixExpansionLimit(1);
+        const auto found_docs = server.FindTopDocuments("cat*"s);
+        ASSERT_EQUAL_HINT(found_docs.size(), 1, "Prefix expansion must be limited"s);
+        ASSERT_EQUAL_HINT(found_docs[0].id, 1, "Prefix must be expanded in dictionary order"s);
+        // "catalog" is past the limit, but its document is excluded too
+        const auto city_docs = server.FindTopDocuments("city -cat*"s);
+        ASSERT_EQUAL_HINT(city_docs.size(), 1, "Minus prefix must not be limited"s);
+        ASSERT_EQUAL(city_docs[0].id, 3);
+        ASSERT_EQUAL(get<0>(server.MatchDocument("city -cat*"s, 2)).size(), 0u);
+    }
+    {
+        server.RemoveDocument(2);
+        server.AddDocument(4, "city of cats"s, DocumentStatus::ACTUAL, { 4 });
+        server.RemoveDocument(3);
+        server.SetPrefixExpansionLimit(MAX_PREFIX_EXPANSION);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments("cat*"s).size(), 2, "Dictionary must be consistent after removing"s);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments("cit*"s).size(), 1, "Dictionary must be consistent after removing"s);
+    }
+    try {
+        server.FindTopDocuments("-*"s);
+        ASSERT_HINT(false, "Empty prefix must be rejected"s);
+    }
+    catch (const invalid_argument&) {
+    }
+}
+
+// check that sharded server finds the same documents as one server
+void TestShardedSearchServer() {
+    const vector<string> texts = {
+        "white cat and fashion collar"s, "fluffy cat fluffy tail"s, "groomed dog expressive eyes"s,
+        "groomed starling eugene"s, "cat and dog"s, "big city life"s, "catalog of city cats"s,
+        "white dog"s, "fluffy dog and cat"s, "city starling"s, "cat"s, "dog"s,
+    };
+    SearchServer server("and of"s);
+    ShardedSearchServer sharded_server(3, "and of"s);
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        const DocumentStatus status = id % 4 == 3 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(id, texts[id], status, { id % 5, 1 });
+        sharded_server.AddDocument(id, texts[id], status, { id % 5, 1 });
+    }
+    server.RemoveDocument(4);
+    sharded_server.RemoveDocument(4);
+    ASSERT_EQUAL(sharded_server.GetDocumentCount(), server.GetDocumentCount());
+
+    const vector<string> queries = { "fluffy cat"s, "dog -white"s, "cat* city"s, "starling eyes"s, "cat dog city -fluffy"s };
+    for (const string& query : queries) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED }) {
+            const auto expected = server.FindTopDocuments(query, status);
+            const auto found_docs = sharded_server.FindTopDocuments(query, status);
+            ASSERT_EQUAL_HINT(found_docs.size(), expected.size(), query);
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL_HINT(found_docs[i].id, expected[i].id, query);
+                ASSERT_HINT(found_docs[i].relevance == expected[i].relevance, query + ": relevance must be the same"s);
+            }
+        }
+        ASSERT_EQUAL_HINT(get<0>(sharded_server.MatchDocument(query, 6)), get<0>(server.MatchDocument(query, 6)), query);
+    }
+    // minus prefix isn't limited: "catalog" and "cats" are past the limit
+    sharded_server.SetPrefixExpansionLimit(1);
+    ASSERT_EQUAL(sharded_server.FindTopDocuments("city -cat*"s).size(), server.FindTopDocuments("city -cat*"s).size());
+}
+
+// check query service: pipelined requests over Unix socket
+void TestQueryService() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat and cat in the city"s, DocumentStatus::ACTUAL, { 1, 1, 2 });
+    server.AddDocument(2, "grey cat and dog"s, DocumentStatus::BANNED, { 1, 2 });
+    server.AddDocument(3, "big city life"s, DocumentStatus::ACTUAL, { 1, 0, 2 });
+
+    QueryServiceConfig config;
+    config.worker_count = 2;
+    config.max_batch_size = 2;
+    config.max_in_flight = 3;
+    QueryService service(server, config);
+    const string path = "/tmp/search_server_test_"s + to_string(getpid()) + ".sock"s;
+    service.ListenUnix(path);
+    thread service_thread([&service] { service.Run(); });
+
+    {
+        QueryClient client(path);
+        const vector<QueryRequest> requests = {
+            { 10, DocumentStatus::ACTUAL, "cat city"s },
+            { 11, DocumentStatus::BANNED, "cat"s },
+            { 12, DocumentStatus::ACTUAL, "cat --city"s },
+            { 13, DocumentStatus::ACTUAL, "life -big"s },
+            { 14, DocumentStatus::ACTUAL, "city"s },
+        };
+        client.Send(requests);
+
+        map<uint32_t, QueryResponse> responses;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            QueryResponse response = client.Receive();
+            responses[response.request_id] = move(response);
+        }
+        ASSERT_EQUAL_HINT(responses.size(), requests.size(), "Every request must get response"s);
+        for (const QueryRequest& request : requests) {
+            const QueryResponse& response = responses.at(request.request_id);
+            if (request.request_id == 12) {
+                ASSERT_HINT(response.result == QueryResult::INVALID_QUERY, "Invalid query must be reported"s);
+                continue;
+            }
+            ASSERT_HINT(response.result == QueryResult::OK, "Query must be processed"s);
+            const auto expected = server.FindTopDocuments(request.query, request.status);
+            ASSERT_EQUAL_HINT(response.documents.size(), expected.size(), request.query);
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL_HINT(response.documents[i].id, expected[i].id, request.query);
+                ASSERT_HINT(response.documents[i].relevance == expected[i].relevance, request.query);
+                ASSERT_EQUAL_HINT(response.documents[i].rating, expected[i].rating, request.query);
+            }
+        }
+    }
+    {
+        // client which shuts down sending after batch gets every response, then connection is closed
+        QueryClient client(path);
+        vector<QueryRequest> requests;
+        for (uint32_t id = 0; id < 10; ++id) {
+            requests.push_back({ id, DocumentStatus::ACTUAL, id % 2 ? "cat"s : "city"s });
+        }
+        client.Send(requests);
+        client.CloseSending();
+        set<uint32_t> ids;
+        for (size_t i = 0; i < requests.size(); ++i) {
+            ids.insert(client.Receive().request_id);
+        }
+        ASSERT_EQUAL_HINT(ids.size(), requests.size(), "Half-closed connection must get every response"s);
+        try {
+            client.Receive();
+            ASSERT_HINT(false, "Half-closed connection must be closed after responses"s);
+        }
+        catch (const runtime_error&) {
+        }
+    }
+
+    service.Stop();
+    service_thread.join();
+    unlink(path.c_str());
+}
+
+// check asynchronous queries (results, cancellation, bounded queue)
+void TestAsyncQuery() {
+    SearchServer server(""s);
+    server.AddDocument(1, "cat and cat in the city"s, DocumentStatus::ACTUAL, { 1, 1, 2 });
+    server.AddDocument(2, "grey cat and dog"s, DocumentStatus::BANNED, { 1, 2 });
+    server.AddDocument(3, "big city life"s, DocumentStatus::ACTUAL, { 1, 0, 2 });
+    {
+        auto actual = server.FindTopDocumentsAsync("cat city"s);
+        auto banned = server.FindTopDocumentsAsync("cat city"s, DocumentStatus::BANNED, { TaskPriority::HIGH, {}, {} });
+        const auto actual_docs = actual.get();
+        ASSERT_EQUAL_HINT(actual_docs.size(), 2, "Asynchronous query must find the same documents"s);
+        ASSERT_EQUAL_HINT(actual_docs[0].id, server.FindTopDocuments("cat city"s)[0].id, "Asynchronous query must find the same documents"s);
+        ASSERT_EQUAL_HINT(banned.get().size(), 1, "Asynchronous query must use status"s);
+    }
+    {
+        QueryTaskOptions options;
+        options.cancellation.Cancel();
+        auto cancelled = server.FindTopDocumentsAsync("cat"s, DocumentStatus::ACTUAL, options);
+        try {
+            cancelled.get();
+            ASSERT_HINT(false, "Cancelled query must not be done"s);
+        }
+        catch (const TaskCancelledError&) {
+        }
+    }
+    {
+        server.SetThreadPool(1, 1);
+        promise<void> release;
+        shared_future<void> released = release.get_future().share();
+        // the only worker waits inside predicate
+        auto blocked = server.FindTopDocumentsAsync("cat"s,
+            [released](int, DocumentStatus, int) {
+                released.wait();
+                return true;
+            });
+        while (true) {
+            try {
+                // queue has place for one query when worker has taken the blocked one
+                auto queued = server.FindTopDocumentsAsync("city"s);
+                try {
+                    server.FindTopDocumentsAsync("life"s);
+                    ASSERT_HINT(false, "Query must be rejected when queue is full"s);
+                }
+                catch (const runtime_error&) {
+                }
+                release.set_value();
+                ASSERT_EQUAL(blocked.get().size(), 2);
+                ASSERT_EQUAL(queued.get().size(), 2);
+                break;
+            }
+            catch (const runtime_error&) {
+                this_thread::yield(); // worker hasn't taken blocked query yet
+            }
+        }
+    }
+    {
+        server.SetThreadPool(2);
+        const auto found_docs = server.FindTopDocuments(execution::par, "cat city -life"s);
+        ASSERT_EQUAL_HINT(found_docs.size(), 1, "Parallel query must use thread pool of server"s);
+    }
+}
+
+// check executor (parallel sorting, nested ParallelFor, parallel queries)
+void TestExecutor() {
+    {
+        vector<int> numbers(10'000);
+        for (size_t i = 0; i < numbers.size(); ++i) {
+            numbers[i] = static_cast<int>((i * 7919) % 1000);
+        }
+        vector<int> expected = numbers;
+        sort(expected.begin(), expected.end());
+        for (const bool work_stealing : { true, false }) {
+            ThreadPoolConfig config;
+            config.thread_count = 3;
+            config.work_stealing = work_stealing;
+            ThreadPool pool(config);
+            vector<int> sorted = numbers;
+            ParallelSort(pool, sorted.begin(), sorted.end(), less<int>());
+            ASSERT_HINT(sorted == expected, "Parallel sorting must sort range"s);
+
+            // nested calls from workers must not deadlock
+            atomic<int> sum = 0;
+            pool.ParallelFor(8,
+                [&](size_t i) {
+                    pool.ParallelFor(8, [&](size_t j) { sum += static_cast<int>(i * j); });
+                });
+            ASSERT_EQUAL_HINT(sum.load(), 28 * 28, "ParallelFor must call function for all indexes"s);
+        }
+    }
+    {
+        ThreadPoolConfig config;
+        config.thread_count = 2;
+        const auto executor = make_shared<ThreadPool>(config);
+        SearchServer server("and in the"s, executor);
+        for (int id = 0; id < 100; ++id) {
+            server.AddDocument(id, "cat "s + to_string(id % 7) + " dog "s + to_string(id % 3), DocumentStatus::ACTUAL, { id });
+        }
+        ASSERT_HINT(&server.GetExecutor() == executor.get(), "Server must use given executor"s);
+        const auto seq_docs = server.FindTopDocuments(execution::seq, "cat 1 2 -0"s);
+        const auto par_docs = server.FindTopDocuments(execution::par, "cat 1 2 -0"s);
+        ASSERT_EQUAL(seq_docs.size(), par_docs.size());
+        for (size_t i = 0; i < seq_docs.size(); ++i) {
+            ASSERT_EQUAL_HINT(seq_docs[i].id, par_docs[i].id, "Parallel query must find the same documents"s);
+        }
+        const string query = "cat dog 1 2"s; // matched words are views of query
+        const auto [seq_words, seq_status] = server.MatchDocument(execution::seq, query, 1);
+        const auto [par_words, par_status] = server.MatchDocument(execution::par, query, 1);
+        ASSERT_HINT(seq_words == par_words, "Parallel matching must find the same words"s);
+        server.RemoveDocument(execution::par, 1);
+        ASSERT_EQUAL(server.GetDocumentCount(), 99);
+
+        ShardedSearchServer sharded(3, "and in the"s, executor);
+        sharded.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_EQUAL(sharded.FindTopDocuments("cat"s).size(), 1);
+    }
+    {
+        // exception of task doesn't stop worker, deque of worker is bounded by max_queue_size
+        ThreadPool pool(1, 2);
+        pool.Submit([] { throw runtime_error("task error"s); });
+        promise<vector<bool>> submitted;
+        auto result = submitted.get_future();
+        pool.Submit([&pool, &submitted] {
+            vector<bool> accepted;
+            for (int i = 0; i < 3; ++i) {
+                accepted.push_back(pool.TrySubmit([] {}));
+            }
+            bool is_done = false;
+            pool.Submit([&is_done] { is_done = true; });
+            accepted.push_back(is_done);
+            submitted.set_value(accepted);
+        });
+        ASSERT_HINT(result.get() == vector<bool>({ true, true, false, true }),
+            "Worker with full deque must reject task or do it itself"s);
+        ASSERT_EQUAL(pool.GetFailedTaskCount(), 1);
+    }
+}
+
+// check adaptive execution (cost of query, fan-out, the same results)
+void TestAdaptiveExecution() {
+    ThreadPoolConfig config;
+    config.thread_count = 3;
+    const auto executor = make_shared<ThreadPool>(config);
+    SearchServer server("and in the"s, executor);
+    for (int id = 0; id < 60; ++id) {
+        server.AddDocument(id, "cat "s + to_string(id % 5) + " dog "s + to_string(id % 4), DocumentStatus::ACTUAL, { id });
+    }
+    const string query = "cat dog 1 -2"s;
+
+    ExecutionCostModel model;
+    ASSERT_EQUAL_HINT(server.EstimateQueryCost(query), 60 + 60 + 24 + 24 + 4 * model.word_cost,
+        "Cost of query must be count of postings and costs of words"s);
+
+    const auto expected_docs = server.FindTopDocuments(execution::seq, query);
+    const auto expected_words = get<0>(server.MatchDocument(execution::seq, query, 1));
+    for (const double threshold : { NEVER_PARALLEL, 0.0 }) {
+        model.parallel_threshold = threshold;
+        model.match_parallel_threshold = threshold;
+        model.cost_per_task = 1;
+        server.SetCostModel(model);
+        ASSERT_EQUAL_HINT(server.GetAdaptiveFanOut(query), threshold == 0 ? 3 : 1, "Fan-out must be chosen by cost"s);
+
+        const auto docs = server.FindTopDocuments(ADAPTIVE, query);
+        ASSERT_EQUAL(docs.size(), expected_docs.size());
+        for (size_t i = 0; i < docs.size(); ++i) {
+            ASSERT_EQUAL_HINT(docs[i].id, expected_docs[i].id, "Adaptive query must find the same documents"s);
+        }
+        ASSERT_HINT(get<0>(server.MatchDocument(ADAPTIVE, query, 1)) == expected_words, "Adaptive matching must find the same words"s);
+    }
+
+    const ExecutionCostModel calibrated = CalibrateCostModel(executor, 200);
+    ASSERT_HINT(calibrated.parallel_threshold > 0 && calibrated.cost_per_task > 0 && calibrated.match_parallel_threshold > 0,
+        "Calibrated thresholds must be positive"s);
+}
+
+// check request queue (sliding window, concurrent requests)
+void TestRequestQueue() {
+    SearchServer server("and in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1 });
+
+    auto time = make_shared<atomic<int64_t>>(0); // ms
+    RequestQueueConfig config;
+    config.bucket_duration = chrono::seconds(1);
+    config.bucket_count = 3;
+    config.clock = [time] {
+        return RequestQueueConfig::Clock::time_point(chrono::milliseconds(*time));
+    };
+    RequestQueue queue(server, config);
+
+    queue.AddFindRequest("cat"s);
+    queue.AddFindRequest("dog"s);
+    queue.AddFindRequest("dog"s, DocumentStatus::BANNED);
+    *time = 1500;
+    queue.AddFindRequest("city"s, [](int, DocumentStatus, int) { return true; });
+    {
+        const RequestStats stats = queue.GetStats();
+        ASSERT_EQUAL_HINT(stats.request_count, 4, "Requests of window must be counted"s);
+        ASSERT_EQUAL_HINT(stats.no_result_count, 2, "Requests without result must be counted"s);
+        ASSERT_EQUAL_HINT(queue.GetNoResultRequests(), 2, "Requests without result must be counted"s);
+        ASSERT_HINT(abs(stats.qps - 4 / 1.5) < EPSILON, "QPS must be counted over time since start"s);
+        ASSERT_HINT(abs(stats.no_result_rate - 0.5) < EPSILON, "Rate of requests without result must be counted"s);
+        ASSERT_EQUAL_HINT(stats.latency_histogram[0], 4, "Latency must be counted in histogram"s);
+        ASSERT_EQUAL(stats.GetLatencyPercentile(0.99), 1);
+    }
+
+    *time = 3200; // the first bucket is out of window
+    {
+        const RequestStats stats = queue.GetStats();
+        ASSERT_EQUAL_HINT(stats.request_count, 1, "Requests out of window must not be counted"s);
+        ASSERT_EQUAL(stats.no_result_count, 0);
+        ASSERT_HINT(abs(stats.qps - 1 / 3.0) < EPSILON, "QPS must be counted over window"s);
+    }
+
+    vector<thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&queue, &time, i] {
+            for (int j = 0; j < 100; ++j) {
+                queue.AddFindRequest(j % 2 ? "cat"s : "dog"s);
+                if (i == 0 && j == 50) {
+                    *time += 1000; // the next bucket is cleared by concurrent requests
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    {
+        const RequestStats stats = queue.GetStats();
+        ASSERT_EQUAL_HINT(stats.request_count, 400, "Concurrent requests must be counted"s);
+        ASSERT_EQUAL_HINT(stats.no_result_count, 200, "Concurrent requests must be counted"s);
+    }
+}
+
+// check metrics (histograms, counters, aggregation of threads, stages of query)
+void TestMetrics() {
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+        ASSERT_EQUAL_HINT(LatencyHistogram::GetBucket(LatencyHistogram::GetBucketValue(i)), i, "The greatest value of bucket must be in bucket"s);
+    }
+    ASSERT_EQUAL(LatencyHistogram::GetBucket(uint64_t(1) << 50), LatencyHistogram::BUCKET_COUNT - 1);
+
+    MetricsRegistry& registry = MetricsRegistry::Instance();
+    const size_t timer = registry.Register("test.timer"s, MetricType::TIMER);
+    const size_t counter = registry.Register("test.counter"s, MetricType::COUNTER);
+    ASSERT_EQUAL_HINT(registry.Register("test.timer"s, MetricType::TIMER), timer, "Metric must have one id"s);
+    try {
+        registry.Register("test.timer"s, MetricType::COUNTER);
+        ASSERT_HINT(false, "Metric must not be registered with other type"s);
+    }
+    catch (const invalid_argument&) {
+    }
+
+    thread other([&] {
+        registry.RecordDuration(timer, 1000);
+        registry.AddCount(counter, 5);
+    });
+    other.join();
+    for (int i = 0; i < 99; ++i) {
+        registry.RecordDuration(timer, 100);
+    }
+    registry.AddCount(counter, 2);
+
+    const MetricsSnapshot snapshot = registry.GetSnapshot();
+    auto find_metric = [&snapshot](const string& name) {
+        return find_if(snapshot.metrics.begin(), snapshot.metrics.end(),
+            [&name](const MetricSnapshot& metric) { return metric.name == name; });
+    };
+    const auto timer_it = find_metric("test.timer"s);
+    ASSERT(timer_it != snapshot.metrics.end());
+    ASSERT_EQUAL_HINT(timer_it->count, 100, "Measurements of all threads must be summed"s);
+    ASSERT_EQUAL(timer_it->total_ns, 99 * 100 + 1000);
+    ASSERT_EQUAL(timer_it->max_ns, 1000);
+    ASSERT_HINT(timer_it->p50_ns >= 100 && timer_it->p50_ns < 100 + 100 / 16, "Percentile must have error less than 1/16"s);
+    ASSERT_EQUAL(find_metric("test.counter"s)->count, 7);
+    for (const auto& metric : snapshot.metrics) {
+        ASSERT_HINT(metric.p50_ns <= metric.p99_ns && metric.p99_ns <= metric.max_ns, "Percentiles must not exceed max: "s + metric.name);
+    }
+
+    // the greatest value of bucket of 1000 is 1023, percentiles are bounded by max
+    const size_t bounded = registry.Register("test.bounded"s, MetricType::TIMER);
+    registry.RecordDuration(bounded, 1000);
+    const size_t thread_metrics_count = registry.GetThreadMetricsCount();
+    for (int i = 0; i < 10; ++i) {
+        thread([&] {
+            registry.RecordDuration(bounded, 1000);
+            registry.AddCount(counter, 1);
+        }).join();
+    }
+    ASSERT_HINT(registry.GetThreadMetricsCount() <= thread_metrics_count + 1, "Metrics of ended threads must be reused"s);
+    const MetricsSnapshot bounded_snapshot = registry.GetSnapshot();
+    const auto bounded_it = find_if(bounded_snapshot.metrics.begin(), bounded_snapshot.metrics.end(),
+        [](const MetricSnapshot& metric) { return metric.name == "test.bounded"s; });
+    ASSERT_EQUAL(bounded_it->count, 11);
+    ASSERT_EQUAL(bounded_it->max_ns, 1000);
+    ASSERT_EQUAL_HINT(bounded_it->p99_ns, 1000, "Percentile must not exceed max"s);
+    for (const auto& metric : bounded_snapshot.metrics) {
+        if (metric.name == "test.counter"s) {
+            ASSERT_EQUAL_HINT(metric.count, 17, "Counts of ended threads must be kept"s);
+        }
+    }
+    ASSERT_HINT(snapshot.ToJson().find("\"name\": \"test.timer\", \"type\": \"timer\", \"count\": 100"s) != string::npos,
+        "Metrics must be dumped to JSON"s);
+    ASSERT_HINT(snapshot.ToText().find("\n  timer: count = 100"s) != string::npos, "Children must be indented"s);
+
+#ifndef SEARCH_SERVER_NO_METRICS
+    SearchServer server(""s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::BANNED, { 1 });
+    const uint64_t scanned_before = [&] {
+        const MetricsSnapshot before = registry.GetSnapshot();
+        for (const auto& metric : before.metrics) {
+            if (metric.name == "find_top_documents.postings_scanned"s) {
+                return metric.count;
+            }
+        }
+        return uint64_t(0);
+    }();
+    server.FindTopDocuments("city -cat"s);
+    const MetricsSnapshot after = registry.GetSnapshot();
+    for (const string& name : { "find_top_documents"s, "find_top_documents.parse"s, "find_top_documents.scoring"s, "find_top_documents.top_k"s }) {
+        ASSERT_HINT(any_of(after.metrics.begin(), after.metrics.end(),
+            [&name](const MetricSnapshot& metric) { return metric.name == name && metric.count > 0; }), "Stages of query must be timed"s);
+    }
+    for (const auto& metric : after.metrics) {
+        if (metric.name == "find_top_documents.postings_scanned"s) {
+            ASSERT_EQUAL_HINT(metric.count - scanned_before, 2, "Scanned postings must be counted"s);
+        }
+    }
+#endif
+}
+
+// check memory usage of structures (counting, release on removal)
+void TestMemoryUsage() {
+    SearchServer server("and in the with"s);
+    const MemoryUsage empty = server.GetMemoryUsage();
+    ASSERT_HINT(empty.stop_words > 0, "Stop-words must be counted"s);
+    ASSERT_EQUAL_HINT(empty.GetTotal(), empty.stop_words, "Empty server must have only stop-words"s);
+
+    const string text = "a very long document about a cat which lives in the big city with a dog"s;
+    server.AddDocument(1, text, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, { 1 });
+    const MemoryUsage usage = server.GetMemoryUsage();
+    ASSERT_EQUAL_HINT(usage.stop_words, empty.stop_words, "Stop-words must not change"s);
+    ASSERT_HINT(usage.document_texts > text.size(), "Long text must be counted"s);
+    ASSERT_HINT(usage.inverted_index > 0 && usage.forward_index > 0 && usage.document_metadata > 0, "Indexes must be counted"s);
+
+    server.RemoveDocument(1);
+    server.RemoveDocument(execution::par, 2);
+    ASSERT_EQUAL_HINT(server.GetMemoryUsage().GetTotal(), empty.GetTotal(), "Memory of removed documents must be released"s);
+
+    SearchServer moved(move(server));
+    moved.AddDocument(3, text, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_HINT(moved.GetMemoryUsage().document_texts > text.size(), "Moved server must count memory"s);
+}
+
+// check pages of search results (offset, limit, search-after cursor, lazy paginator)
+void TestPagination() {
+    SearchServer server("and in the"s);
+    for (int id = 0; id < 23; ++id) {
+        // equal relevance and rating in groups: order is defined by ID
+        server.AddDocument(id, "cat "s + (id % 3 ? "dog"s : "city"s), DocumentStatus::ACTUAL, { id / 4 });
+    }
+    server.AddDocument(100, "cat"s, DocumentStatus::BANNED, { 1 });
+
+    PageRequest all;
+    all.limit = 100;
+    const auto expected = server.FindTopDocuments("cat city"s, all);
+    ASSERT_EQUAL_HINT(expected.size(), 23, "Limit must replace MAX_RESULT_DOCUMENT_COUNT"s);
+    {
+        PageRequest unbounded;
+        unbounded.limit = numeric_limits<size_t>::max();
+        ASSERT_EQUAL_HINT(server.FindTopDocuments("cat city"s, unbounded).size(), 23, "Unbounded limit must not overflow"s);
+        unbounded.offset = 20;
+        ASSERT_EQUAL_HINT(server.FindTopDocuments("cat city"s, unbounded).size(), 3, "Unbounded limit must not overflow"s);
+    }
+    ASSERT_HINT(is_sorted(expected.begin(), expected.end(), IsMoreRelevant), "Page must be sorted"s);
+    {
+        const auto top = server.FindTopDocuments("cat city"s);
+        for (size_t i = 0; i < top.size(); ++i) {
+            ASSERT_EQUAL_HINT(top[i].id, expected[i].id, "Default page must be TOP"s);
+        }
+    }
+
+    PageRequest page;
+    page.offset = 20;
+    page.limit = 5;
+    const auto last_page = server.FindTopDocuments("cat city"s, page);
+    ASSERT_EQUAL_HINT(last_page.size(), 3, "Offset must skip documents"s);
+    ASSERT_EQUAL(last_page[0].id, expected[20].id);
+    page.offset = 30;
+    ASSERT_HINT(server.FindTopDocuments("cat city"s, page).empty(), "Page after the end must be empty"s);
+
+    const SearchCursor cursor = SearchCursor::FromString(SearchCursor::After(expected[6]).ToString());
+    page.offset = 1;
+    page.search_after = cursor;
+    const auto after = server.FindTopDocuments("cat city"s, page);
+    ASSERT_EQUAL_HINT(after[0].id, expected[8].id, "Page must start after cursor"s);
+    try {
+        SearchCursor::FromString("cursor"s);
+        ASSERT_HINT(false, "Invalid cursor must be rejected"s);
+    }
+    catch (const invalid_argument&) {
+    }
+
+    SearchPaginator paginator(server, "cat city"s, 4);
+    vector<int> ids;
+    size_t page_count = 0;
+    while (paginator.HasNextPage()) {
+        for (const Document& document : paginator.NextPage()) {
+            ids.push_back(document.id);
+        }
+        ++page_count;
+    }
+    ASSERT_EQUAL_HINT(page_count, 6, "Paginator must fetch pages until the end"s);
+    ASSERT_EQUAL(ids.size(), expected.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        ASSERT_EQUAL_HINT(ids[i], expected[i].id, "Pages must follow each other"s);
+    }
+    ASSERT_EQUAL(paginator.GetPage(5).size(), 3);
+    ASSERT_EQUAL(SearchPaginator(server, "cat"s, 4, DocumentStatus::BANNED).NextPage().size(), 1);
+}
+
+// check quantized scoring (the same documents, relevance within error bound, updates of index)
+void TestQuantizedScoring() {
+    mt19937 generator(7);
+    const auto dictionary = GenerateDictionary(generator, 50, 4);
+    SearchServer server("and in the"s);
+    for (int id = 0; id < 300; ++id) {
+        server.AddDocument(id, GenerateQuery(generator, dictionary, 1 + id % 20),
+            id % 5 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED, { id % 7 });
+    }
+    const auto queries = GenerateQueries(generator, dictionary, 20, 4);
+    PageRequest all;
+    all.limit = 1000;
+
+    for (const ScoringMode mode : { ScoringMode::QUANTIZED_8, ScoringMode::QUANTIZED_16 }) {
+        server.SetScoringMode(ScoringMode::EXACT);
+        server.RemoveDocument(298);
+        server.RemoveDocument(299);
+        vector<vector<Document>> expected;
+        for (const string& query : queries) {
+            expected.push_back(server.FindTopDocuments(query + " -"s + dictionary[0], all));
+        }
+        ASSERT_EQUAL(server.GetMemoryUsage().quantized_index, 0);
+
+        server.SetScoringMode(mode);
+        ASSERT_HINT(server.GetMemoryUsage().quantized_index > 0, "Quantized index must be counted"s);
+        // index is kept up to date, the base is the same after it
+        server.AddDocument(298, GenerateQuery(generator, dictionary, 5), DocumentStatus::BANNED, { 1 });
+        server.AddDocument(299, dictionary[1], DocumentStatus::BANNED, { 1 });
+        server.RemoveDocument(execution::par, 298);
+        server.RemoveDocument(299);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const double bound = server.GetScoreErrorBound(queries[i]);
+            ASSERT_HINT(bound > 0 && bound < 0.1, "Error bound must be small"s);
+            const auto actual = server.FindTopDocuments(queries[i] + " -"s + dictionary[0], all);
+            ASSERT_EQUAL_HINT(actual.size(), expected[i].size(), "Quantized search must find the same documents"s);
+            map<int, double> exact_relevance;
+            for (const Document& document : expected[i]) {
+                exact_relevance[document.id] = document.relevance;
+            }
+            for (size_t j = 0; j < actual.size(); ++j) {
+                ASSERT_HINT(exact_relevance.count(actual[j].id), "Quantized search must find the same documents"s);
+                ASSERT_HINT(abs(actual[j].relevance - exact_relevance[actual[j].id]) <= bound, "Relevance must be within error bound"s);
+                if (j > 0) {
+                    ASSERT_HINT(exact_relevance[actual[j].id] <= exact_relevance[actual[j - 1].id] + 2 * bound,
+                        "Documents which differ more than error must keep order"s);
+                }
+            }
+        }
+    }
+    server.SetScoringMode(ScoringMode::EXACT);
+    ASSERT_EQUAL(server.GetScoreErrorBound(queries[0]), 0.0);
+}
+
+// check impact-ordered postings (the same TOP as full search, updates of index)
+void TestImpactOrderedPostings() {
+    mt19937 generator(11);
+    const auto dictionary = GenerateDictionary(generator, 30, 3);
+    SearchServer exhaustive("and in the"s);
+    SearchServer impact_ordered("and in the"s);
+    impact_ordered.SetImpactOrderedPostings(true);
+    // short documents and few ratings: many equal relevances which are ordered by rating and ID
+    for (int id = 0; id < 400; ++id) {
+        const string text = GenerateQuery(generator, dictionary, 1 + id % 4);
+        const DocumentStatus status = id % 3 ? DocumentStatus::ACTUAL : DocumentStatus::IRRELEVANT;
+        exhaustive.AddDocument(id, text, status, { id % 3 });
+        impact_ordered.AddDocument(id, text, status, { id % 3 });
+    }
+    for (int id = 0; id < 400; id += 7) {
+        exhaustive.RemoveDocument(id);
+        impact_ordered.RemoveDocument(execution::par, id);
+    }
+    ASSERT_HINT(impact_ordered.GetMemoryUsage().impact_index > 0, "Impact index must be counted"s);
+    ASSERT_EQUAL(exhaustive.GetMemoryUsage().impact_index, 0);
+
+    auto assert_equal_results = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+        ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), "Early termination must find the same TOP"s);
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, "Early termination must find the same TOP"s);
+            ASSERT_EQUAL(lhs[i].relevance, rhs[i].relevance);
+            ASSERT_EQUAL(lhs[i].rating, rhs[i].rating);
+        }
+    };
+    PageRequest page;
+    page.offset = 3;
+    page.limit = 10;
+    for (int i = 0; i < 50; ++i) {
+        string query = GenerateQuery(generator, dictionary, 1 + i % 2);
+        if (i % 5 == 0) {
+            query += " -"s + dictionary[i % dictionary.size()];
+        }
+        assert_equal_results(exhaustive.FindTopDocuments(query), impact_ordered.FindTopDocuments(query));
+        assert_equal_results(exhaustive.FindTopDocuments(query, DocumentStatus::IRRELEVANT),
+            impact_ordered.FindTopDocuments(query, DocumentStatus::IRRELEVANT));
+        assert_equal_results(exhaustive.FindTopDocuments(query, page), impact_ordered.FindTopDocuments(query, page));
+    }
+
+    impact_ordered.SetImpactOrderedPostings(false);
+    ASSERT_EQUAL(impact_ordered.GetMemoryUsage().impact_index, 0);
+}
+
+// check internal ordinals of documents (order of adding, compaction after removal)
+void TestDocumentOrdinals() {
+    SearchServer server("and in the"s);
+    for (const int id : { 5, 1, 9, 3 }) {
+        server.AddDocument(id, "cat number "s + to_string(id), DocumentStatus::ACTUAL, { id });
+    }
+    server.RemoveDocument(1);
+    server.AddDocument(2, "cat number 2"s, DocumentStatus::ACTUAL, { 2 });
+    try {
+        server.AddDocument(7, "cat \x12"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "Invalid document must be rejected"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL_HINT(vector<int>(server.begin(), server.end()), vector<int>({ 5, 9, 3, 2 }),
+        "Documents must be iterated in order of adding"s);
+    ASSERT_EQUAL(server.GetDocumentCount(), 4);
+    ASSERT_EQUAL(get<0>(server.MatchDocument("number 9"s, 9)).size(), 2);
+
+    // removing most of documents compacts ordinals of indexes
+    mt19937 generator(3);
+    const auto dictionary = GenerateDictionary(generator, 40, 3);
+    SearchServer expected("and in the"s);
+    server.SetScoringMode(ScoringMode::QUANTIZED_16);
+    server.SetImpactOrderedPostings(true);
+    vector<int> ids;
+    for (int id = 100; id < 400; ++id) {
+        const string text = GenerateQuery(generator, dictionary, 1 + id % 6);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 4 });
+        if (id % 10 == 0) {
+            expected.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 4 });
+            ids.push_back(id);
+        }
+    }
+    for (const int id : { 5, 9, 3, 2 }) {
+        server.RemoveDocument(id);
+    }
+    for (int id = 100; id < 400; ++id) {
+        if (id % 10 == 0) {
+            continue;
+        }
+        if (id % 2) {
+            server.RemoveDocument(execution::par, id);
+        }
+        else {
+            server.RemoveDocument(id);
+        }
+    }
+    ASSERT_EQUAL(vector<int>(server.begin(), server.end()), ids);
+    for (const string& query : GenerateQueries(generator, dictionary, 20, 3)) {
+        const auto found = server.FindTopDocuments(query);
+        expected.SetScoringMode(ScoringMode::QUANTIZED_16);
+        ASSERT_EQUAL_HINT(found.size(), expected.FindTopDocuments(query).size(), query);
+        for (size_t i = 0; i < found.size(); ++i) {
+            ASSERT_EQUAL_HINT(found[i].id, expected.FindTopDocuments(query)[i].id, "Quantized index must be renumbered"s);
+        }
+        server.SetScoringMode(ScoringMode::EXACT);
+        expected.SetScoringMode(ScoringMode::EXACT);
+        const auto exact = server.FindTopDocuments(query);
+        const auto expected_exact = expected.FindTopDocuments(query);
+        ASSERT_EQUAL(exact.size(), expected_exact.size());
+        for (size_t i = 0; i < exact.size(); ++i) {
+            ASSERT_EQUAL_HINT(exact[i].id, expected_exact[i].id, "Indexes must be renumbered"s);
+            ASSERT_EQUAL(exact[i].relevance, expected_exact[i].relevance);
+        }
+        ASSERT_EQUAL(get<0>(server.MatchDocument(query, ids[3])), get<0>(expected.MatchDocument(query, ids[3])));
+        server.SetScoringMode(ScoringMode::QUANTIZED_16);
+    }
+}
+
+// check memory resources (arenas of queries, memory resource of index)
+void TestMemoryResources() {
+    ASSERT_EQUAL(GetQueryResource(), pmr::get_default_resource());
+    {
+        QueryArenaScope scope;
+        pmr::memory_resource* arena = GetQueryResource();
+        ASSERT_HINT(arena != pmr::get_default_resource(), "Scope must activate arena"s);
+        {
+            QueryArenaScope nested;
+            ASSERT_EQUAL_HINT(GetQueryResource(), arena, "Nested scope must use the same arena"s);
+        }
+        // larger than buffer of arena
+        pmr::vector<int> numbers(QUERY_ARENA_BUFFER_SIZE, 1, GetQueryResource());
+        ASSERT_EQUAL(GetQueryResource(), arena);
+    }
+    ASSERT_EQUAL(GetQueryResource(), pmr::get_default_resource());
+
+    CountingMemoryResource index_memory;
+    {
+        SearchServer server("and in"s, nullptr, &index_memory);
+        string query;
+        for (int id = 0; id < 3000; ++id) {
+            server.AddDocument(id, "cat "s + to_string(id), DocumentStatus::ACTUAL, { id % 10 });
+            query += to_string(id) + " "s;
+        }
+        ASSERT_EQUAL_HINT(index_memory.GetAllocatedBytes(), server.GetMemoryUsage().GetTotal(),
+            "Index must be allocated by given resource"s);
+        // words of query don't fit buffer of arena
+        const auto found = server.FindTopDocuments(query + "-1"s);
+        ASSERT_EQUAL(found.size(), MAX_RESULT_DOCUMENT_COUNT);
+        ASSERT_EQUAL(found[0].rating, 9);
+        ASSERT_EQUAL(get<0>(server.MatchDocument(execution::par, query, 7)).size(), 1);
+        ASSERT_EQUAL(GetQueryResource(), pmr::get_default_resource());
+    }
+    ASSERT_EQUAL_HINT(index_memory.GetAllocatedBytes(), 0, "Memory of server must be released"s);
+
+    // resource which isn't thread-safe is used only by thread which modifies server
+    class SingleThreadResource : public pmr::memory_resource {
+    public:
+        bool is_other_thread = false;
+
+    private:
+        const thread::id owner_ = this_thread::get_id();
+
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            is_other_thread |= this_thread::get_id() != owner_;
+            return pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {
+            is_other_thread |= this_thread::get_id() != owner_;
+            pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+        }
+        bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    } single_thread_memory;
+    {
+        SearchServer server(""s, make_shared<ThreadPool>(4), &single_thread_memory);
+        string text;
+        for (int i = 0; i < 200; ++i) {
+            text += to_string(i) + " "s;
+        }
+        server.AddDocument(1, text, DocumentStatus::ACTUAL, { 1 });
+        server.AddDocument(2, text, DocumentStatus::ACTUAL, { 1 });
+        server.RemoveDocument(execution::par, 1);
+        ASSERT_EQUAL(server.FindTopDocuments(execution::par, "5 7"s).size(), 1);
+    }
+    ASSERT_HINT(!single_thread_memory.is_other_thread, "Resource of index must be used by one thread"s);
+}
+
+// check query planner (exclusions first, order of plus-words, skipped words, explanation)
+void TestQueryPlanner() {
+    SearchServer server("and in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "rare dog"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "cat and dog"s, DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(5, "city cat"s, DocumentStatus::ACTUAL, { 5 });
+
+    const string query = "city cat rare -dog -mouse"s;
+    const QueryPlan plan = server.ExplainQuery(query);
+    ASSERT_EQUAL(plan.steps.size(), 5);
+    ASSERT_EQUAL(plan.excluded_document_count, 3);
+    ASSERT_HINT(plan.steps[0].is_minus && plan.steps[0].word == "mouse"s && plan.steps[0].is_skipped, "Unknown minus-word must be skipped"s);
+    ASSERT_HINT(plan.steps[1].is_minus && plan.steps[1].word == "dog"s && plan.steps[1].posting_count == 3, "Minus-words must be first"s);
+    vector<string> plus_words;
+    for (size_t i = 2; i < plan.steps.size(); ++i) {
+        plus_words.push_back(plan.steps[i].word);
+        ASSERT_HINT(!plan.steps[i].is_minus, "Plus-words must follow minus-words"s);
+    }
+    ASSERT_EQUAL_HINT(plus_words, vector<string>({ "rare"s, "cat"s, "city"s }), "Plus-words must be ordered by posting length"s);
+    ASSERT_HINT(plan.steps[2].is_skipped, "Plus-word with excluded documents must be skipped"s);
+    ASSERT_HINT(!plan.steps[3].is_skipped && !plan.steps[4].is_skipped, "Plus-words with documents left must be scored"s);
+    const string text = plan.ToString();
+    ASSERT_HINT(text.find("skip \"rare\""s) != string::npos && text.find("exclude \"mouse\": not in index"s) != string::npos, text);
+
+    const auto found = server.FindTopDocuments(query);
+    ASSERT_EQUAL(found.size(), 2);
+    ASSERT_EQUAL(found[0].id, 5);
+    ASSERT_EQUAL(found[1].id, 1);
+    const auto found_par = server.FindTopDocuments(execution::par, query);
+    ASSERT_EQUAL(found_par.size(), 2);
+    ASSERT_EQUAL(found_par[0].id, 5);
+
+    // few excluded documents of large base (sorted list) and many of them (bitset)
+    SearchServer large(""s);
+    for (int id = 0; id < 1000; ++id) {
+        large.AddDocument(id, id % 100 == 7 ? "cat rare"s : id % 2 ? "cat dog"s : "cat city"s, DocumentStatus::ACTUAL, { 1 });
+    }
+    ASSERT_EQUAL(large.ExplainQuery("cat -rare"s).excluded_document_count, 10);
+    ASSERT_EQUAL(large.ExplainQuery("cat -rare -dog"s).excluded_document_count, 500);
+    for (const string& minus_query : { "cat -rare"s, "cat -rare -dog"s, "+cat -rare"s }) {
+        for (const auto& documents : { large.FindTopDocuments(minus_query, PageRequest{ 0, 1000, nullopt }),
+            large.FindTopDocuments(execution::par, minus_query, [](int, DocumentStatus, int) { return true; }) }) {
+            for (const Document& document : documents) {
+                ASSERT_HINT(document.id % 100 != 7, "Excluded document is found: "s + minus_query);
+                ASSERT_HINT(minus_query.find("dog"s) == string::npos || document.id % 2 == 0, "Excluded document is found: "s + minus_query);
+            }
+        }
+    }
+    ASSERT_EQUAL(large.FindTopDocuments("cat -rare -dog"s, PageRequest{ 0, 1000, nullopt }).size(), 500);
+    ASSERT_HINT(large.FindTopDocuments(execution::seq, "cat -rare"s, DocumentStatus::ACTUAL, QueryDeadline::After(-1s)).is_partial,
+        "Expired query must be stopped"s);
+}
+
+// check conjunctive queries (required words, ALL mode, intersection of postings)
+void TestConjunctiveQuery() {
+    SearchServer server("and in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "cat and dog"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "city cat and dog"s, DocumentStatus::ACTUAL, { 4 });
+
+    {
+        const auto found = server.FindTopDocuments("+cat +dog city"s);
+        ASSERT_EQUAL(found.size(), 2);
+        ASSERT_EQUAL(found[0].id, 4);
+        ASSERT_EQUAL(found[1].id, 3);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments("+cat +dog -city"s).size(), 1, "Minus-words must exclude documents of intersection"s);
+        ASSERT_HINT(server.FindTopDocuments("+cat +mouse"s).empty(), "Required word out of index must give no documents"s);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments("+cat +in"s).size(), 3, "Required stop-words must be ignored"s);
+    }
+    {
+        const string query = "+cat city"s;
+        const auto [words, status] = server.MatchDocument(query, 2);
+        ASSERT_HINT(words.empty(), "Document without required word must not match"s);
+        const auto [par_words, par_status] = server.MatchDocument(execution::par, query, 1);
+        ASSERT_EQUAL(par_words, vector<string_view>({ "cat"sv, "city"sv }));
+        ASSERT(server.ExplainQuery(query).ToString().find("\"cat\": 3 postings, idf"s) != string::npos);
+    }
+    for (const string& query : { "+"s, "+-cat"s, "-+cat"s, "++cat"s, "+cat*"s }) {
+        try {
+            server.FindTopDocuments(query);
+            ASSERT_HINT(false, "Invalid required word must throw: "s + query);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+
+    // ALL mode: the same documents and relevances as filtering of documents with all plus-words
+    mt19937 generator(5);
+    const auto dictionary = GenerateDictionary(generator, 20, 3);
+    SearchServer random_server(""s);
+    for (int id = 0; id < 300; ++id) {
+        random_server.AddDocument(id, GenerateQuery(generator, dictionary, 1 + id % 8), DocumentStatus::ACTUAL, { id % 7 });
+    }
+    for (int i = 0; i < 50; ++i) {
+        const string query = GenerateQuery(generator, dictionary, 2 + i % 3, 0.2);
+        random_server.SetMatchMode(MatchMode::ANY);
+        const vector<string_view> words = SplitIntoWords(query);
+        const auto expected = random_server.FindTopDocuments(query,
+            [&](int document_id, DocumentStatus, int) {
+                const auto& freqs = random_server.GetWordFrequencies(document_id);
+                return all_of(words.begin(), words.end(),
+                    [&freqs](string_view word) {
+                        return word[0] == '-' || freqs.count(word) > 0;
+                    });
+            });
+        random_server.SetMatchMode(MatchMode::ALL);
+        for (const auto& found : { random_server.FindTopDocuments(query), random_server.FindTopDocuments(execution::par, query) }) {
+            ASSERT_EQUAL_HINT(found.size(), expected.size(), query);
+            for (size_t j = 0; j < found.size(); ++j) {
+                ASSERT_EQUAL_HINT(found[j].id, expected[j].id, query);
+                ASSERT_EQUAL_HINT(found[j].relevance, expected[j].relevance, query);
+            }
+        }
+    }
+}
+
+// check deadlines of queries (partial results, errors, cancellation, asynchronous queries)
+void TestQueryDeadline() {
+    SearchServer server(""s);
+    for (int id = 0; id < 5000; ++id) {
+        server.AddDocument(id, id % 2 ? "cat city"s : "cat dog"s, DocumentStatus::ACTUAL, { id % 10 });
+    }
+    const auto expected = server.FindTopDocuments("cat city"s);
+
+    {
+        const auto result = server.FindTopDocuments(execution::seq, "cat city"s, DocumentStatus::ACTUAL, QueryDeadline{});
+        ASSERT_HINT(!result.is_partial, "Query without deadline must not be partial"s);
+        ASSERT_EQUAL(result.documents.size(), expected.size());
+        const auto in_time = server.FindTopDocuments(execution::par, "cat city"s, DocumentStatus::ACTUAL, QueryDeadline::After(1h));
+        ASSERT(!in_time.is_partial && in_time.documents.size() == expected.size() && in_time.documents[0].id == expected[0].id);
+    }
+    {
+        const QueryDeadline expired = QueryDeadline::After(-1s);
+        ASSERT(server.FindTopDocuments(execution::seq, "cat city"s, DocumentStatus::ACTUAL, expired).is_partial);
+        ASSERT(server.FindTopDocuments(execution::par, "cat city"s, DocumentStatus::ACTUAL, expired).is_partial);
+        ASSERT(server.FindTopDocuments(ADAPTIVE, "cat city"s, DocumentStatus::ACTUAL, expired).is_partial);
+        ASSERT(server.FindTopDocuments(execution::seq, "+cat +city"s, DocumentStatus::ACTUAL, expired).is_partial);
+        server.SetScoringMode(ScoringMode::QUANTIZED_8);
+        ASSERT(server.FindTopDocuments(execution::seq, "cat city"s, DocumentStatus::ACTUAL, expired).is_partial);
+        server.SetScoringMode(ScoringMode::EXACT);
+        server.SetImpactOrderedPostings(true);
+        ASSERT(server.FindTopDocuments(execution::seq, "cat"s, DocumentStatus::ACTUAL, expired).is_partial);
+        server.SetImpactOrderedPostings(false);
+    }
+    {
+        // cancellation in the middle of query: documents scored before the next block are returned
+        QueryDeadline deadline;
+        deadline.cancellation = CancellationToken();
+        int checked_count = 0;
+        const auto result = server.FindTopDocuments(execution::seq, "city"s,
+            [&](int document_id, DocumentStatus status, int rating) {
+                if (++checked_count == 100) {
+                    deadline.cancellation->Cancel();
+                }
+                return true;
+            }, deadline);
+        ASSERT(result.is_partial);
+        ASSERT_EQUAL(checked_count, static_cast<int>(QUERY_CHECK_BLOCK_SIZE));
+        ASSERT_EQUAL(result.documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+
+        deadline.on_expiry = ExpiryPolicy::THROW;
+        try {
+            server.FindTopDocuments(execution::seq, "city"s, DocumentStatus::ACTUAL, deadline);
+            ASSERT_HINT(false, "Cancelled query must throw"s);
+        }
+        catch (const QueryTimeoutError&) {
+            ASSERT_HINT(false, "Cancelled query must not throw timeout error"s);
+        }
+        catch (const TaskCancelledError&) {
+        }
+    }
+    try {
+        server.FindTopDocuments(execution::seq, "city"s, DocumentStatus::ACTUAL, QueryDeadline::After(-1s, ExpiryPolicy::THROW));
+        ASSERT_HINT(false, "Expired query must throw"s);
+    }
+    catch (const QueryTimeoutError&) {
+    }
+
+    QueryTaskOptions options;
+    options.deadline = chrono::steady_clock::now();
+    auto future = server.FindTopDocumentsAsync("cat city"s, DocumentStatus::ACTUAL, options);
+    try {
+        future.get();
+        ASSERT_HINT(false, "Asynchronous query after deadline must not be done"s);
+    }
+    catch (const QueryTimeoutError&) {
+    }
+}
+
+// check TOP lists of hot terms (the same TOP as search, choice of hot terms, updates of base)
+void TestHotTerms() {
+    mt19937 generator(9);
+    const auto dictionary = GenerateDictionary(generator, 30, 3);
+    SearchServer server(""s);
+    for (int id = 0; id < 400; ++id) {
+        server.AddDocument(id, GenerateQuery(generator, dictionary, 1 + id % 6), static_cast<DocumentStatus>(id % 3), { id % 11 });
+    }
+    server.SetHotTermCount(2);
+
+    [[maybe_unused]] auto hot_term_hits = [] {
+        for (const auto& metric : MetricsRegistry::Instance().GetSnapshot().metrics) {
+            if (metric.name == "find_top_documents.hot_term_hits"s) {
+                return metric.count;
+            }
+        }
+        return uint64_t{ 0 };
+    };
+    // reference TOP is found by predicate, which doesn't use hot terms
+    auto check_top = [&server](const string& word, DocumentStatus status) {
+        const auto expected = server.FindTopDocuments(execution::seq, word,
+            [status](int document_id, DocumentStatus document_status, int rating) {
+                return document_status == status;
+            });
+        const auto found = server.FindTopDocuments(word, status);
+        ASSERT_EQUAL_HINT(found.size(), expected.size(), word);
+        for (size_t i = 0; i < found.size(); ++i) {
+            ASSERT_EQUAL_HINT(found[i].id, expected[i].id, word);
+            ASSERT_EQUAL_HINT(found[i].relevance, expected[i].relevance, word);
+        }
+    };
+
+    const string& hot_word = dictionary[0];
+    const string& warm_word = dictionary[1];
+    for (int i = 0; i < 20; ++i) {
+        check_top(hot_word, DocumentStatus::ACTUAL);
+        check_top(warm_word, DocumentStatus::BANNED);
+    }
+    check_top(dictionary[2], DocumentStatus::ACTUAL);
+    {
+        vector<string> expected_hot = { hot_word, warm_word };
+        sort(expected_hot.begin(), expected_hot.end());
+        ASSERT_EQUAL_HINT(server.GetHotTerms(), expected_hot, "Word of rare query must not replace hot terms"s);
+    }
+
+#ifndef SEARCH_SERVER_NO_METRICS
+    const uint64_t hits = hot_term_hits();
+    check_top(hot_word, DocumentStatus::IRRELEVANT);
+    ASSERT_HINT(hot_term_hits() > hits, "TOP of hot term must be taken from its list"s);
+#endif
+
+    // lists follow updates of base
+    for (int id = 1000; id < 1020; ++id) {
+        server.AddDocument(id, hot_word + " "s + (id % 2 ? hot_word : dictionary[3]), DocumentStatus::ACTUAL, { id % 5 });
+    }
+    check_top(hot_word, DocumentStatus::ACTUAL);
+    for (int id = 1000; id < 1020; ++id) {
+        server.RemoveDocument(id);
+        check_top(hot_word, DocumentStatus::ACTUAL);
+    }
+    for (int id = 0; id < 400; id += 2) {
+        server.RemoveDocument(id);
+    }
+    for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED }) {
+        check_top(hot_word, status);
+        check_top(warm_word, status);
+    }
+
+    // word more frequent than the coldest hot term replaces it, whatever the frequencies were at admission
+    const string& new_hot_word = dictionary[4];
+    for (int i = 0; i < 60; ++i) {
+        check_top(new_hot_word, DocumentStatus::ACTUAL);
+    }
+    {
+        vector<string> expected_hot = { hot_word, new_hot_word };
+        sort(expected_hot.begin(), expected_hot.end());
+        ASSERT_EQUAL(server.GetHotTerms(), expected_hot);
+    }
+    // other policies answer from the same lists
+    ASSERT_EQUAL(server.FindTopDocuments(execution::par, hot_word).size(), server.FindTopDocuments(hot_word).size());
+    ASSERT_EQUAL(server.FindTopDocuments(ADAPTIVE, hot_word).size(), server.FindTopDocuments(hot_word).size());
+
+    server.SetHotTermCount(0);
+    ASSERT(server.GetHotTerms().empty());
+}
+
+// check detection of duplicates when documents are added (policies, records after removal)
+void TestDuplicatePolicy() {
+    SearchServer server("and in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "city cat cat"s, DocumentStatus::ACTUAL, { 2 });
+    server.SetDuplicatePolicy(DuplicatePolicy::RECORD);
+    ASSERT_EQUAL_HINT(server.GetDuplicates().size(), 1, "Duplicates of base must be recorded"s);
+    ASSERT_EQUAL(server.GetDuplicates().at(2), 1);
+
+    server.AddDocument(3, "dog and cat"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "the city and the cat"s, DocumentStatus::BANNED, { 4 });
+    server.AddDocument(5, "cat dog"s, DocumentStatus::ACTUAL, { 5 });
+    ASSERT_EQUAL(server.GetDocumentCount(), 5);
+    ASSERT_EQUAL((map<int, int>(server.GetDuplicates().begin(), server.GetDuplicates().end())), (map<int, int>{ { 2, 1 }, { 4, 1 }, { 5, 3 } }));
+
+    server.RemoveDocument(1);
+    ASSERT_EQUAL_HINT((map<int, int>(server.GetDuplicates().begin(), server.GetDuplicates().end())), (map<int, int>{ { 4, 2 }, { 5, 3 } }),
+        "The earliest duplicate must become original"s);
+    server.RemoveDocument(5);
+    ASSERT_EQUAL((map<int, int>(server.GetDuplicates().begin(), server.GetDuplicates().end())), (map<int, int>{ { 4, 2 } }));
+
+    server.SetDuplicatePolicy(DuplicatePolicy::REJECT);
+    try {
+        server.AddDocument(6, "cat and dog dog"s, DocumentStatus::ACTUAL, { 6 });
+        ASSERT_HINT(false, "Duplicate must be rejected"s);
+    }
+    catch (const DuplicateDocumentError& error) {
+        ASSERT_EQUAL(error.GetOriginalId(), 3);
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 3);
+    server.AddDocument(6, "cat and mouse"s, DocumentStatus::ACTUAL, { 6 });
+    ASSERT_EQUAL(server.GetDocumentCount(), 4);
+
+    server.SetDuplicatePolicy(DuplicatePolicy::REPLACE);
+    server.AddDocument(7, "city cat"s, DocumentStatus::ACTUAL, { 7 });
+    ASSERT_EQUAL_HINT(vector<int>(server.begin(), server.end()), vector<int>({ 3, 6, 7 }), "Duplicates must be replaced"s);
+    ASSERT(server.GetDuplicates().empty());
+    ASSERT_EQUAL(server.FindTopDocuments("city"s)[0].id, 7);
+
+    server.SetDuplicatePolicy(DuplicatePolicy::NONE);
+    ASSERT_EQUAL(server.GetMemoryUsage().duplicate_index, 0);
+    server.AddDocument(8, "city cat"s, DocumentStatus::ACTUAL, { 8 });
+    ASSERT_EQUAL(server.GetDocumentCount(), 4);
+}
+
+// check Bloom filters of documents (false positive rate, the same matches, memory)
+void TestBloomFilters() {
+    {
+        const BloomFilterParameters parameters(0.01);
+        BlockedBloomFilter filter(1000, parameters);
+        for (int key = 0; key < 1000; ++key) {
+            filter.Add(HashBloomKey(to_string(key)));
+        }
+        int false_positive_count = 0;
+        for (int key = 0; key < 1000; ++key) {
+            ASSERT_HINT(filter.MayContain(HashBloomKey(to_string(key))), "Added key must be found"s);
+        }
+        for (int key = 1000; key < 101000; ++key) {
+            false_positive_count += filter.MayContain(HashBloomKey(to_string(key)));
+        }
+        ASSERT_HINT(false_positive_count < 2 * 0.01 * 100000, "False positive rate must be close to parameter"s);
+        try {
+            BloomFilterParameters wrong(1.0);
+            ASSERT_HINT(false, "Rate out of (0, 1) must throw"s);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+
+    // the same matches with filters, after removals and compaction of ordinals
+    mt19937 generator(13);
+    const auto dictionary = GenerateDictionary(generator, 60, 3);
+    SearchServer server(""s);
+    SearchServer filtered_server(""s);
+    filtered_server.SetBloomFilters(0.05);
+    for (int id = 0; id < 200; ++id) {
+        const string text = GenerateQuery(generator, dictionary, 1 + id % 10);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+        filtered_server.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+    }
+    ASSERT(filtered_server.GetMemoryUsage().bloom_filters > 0 && server.GetMemoryUsage().bloom_filters == 0);
+    for (int id = 0; id < 150; id += 3) {
+        server.RemoveDocument(id);
+        filtered_server.RemoveDocument(id);
+    }
+    for (int i = 0; i < 100; ++i) {
+        const string query = GenerateQuery(generator, dictionary, 1 + i % 5, 0.5);
+        for (const int id : server) {
+            ASSERT_EQUAL_HINT(get<0>(filtered_server.MatchDocument(query, id)), get<0>(server.MatchDocument(query, id)), query);
+            ASSERT_EQUAL_HINT(get<0>(filtered_server.MatchDocument(execution::par, query, id)), get<0>(server.MatchDocument(query, id)), query);
+        }
+    }
+    ASSERT_EQUAL(filtered_server.GetBloomFilterRate(), 0.05);
+    filtered_server.SetBloomFilters(0);
+    ASSERT_EQUAL(filtered_server.GetMemoryUsage().bloom_filters, 0);
+}
+
+// check log of queries (records of request queue, broken logs) and snapshots of server
+void TestQueryLog() {
+    SearchServer server("and in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1, 2, 6 });
+    server.AddDocument(2, "dog and cat"s, DocumentStatus::BANNED, { -4 });
+    server.AddDocument(3, "big dog"s, DocumentStatus::ACTUAL, { 5 });
+
+    // records of requests of queue
+    {
+        auto time = make_shared<atomic<int64_t>>(0); // ms
+        stringstream log;
+        QueryLogWriter writer(log, RequestQueueConfig::Clock::time_point(chrono::milliseconds(0)));
+        RequestQueueConfig config;
+        config.clock = [time] {
+            return RequestQueueConfig::Clock::time_point(chrono::milliseconds(*time));
+        };
+        config.query_log = &writer;
+        RequestQueue queue(server, config);
+        queue.AddFindRequest("cat"s);
+        *time = 20;
+        queue.AddFindRequest("cat -city"s, DocumentStatus::BANNED);
+        *time = 1500;
+        queue.AddFindRequest("dog"s, [](int, DocumentStatus, int rating) { return rating > 0; });
+        ASSERT_EQUAL(writer.GetRecordCount(), 3);
+
+        const vector<QueryLogRecord> records = ReadQueryLog(log);
+        ASSERT_EQUAL(records.size(), 3);
+        ASSERT_EQUAL(records[0].query, "cat"s);
+        ASSERT(records[0].filter == QueryFilter::STATUS && records[0].status == DocumentStatus::ACTUAL);
+        ASSERT_EQUAL(records[0].result_count, 1u);
+        ASSERT_EQUAL(records[1].time.count(), 20'000);
+        ASSERT(records[1].filter == QueryFilter::STATUS && records[1].status == DocumentStatus::BANNED);
+        ASSERT_EQUAL(records[1].result_count, 1u);
+        ASSERT_EQUAL(records[2].time.count(), 1'500'000);
+        ASSERT_HINT(records[2].filter == QueryFilter::PREDICATE, "Requests by predicate must be marked"s);
+        ASSERT_EQUAL(records[2].result_count, 1u);
+
+        // queue created later counts times from start of the same writer (log was read to the end)
+        log.clear();
+        *time = 3000;
+        RequestQueue late_queue(server, config);
+        *time = 3010;
+        late_queue.AddFindRequest("big"s);
+        stringstream shared_log(log.str());
+        const vector<QueryLogRecord> shared_records = ReadQueryLog(shared_log);
+        ASSERT_EQUAL(shared_records.size(), 4);
+        ASSERT_EQUAL_HINT(shared_records.back().time.count(), 3'010'000, "Times of queues sharing log must have one base"s);
+
+        // truncated log
+        const string data = log.str();
+        stringstream truncated(data.substr(0, data.size() - 2));
+        try {
+            ReadQueryLog(truncated);
+            ASSERT_HINT(false, "Broken log must throw"s);
+        }
+        catch (const invalid_argument&) {
+        }
+        stringstream wrong("SSNP"s);
+        try {
+            QueryLogReader reader(wrong);
+            ASSERT_HINT(false, "Stream without header of log must throw"s);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+    // query which reader would reject isn't written, the rest of log stays readable
+    {
+        stringstream log;
+        QueryLogWriter writer(log);
+        for (const string& query : { "cat"s, string(MAX_LOGGED_QUERY_SIZE + 1, 'a'), "dog"s }) {
+            QueryLogRecord record;
+            record.query = query;
+            writer.Write(record);
+        }
+        ASSERT_EQUAL(writer.GetRecordCount(), 2);
+        ASSERT_EQUAL(writer.GetDroppedRecordCount(), 1);
+        const vector<QueryLogRecord> records = ReadQueryLog(log);
+        ASSERT_EQUAL(records.size(), 2);
+        ASSERT_EQUAL(records[1].query, "dog"s);
+    }
+
+    // snapshot keeps base: the same results of queries
+    {
+        server.RemoveDocument(1);
+        server.AddDocument(4, "city dog in the park"s, DocumentStatus::IRRELEVANT, { 3, 4 });
+        stringstream snapshot;
+        server.SaveSnapshot(snapshot);
+        const SearchServer loaded = SearchServer::LoadSnapshot(snapshot);
+        ASSERT_EQUAL(loaded.GetDocumentCount(), server.GetDocumentCount());
+        ASSERT_EQUAL(vector<int>(loaded.begin(), loaded.end()), vector<int>(server.begin(), server.end()));
+        for (const string& query : { "cat"s, "dog city"s, "the dog -cat"s, "in"s }) {
+            for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED, DocumentStatus::IRRELEVANT }) {
+                const auto expected = server.FindTopDocuments(query, status);
+                const auto documents = loaded.FindTopDocuments(query, status);
+                ASSERT_EQUAL_HINT(documents.size(), expected.size(), query);
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    ASSERT_EQUAL(documents[i].id, expected[i].id);
+                    ASSERT_EQUAL(documents[i].rating, expected[i].rating);
+                    ASSERT(abs(documents[i].relevance - expected[i].relevance) < EPSILON);
+                }
+            }
+        }
+        ASSERT_HINT(loaded.FindTopDocuments("and"s).empty(), "Stop-words must be loaded"s);
+
+        const string data = snapshot.str();
+        stringstream truncated(data.substr(0, data.size() - 3));
+        try {
+            SearchServer::LoadSnapshot(truncated);
+            ASSERT_HINT(false, "Broken snapshot must throw"s);
+        }
+        catch (const invalid_argument&) {
+        }
+        // broken size of text (64 MiB) isn't allocated before the text is read
+        const size_t last_text = data.rfind("city dog in the park"s);
+        stringstream huge(data.substr(0, last_text - 4) + "\xff\xff\xff\x03" "city"s);
+        try {
+            SearchServer::LoadSnapshot(huge);
+            ASSERT_HINT(false, "Size of string larger than the data must throw"s);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+}
+
+// check typo-tolerant search (edit distance, index of deletions, penalty, updates of index)
+void TestFuzzySearch() {
+    ASSERT_EQUAL(ComputeEditDistance("cat"s, "cat"s, 2), 0);
+    ASSERT_EQUAL(ComputeEditDistance("cat"s, "cut"s, 2), 1);
+    ASSERT_EQUAL(ComputeEditDistance("teh"s, "the"s, 2), 1);
+    ASSERT_EQUAL(ComputeEditDistance("cat"s, "cats"s, 2), 1);
+    ASSERT_EQUAL(ComputeEditDistance("kitten"s, "sitting"s, 3), 3);
+    ASSERT_EQUAL_HINT(ComputeEditDistance("cat"s, "dog"s, 2), 3, "Distance larger than max must be max + 1"s);
+
+    // index finds the same words as scan of dictionary
+    {
+        mt19937 generator(5);
+        const auto dictionary = GenerateDictionary(generator, 300, 5);
+        DeletionIndex index(2);
+        for (const string& word : dictionary) {
+            index.Add(word);
+        }
+        for (size_t i = 0; i < dictionary.size(); i += 2) {
+            index.Remove(dictionary[i]);
+        }
+        ASSERT_EQUAL(index.GetWordCount(), dictionary.size() / 2);
+        for (const string& query : GenerateDictionary(generator, 100, 5)) {
+            set<string> expected;
+            for (size_t i = 1; i < dictionary.size(); i += 2) {
+                if (ComputeEditDistance(query, dictionary[i], 2) <= 2) {
+                    expected.insert(dictionary[i]);
+                }
+            }
+            set<string> found;
+            for (const auto& [word, distance] : index.Find(query)) {
+                ASSERT_EQUAL(distance, ComputeEditDistance(query, word, 2));
+                found.insert(string(word));
+            }
+            ASSERT_EQUAL_HINT(found, expected, query);
+        }
+    }
+
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5 });
+    server.AddDocument(4, "fluffy dog"s, DocumentStatus::ACTUAL, { 2 });
+    const auto exact = server.FindTopDocuments("fluffy cat"s);
+    ASSERT_HINT(server.FindTopDocuments("flufy"s).empty(), "Misspelled words are exact without fuzzy search"s);
+
+    FuzzySearchOptions options;
+    options.max_distance = 2;
+    options.penalty = 0.5;
+    server.SetFuzzySearch(options);
+    {
+        const auto documents = server.FindTopDocuments("flufy"s);
+        ASSERT_EQUAL(documents.size(), 2);
+        ASSERT_EQUAL(documents[0].id, 2);
+        ASSERT_EQUAL(documents[1].id, 4);
+        // IDF of distance 1 is halved
+        ASSERT(abs(documents[0].relevance - 0.5 * 0.5 * log(4.0 / 2)) < EPSILON);
+        ASSERT_EQUAL(get<0>(server.MatchDocument("flufy"s, 2)), vector<string_view>{ "fluffy"sv });
+
+        const auto exact_documents = server.FindTopDocuments("fluffy cat"s);
+        ASSERT_EQUAL_HINT(exact_documents.size(), exact.size(), "Words of dictionary must not be expanded"s);
+        for (size_t i = 0; i < exact.size(); ++i) {
+            ASSERT_EQUAL(exact_documents[i].id, exact[i].id);
+            ASSERT(abs(exact_documents[i].relevance - exact[i].relevance) < EPSILON);
+        }
+        // exact word isn't penalized when it is expansion of other word
+        const auto mixed = server.FindTopDocuments("fluffy flufy"s);
+        ASSERT(abs(mixed[0].relevance - 0.5 * log(4.0 / 2)) < EPSILON);
+    }
+    {
+        // "dot" -> "dog" (1 edit) before "cat" (2 edits)
+        options.max_expansions = 1;
+        server.SetFuzzySearch(options);
+        const auto documents = server.FindTopDocuments("dot"s);
+        ASSERT_EQUAL(documents.size(), 2);
+        ASSERT(documents[0].id == 3 || documents[0].id == 4);
+        options.max_expansions = MAX_FUZZY_EXPANSION;
+        server.SetFuzzySearch(options);
+        ASSERT_EQUAL(server.FindTopDocuments("dot"s).size(), 4);
+        ASSERT_EQUAL_HINT(server.FindTopDocuments("dot -cat"s).size(), 2, "Minus-words must be exact"s);
+    }
+    {
+        // expansions of required word are required as a group
+        const auto documents = server.FindTopDocuments("+cta dog"s);
+        ASSERT_EQUAL_HINT(documents.size(), 2, "Document must contain some expansion of required word"s);
+        for (const Document& document : documents) {
+            ASSERT(document.id == 1 || document.id == 2);
+        }
+        ASSERT_EQUAL(server.FindTopDocuments(execution::par, "+cta dog"s).size(), 2);
+        ASSERT_EQUAL(server.FindTopDocuments("+cta +dgo"s).size(), 0);
+        ASSERT_EQUAL(server.FindTopDocuments("+flufy +dgo"s).size(), 1);
+        ASSERT(get<0>(server.MatchDocument("+cta dog"s, 3)).empty());
+        ASSERT_EQUAL(get<0>(server.MatchDocument(execution::par, "+cta dog"s, 2)), vector<string_view>{ "cat"sv });
+        ASSERT_HINT(server.FindTopDocuments("+qqqqq cat"s).empty(), "Required word without expansions matches nothing"s);
+
+        server.SetMatchMode(MatchMode::ALL);
+        ASSERT_EQUAL(server.FindTopDocuments("flufy cta"s).size(), 1);
+        server.SetMatchMode(MatchMode::ANY);
+    }
+    {
+        // index is updated: words of removed documents, keys viewing texts of other documents
+        server.RemoveDocument(2);
+        ASSERT_EQUAL(server.FindTopDocuments("flufy"s).size(), 1);
+        ASSERT(server.FindTopDocuments("tial"s).empty());
+        server.AddDocument(5, "long tail"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_EQUAL(server.FindTopDocuments("tial"s).size(), 1);
+        ASSERT(server.GetMemoryUsage().fuzzy_index > 0);
+        options.max_distance = 0;
+        server.SetFuzzySearch(options);
+        ASSERT_EQUAL(server.GetMemoryUsage().fuzzy_index, 0);
+        ASSERT(server.FindTopDocuments("tial"s).empty());
+    }
+    try {
+        options.max_distance = MAX_FUZZY_DISTANCE + 1;
+        server.SetFuzzySearch(options);
+        ASSERT_HINT(false, "Too large distance must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+}
+
+// check shared dictionary (stop-words and terms of several servers, the same results, memory)
+void TestSharedDictionary() {
+    const auto dictionary = make_shared<const SharedDictionary>("and in the"s, vector<string>{ "cat"s, "dog"s, "city"s, "cat"s });
+    ASSERT(dictionary->IsStopWord("in"s) && !dictionary->IsStopWord("cat"s));
+    ASSERT_EQUAL(dictionary->GetStopWords(), (vector<string_view>{ "and"sv, "in"sv, "the"sv }));
+    ASSERT_EQUAL(dictionary->GetTermCount(), 3);
+    ASSERT_EQUAL(dictionary->FindTerm("dog"s), "dog"sv);
+    ASSERT_HINT(dictionary->FindTerm("dog"s).data() == dictionary->FindTerm("dog"sv).data(), "Terms must be interned"s);
+    ASSERT(dictionary->FindTerm("bird"s).empty());
+    try {
+        SharedDictionary wrong(vector<string>{ "a\x12"s });
+        ASSERT_HINT(false, "Invalid stop-word must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    try {
+        SearchServer server(shared_ptr<const SharedDictionary>{});
+        ASSERT_HINT(false, "Server without dictionary must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+
+    // servers attached to dictionary find the same as server with own stop-words
+    auto executor = make_shared<ThreadPool>(2);
+    SearchServer server("and in the"s, executor);
+    SearchServer first(dictionary, executor);
+    SearchServer second(dictionary, executor);
+    ASSERT_EQUAL(dictionary.use_count(), 3);
+    ASSERT(first.GetDictionary() == dictionary && server.GetDictionary() == nullptr);
+    const vector<string> texts = { "cat in the city"s, "dog and cat"s, "big dog in the park"s, "city park"s, "cat cat bird"s };
+    for (size_t i = 0; i < texts.size(); ++i) {
+        for (SearchServer* target : { &server, &first, &second }) {
+            target->AddDocument(i, texts[i], DocumentStatus::ACTUAL, { static_cast<int>(i) });
+        }
+    }
+    ASSERT_EQUAL_HINT(first.GetMemoryUsage().stop_words, 0, "Attached server must have no own stop-words"s);
+    ASSERT(server.GetMemoryUsage().stop_words > 0);
+
+    auto check_same = [&](const string& hint) {
+        for (const string& query : { "cat"s, "dog city -bird"s, "the park"s, "bird"s, "and"s }) {
+            const auto expected = server.FindTopDocuments(query);
+            for (const SearchServer* target : { &first, &second }) {
+                const auto documents = target->FindTopDocuments(query);
+                ASSERT_EQUAL_HINT(documents.size(), expected.size(), hint + query);
+                for (size_t i = 0; i < documents.size(); ++i) {
+                    ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, hint + query);
+                    ASSERT(abs(documents[i].relevance - expected[i].relevance) < EPSILON);
+                }
+            }
+        }
+    };
+    check_same("added: "s);
+    // keys of terms don't view texts of removed documents
+    for (SearchServer* target : { &server, &first }) {
+        target->RemoveDocument(0);
+        target->RemoveDocument(1);
+        target->SetImpactOrderedPostings(true);
+    }
+    second.RemoveDocument(0);
+    second.RemoveDocument(execution::par, 1);
+    second.SetDuplicatePolicy(DuplicatePolicy::RECORD);
+    check_same("removed: "s);
+
+    stringstream snapshot;
+    first.SaveSnapshot(snapshot);
+    const string data = snapshot.str();
+    try {
+        stringstream input(data);
+        SearchServer::LoadSnapshot(input);
+        ASSERT_HINT(false, "Snapshot of attached server must be loaded with dictionary"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    try {
+        stringstream input(data);
+        SearchServer::LoadSnapshot(input, make_shared<const SharedDictionary>("and the"s));
+        ASSERT_HINT(false, "Dictionary of other stop-words must throw"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    stringstream input(data);
+    const SearchServer loaded = SearchServer::LoadSnapshot(input, dictionary);
+    ASSERT_HINT(loaded.GetDictionary() == dictionary, "Loaded server must be attached to dictionary"s);
+    ASSERT(loaded.FindTopDocuments("the"s).empty());
+    ASSERT_EQUAL(loaded.FindTopDocuments("dog"s).size(), 1);
+}
+
+// check structured filter of documents by status and range of ratings
+void TestDocumentFilter() {
+    SearchServer server("and in the"s);
+    const vector<string> words = { "cat"s, "dog"s, "city"s, "park"s, "bird"s };
+    // ratings grow by blocks, so most blocks of ordinals can't pass range
+    for (int i = 0; i < 10 * static_cast<int>(FILTER_BLOCK_SIZE); ++i) {
+        const string text = words[i % 5] + " "s + words[i % 3] + " "s + words[i % 7 % 5];
+        server.AddDocument(i, text, static_cast<DocumentStatus>(i % 3), { i / static_cast<int>(FILTER_BLOCK_SIZE) });
+    }
+    ASSERT(DocumentFilter{}(0, DocumentStatus::BANNED, -5));
+    ASSERT(!(DocumentFilter{ DocumentStatus::ACTUAL, 1, 2 }(0, DocumentStatus::ACTUAL, 3)));
+
+    auto check_same = [&](const string& hint) {
+        const vector<DocumentFilter> filters = { {}, { DocumentStatus::ACTUAL }, { nullopt, 3, 4 },
+            { DocumentStatus::IRRELEVANT, 7, 7 }, { DocumentStatus::REMOVED }, { DocumentStatus::ACTUAL, 5, 2 } };
+        for (const string& query : { "cat"s, "dog city -bird"s, "park bird"s, "+cat city"s }) {
+            for (const DocumentFilter& filter : filters) {
+                auto lambda = [&filter](int id, DocumentStatus status, int rating) {
+                    return filter(id, status, rating);
+                };
+                const auto expected = server.FindTopDocuments(query, lambda);
+                for (const auto& documents : { server.FindTopDocuments(query, filter),
+                    server.FindTopDocuments(execution::par, query, filter) }) {
+                    ASSERT_EQUAL_HINT(documents.size(), expected.size(), hint + query);
+                    for (size_t i = 0; i < documents.size(); ++i) {
+                        ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, hint + query);
+                        ASSERT(abs(documents[i].relevance - expected[i].relevance) < EPSILON);
+                    }
+                }
+            }
+        }
+    };
+    check_same("added: "s);
+    PageRequest request;
+    request.limit = 100;
+    const auto page = server.FindTopDocuments("cat"s, request, DocumentFilter{ nullopt, 2, 2 });
+    ASSERT(!page.empty());
+    for (const Document& document : page) {
+        ASSERT_EQUAL(document.rating, 2);
+    }
+
+    server.SetMatchMode(MatchMode::ALL);
+    check_same("all: "s);
+    server.SetMatchMode(MatchMode::ANY);
+    // summaries keep removed documents until ordinals are compacted
+    for (int i = 0; i < 3 * static_cast<int>(FILTER_BLOCK_SIZE); ++i) {
+        server.RemoveDocument(i * 2);
+    }
+    check_same("removed: "s);
+    for (int i = 0; i < 7 * static_cast<int>(FILTER_BLOCK_SIZE); ++i) {
+        if (i % 2 == 1 || i >= 6 * static_cast<int>(FILTER_BLOCK_SIZE)) {
+            server.RemoveDocument(i);
+        }
+    }
+    server.AddDocument(10'000, "cat city"s, DocumentStatus::ACTUAL, { 3 });
+    check_same("compacted: "s);
+    const auto documents = server.FindTopDocuments("cat city"s, DocumentFilter{ DocumentStatus::ACTUAL, 3, 3 });
+    ASSERT(!documents.empty() && documents.front().id == 10'000);
+}
+
 // TestSearchServer - launch tests
 void TestSearchServer() {
     RUN_TEST(TestAddingNewDocument);
@@ -165,4 +1761,28 @@ void TestSearchServer() {
     RUN_TEST(TestExcludeDocsWithMinusWords);
     RUN_TEST(TestMatchingWords);
     RUN_TEST(TestComplexSearchDocument);
+    RUN_TEST(TestPrefixQuery);
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestQueryService);
+    RUN_TEST(TestAsyncQuery);
+    RUN_TEST(TestExecutor);
+    RUN_TEST(TestAdaptiveExecution);
+    RUN_TEST(TestRequestQueue);
+    RUN_TEST(TestMetrics);
+    RUN_TEST(TestMemoryUsage);
+    RUN_TEST(TestPagination);
+    RUN_TEST(TestQuantizedScoring);
+    RUN_TEST(TestImpactOrderedPostings);
+    RUN_TEST(TestDocumentOrdinals);
+    RUN_TEST(TestMemoryResources);
+    RUN_TEST(TestQueryPlanner);
+    RUN_TEST(TestConjunctiveQuery);
+    RUN_TEST(TestQueryDeadline);
+    RUN_TEST(TestHotTerms);
+    RUN_TEST(TestDuplicatePolicy);
+    RUN_TEST(TestBloomFilters);
+    RUN_TEST(TestQueryLog);
+    RUN_TEST(TestFuzzySearch);
+    RUN_TEST(TestSharedDictionary);
+    RUN_TEST(TestDocumentFilter);
 }
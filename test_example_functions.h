@@ -106,6 +106,78 @@ void TestMatchingWords();
 // check search TOP documents (test search by predicate and search for selected status)
 void TestComplexSearchDocument();
 
+// check expansion of prefix query words (cat*)
+void TestPrefixQuery();
+
+// check sharded server (results must be the same as for one server)
+void TestShardedSearchServer();
+
+// check query service (responses to pipelined requests)
+void TestQueryService();
+
+// check asynchronous queries (results, cancellation, bounded queue)
+void TestAsyncQuery();
+
+// check executor (parallel sorting, nested ParallelFor, parallel queries)
+void TestExecutor();
+
+// check adaptive execution (cost of query, fan-out, the same results)
+void TestAdaptiveExecution();
+
+// check request queue (sliding window, concurrent requests)
+void TestRequestQueue();
+
+// check metrics (histograms, counters, aggregation of threads, stages of query)
+void TestMetrics();
+
+// check memory usage of structures (counting, release on removal)
+void TestMemoryUsage();
+
+// check pages of search results (offset, limit, search-after cursor, lazy paginator)
+void TestPagination();
+
+// check quantized scoring (the same documents, relevance within error bound, updates of index)
+void TestQuantizedScoring();
+
+// check impact-ordered postings (the same TOP as full search, updates of index)
+void TestImpactOrderedPostings();
+
+// check internal ordinals of documents (order of adding, compaction after removal)
+void TestDocumentOrdinals();
+
+// check memory resources (arenas of queries, memory resource of index)
+void TestMemoryResources();
+
+// check query planner (exclusions first, order of plus-words, skipped words, explanation)
+void TestQueryPlanner();
+
+// check conjunctive queries (required words, ALL mode, intersection of postings)
+void TestConjunctiveQuery();
+
+// check deadlines of queries (partial results, errors, cancellation, asynchronous queries)
+void TestQueryDeadline();
+
+// check TOP lists of hot terms (the same TOP as search, choice of hot terms, updates of base)
+void TestHotTerms();
+
+// check detection of duplicates when documents are added (policies, records after removal)
+void TestDuplicatePolicy();
+
+// check Bloom filters of documents (false positive rate, the same matches, memory)
+void TestBloomFilters();
+
+// check log of queries (records of request queue, broken logs) and snapshots of server
+void TestQueryLog();
+
+// check typo-tolerant search (edit distance, index of deletions, penalty, updates of index)
+void TestFuzzySearch();
+
+// check shared dictionary (stop-words and terms of several servers, the same results, memory)
+void TestSharedDictionary();
+
+// check structured filter of documents by status and range of ratings
+void TestDocumentFilter();
+
 //  TestSearchServer      
 void TestSearchServer();
 
@@ -0,0 +1,316 @@
+#include "thread_pool.h"
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+// pool and index of worker running in current thread
+static thread_local const ThreadPool* current_pool = nullptr;
+static thread_local int current_worker = -1;
+
+static void PinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+}
+
+vector<int> GetNumaNodeCpus(int node) {
+    // list like "0-3,8-11"
+    ifstream input("/sys/devices/system/node/node"s + to_string(node) + "/cpulist"s);
+    vector<int> cpus;
+    string range;
+    while (getline(input, range, ',')) {
+        const size_t dash = range.find('-');
+        const int first = stoi(range.substr(0, dash));
+        const int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+CancellationToken::CancellationToken() :
+    cancelled_(make_shared<atomic<bool>>(false)) {
+
+}
+
+void CancellationToken::Cancel() const {
+    cancelled_->store(true, memory_order_relaxed);
+}
+
+bool CancellationToken::IsCancelled() const {
+    return cancelled_->load(memory_order_relaxed);
+}
+
+static ThreadPoolConfig ResolveCpus(ThreadPoolConfig config) {
+    if (config.thread_count == 0) {
+        throw invalid_argument("Thread count must be positive");
+    }
+    if (config.cpus.empty() && config.numa_node >= 0) {
+        config.cpus = GetNumaNodeCpus(config.numa_node);
+        if (config.cpus.empty()) {
+            throw invalid_argument("Unknown NUMA node "s + to_string(config.numa_node));
+        }
+    }
+    return config;
+}
+
+static ThreadPoolConfig MakeConfig(size_t thread_count, size_t max_queue_size) {
+    ThreadPoolConfig config;
+    config.thread_count = thread_count;
+    config.max_queue_size = max_queue_size;
+    return config;
+}
+
+ThreadPool::ThreadPool(ThreadPoolConfig config) :
+    config_(ResolveCpus(move(config))) {
+
+}
+
+ThreadPool::ThreadPool(size_t thread_count, size_t max_queue_size) :
+    ThreadPool(MakeConfig(thread_count, max_queue_size)) {
+
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard guard(mutex_);
+        stopped_ = true;
+    }
+    has_task_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+void ThreadPool::Submit(Task task, TaskPriority priority) {
+    switch (PushLocal(task)) {
+    case LocalPush::PUSHED:
+        return;
+    case LocalPush::FULL:
+        // only this worker takes space in its deque, so it can't wait for it
+        RunTask(task);
+        return;
+    case LocalPush::NOT_WORKER:
+        break;
+    }
+    {
+        unique_lock lock(mutex_);
+        has_space_.wait(lock, [this] { return !IsFull(); });
+        Start();
+        tasks_[static_cast<size_t>(priority)].push_back(move(task));
+        ++task_count_;
+        ++pending_count_;
+    }
+    has_task_.notify_one();
+}
+
+bool ThreadPool::TrySubmit(Task task, TaskPriority priority) {
+    const LocalPush local_push = PushLocal(task);
+    if (local_push != LocalPush::NOT_WORKER) {
+        return local_push == LocalPush::PUSHED;
+    }
+    {
+        lock_guard guard(mutex_);
+        if (IsFull()) {
+            return false;
+        }
+        Start();
+        tasks_[static_cast<size_t>(priority)].push_back(move(task));
+        ++task_count_;
+        ++pending_count_;
+    }
+    has_task_.notify_one();
+    return true;
+}
+
+void ThreadPool::ParallelFor(size_t count, const function<void(size_t)>& function) {
+    struct State {
+        atomic<size_t> next_index = 0;
+        atomic<size_t> done_count = 0;
+        std::mutex state_mutex;
+        condition_variable all_done;
+        exception_ptr error;
+    };
+    auto state = make_shared<State>();
+
+    // helpers started after all indexes are taken don't use function
+    auto run = [state, &function, count] {
+        size_t done_count = 0;
+        for (size_t i = state->next_index++; i < count; i = state->next_index++) {
+            try {
+                function(i);
+            }
+            catch (...) {
+                lock_guard guard(state->state_mutex);
+                if (!state->error) {
+                    state->error = current_exception();
+                }
+            }
+            ++done_count;
+        }
+        if (done_count > 0 && state->done_count.fetch_add(done_count) + done_count == count) {
+            lock_guard guard(state->state_mutex);
+            state->all_done.notify_all();
+        }
+    };
+
+    // calling thread does the work itself if queue is full
+    const size_t helper_count = count > 1 ? min(count - 1, config_.thread_count) : 0;
+    for (size_t i = 0; i < helper_count && TrySubmit(run, TaskPriority::HIGH); ++i) {
+    }
+    run();
+
+    unique_lock lock(state->state_mutex);
+    state->all_done.wait(lock, [&state, count] { return state->done_count == count; });
+    if (state->error) {
+        rethrow_exception(state->error);
+    }
+}
+
+size_t ThreadPool::GetConcurrency() const {
+    return config_.thread_count;
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return config_.thread_count;
+}
+
+size_t ThreadPool::GetQueueSize() const {
+    lock_guard guard(mutex_);
+    return task_count_;
+}
+
+size_t ThreadPool::GetFailedTaskCount() const {
+    return failed_task_count_;
+}
+
+bool ThreadPool::IsFull() const {
+    return config_.max_queue_size > 0 && task_count_ >= config_.max_queue_size;
+}
+
+void ThreadPool::Start() {
+    if (!workers_.empty()) {
+        return;
+    }
+    for (size_t i = 0; i < config_.thread_count; ++i) {
+        workers_.push_back(make_unique<Worker>());
+    }
+    for (size_t i = 0; i < config_.thread_count; ++i) {
+        workers_[i]->thread = thread([this, i] { Work(i); });
+    }
+}
+
+int ThreadPool::GetCurrentWorker() const {
+    return current_pool == this ? current_worker : -1;
+}
+
+ThreadPool::LocalPush ThreadPool::PushLocal(Task& task) {
+    const int index = GetCurrentWorker();
+    if (!config_.work_stealing || index < 0) {
+        return LocalPush::NOT_WORKER;
+    }
+    {
+        lock_guard guard(workers_[index]->mutex);
+        if (config_.max_queue_size > 0 && workers_[index]->tasks.size() >= config_.max_queue_size) {
+            return LocalPush::FULL;
+        }
+        workers_[index]->tasks.push_back(move(task));
+    }
+    ++pending_count_;
+    NotifyWorker();
+    return LocalPush::PUSHED;
+}
+
+void ThreadPool::RunTask(Task& task) {
+    try {
+        task();
+    }
+    catch (...) {
+        // exception must not terminate worker (and process)
+        ++failed_task_count_;
+    }
+}
+
+void ThreadPool::NotifyWorker() {
+    // waiting worker checks pending_count_ under mutex_
+    {
+        lock_guard guard(mutex_);
+    }
+    has_task_.notify_one();
+}
+
+bool ThreadPool::TakeTask(size_t worker_index, Task& task) {
+    // own tasks: the last submitted is the first done (its data is in cache)
+    if (config_.work_stealing) {
+        Worker& worker = *workers_[worker_index];
+        lock_guard guard(worker.mutex);
+        if (!worker.tasks.empty()) {
+            task = move(worker.tasks.back());
+            worker.tasks.pop_back();
+            --pending_count_;
+            return true;
+        }
+    }
+
+    {
+        unique_lock lock(mutex_);
+        for (auto it = tasks_.rbegin(); it != tasks_.rend(); ++it) {
+            if (!it->empty()) {
+                task = move(it->front());
+                it->pop_front();
+                --task_count_;
+                --pending_count_;
+                lock.unlock();
+                has_space_.notify_one();
+                return true;
+            }
+        }
+    }
+
+    // stealing the oldest task of other worker
+    if (config_.work_stealing) {
+        for (size_t i = 1; i < workers_.size(); ++i) {
+            Worker& victim = *workers_[(worker_index + i) % workers_.size()];
+            lock_guard guard(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --pending_count_;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::Work(size_t worker_index) {
+    current_pool = this;
+    current_worker = static_cast<int>(worker_index);
+    if (!config_.cpus.empty()) {
+        PinCurrentThread(config_.cpus[worker_index % config_.cpus.size()]);
+    }
+
+    while (true) {
+        Task task;
+        if (TakeTask(worker_index, task)) {
+            RunTask(task);
+            continue;
+        }
+        unique_lock lock(mutex_);
+        has_task_.wait(lock, [this] { return stopped_ || pending_count_ > 0; });
+        if (stopped_ && pending_count_ == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "executor.h"
+
+// shared flag of cancellation: all copies of token are cancelled together
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void Cancel() const;
+
+    bool IsCancelled() const;
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+};
+
+// thrown (or put in future) when cancelled task is not done
+class TaskCancelledError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+struct ThreadPoolConfig {
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    // tasks submitted from other threads waiting for workers, 0 - not bounded; deque of every worker is
+    // bounded by it too
+    size_t max_queue_size = 0;
+    // workers are pinned to these CPUs (round robin), empty - not pinned
+    std::vector<int> cpus;
+    // if cpus are empty, workers are pinned to CPUs of NUMA node (Linux), -1 - not pinned
+    int numa_node = -1;
+    // tasks submitted by worker go to its own deque, idle workers steal them; they are parts of task being
+    // done, so they are taken before tasks of queue whatever their priority is
+    bool work_stealing = true;
+};
+
+// fixed set of worker threads with bounded queue of tasks,
+// tasks of higher priority are taken first, threads are started on first task;
+// exception of task is caught by worker and counted (tasks set their futures themselves)
+class ThreadPool : public Executor {
+public:
+    explicit ThreadPool(ThreadPoolConfig config);
+    explicit ThreadPool(size_t thread_count, size_t max_queue_size = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // tasks left in queue are done before threads are joined
+    ~ThreadPool() override;
+
+    // adding task, waiting while queue is full (worker with full deque does task itself)
+    void Submit(Task task, TaskPriority priority = TaskPriority::NORMAL);
+
+    // adding task if queue is not full: true/false
+    bool TrySubmit(Task task, TaskPriority priority = TaskPriority::NORMAL) override;
+
+    // calling function(i) for i from 0 to count - 1 by workers and calling thread,
+    // so it may be called from tasks of the same pool
+    void ParallelFor(size_t count, const std::function<void(size_t)>& function) override;
+
+    size_t GetConcurrency() const override;
+
+    size_t GetThreadCount() const;
+
+    // tasks submitted from other threads and waiting for workers
+    size_t GetQueueSize() const;
+
+    // tasks which have thrown exception
+    size_t GetFailedTaskCount() const;
+
+private:
+    struct Worker {
+        std::thread thread;
+        // tasks submitted by this worker (work stealing)
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    const ThreadPoolConfig config_;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::array<std::deque<Task>, 3> tasks_; // by priority
+    size_t task_count_ = 0;
+    // tasks in queue and in deques of workers
+    std::atomic<size_t> pending_count_ = 0;
+    std::atomic<size_t> failed_task_count_ = 0;
+    bool stopped_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable has_task_;
+    std::condition_variable has_space_;
+
+    bool IsFull() const;
+    void Start();
+    // index of worker of this pool running in current thread or -1
+    int GetCurrentWorker() const;
+    enum class LocalPush {
+        NOT_WORKER,
+        PUSHED,
+        FULL,
+    };
+    // pushing task to deque of current worker if it has space
+    LocalPush PushLocal(Task& task);
+    // calling task, its exception is counted
+    void RunTask(Task& task);
+    void NotifyWorker();
+    bool TakeTask(size_t worker_index, Task& task);
+    void Work(size_t worker_index);
+};
+
+// CPUs of NUMA node from /sys/devices/system/node (Linux), empty if node is unknown
+std::vector<int> GetNumaNodeCpus(int node);
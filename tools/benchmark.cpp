@@ -0,0 +1,499 @@
+// Benchmark of search server operations over grid of parameters.
+// benchmark [--documents=1000,10000] [--vocabulary=1000] [--document-words=50] [--query-words=3,10]
+//           [--minus-prob=0,0.2] [--actual-share=1,0.5] [--threads=1,4] [--queries=200] [--repetitions=3]
+//           [--operations=add,add_dedup,query,query_par,query_q8,query_q16,query_impact,query_and,query_hot,query_fuzzy,query_typo,query_range,query_filter,tenants,tenants_shared,match,match_seq,match_bloom,remove,dedup]
+//           [--output=FILE]
+// Lists of values are swept as cartesian product, every result is JSON object on its own line.
+// benchmark --compare=BASE.json,NEW.json [--noise=0.05]
+// compares ns_per_op of the same cases, exit code 1 if some case is slower than noise allows.
+// Results of "add" have memory of server by structures (memory_* fields).
+#include "../generators.h"
+#include "../process_queries.h"
+#include "../remove_duplicates.h"
+#include "../search_server.h"
+#include "../thread_pool.h"
+#include "tool_options.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+// hot terms of "query_hot" (single-word queries of corpus are mostly hot with --query-words=1)
+const size_t HOT_TERM_BENCHMARK_COUNT = 64;
+// false positive rate of Bloom filters of "match_bloom"
+const double BLOOM_BENCHMARK_RATE = 0.01;
+// edit distance of "query_fuzzy" (queries of corpus) and "query_typo" (one typo in every plus-word)
+const size_t FUZZY_BENCHMARK_DISTANCE = 2;
+// servers of "tenants" (own stop-words) and "tenants_shared" (shared dictionary), every one has documents
+// of corpus, memory is total of servers (and of dictionary)
+const size_t TENANT_BENCHMARK_COUNT = 100;
+const size_t TENANT_STOP_WORD_COUNT = 500;
+const size_t TENANT_DOCUMENT_COUNT = 10;
+// "query_range" (lambda) and "query_filter" (DocumentFilter): ratings of documents grow with order of adding
+// from 0 to FILTER_RATING_LEVELS - 1, queries select ACTUAL documents of the top FILTER_RATING_SHARE of levels
+const int FILTER_RATING_LEVELS = 100;
+const double FILTER_RATING_SHARE = 0.1;
+
+struct BenchmarkCase {
+    int documents = 0;
+    int vocabulary = 0;
+    int document_words = 0;
+    int query_words = 0;
+    double minus_prob = 0;
+    double actual_share = 0;
+    int threads = 0;
+};
+
+struct BenchmarkResult {
+    string operation;
+    BenchmarkCase parameters;
+    size_t ops = 0;
+    double ns_per_op = 0;
+    // memory of server after operation "add"
+    MemoryUsage memory;
+};
+
+template <typename Value>
+vector<Value> ParseList(const string& text, function<Value(const string&)> parse) {
+    vector<Value> values;
+    istringstream input(text);
+    string item;
+    while (getline(input, item, ',')) {
+        values.push_back(parse(item));
+    }
+    if (values.empty()) {
+        throw invalid_argument("Empty list of values"s);
+    }
+    return values;
+}
+
+vector<int> ParseInts(const string& text) {
+    return ParseList<int>(text, [](const string& item) { return stoi(item); });
+}
+
+vector<double> ParseDoubles(const string& text) {
+    return ParseList<double>(text, [](const string& item) { return stod(item); });
+}
+
+vector<string> ParseStrings(const string& text) {
+    return ParseList<string>(text, [](const string& item) { return item; });
+}
+
+class Corpus {
+public:
+    Corpus(const BenchmarkCase& parameters, int query_count) {
+        mt19937 generator(42);
+        const auto dictionary = GenerateDictionary(generator, parameters.vocabulary, 10);
+        for (int i = 0; i < parameters.documents; ++i) {
+            texts.push_back(GenerateQuery(generator, dictionary, parameters.document_words));
+            statuses.push_back(uniform_real_distribution<>(0, 1)(generator) < parameters.actual_share
+                ? DocumentStatus::ACTUAL
+                : static_cast<DocumentStatus>(uniform_int_distribution<>(1, 3)(generator)));
+        }
+        for (int i = 0; i < query_count; ++i) {
+            queries.push_back(GenerateQuery(generator, dictionary, parameters.query_words, parameters.minus_prob));
+        }
+    }
+
+    // server with documents of corpus, every document is added `copies` times (as duplicates)
+    void Fill(SearchServer& server, int copies = 1) const {
+        for (int copy = 0; copy < copies; ++copy) {
+            for (size_t i = 0; i < texts.size(); ++i) {
+                server.AddDocument(copy * texts.size() + i, texts[i], statuses[i], { 1, 2, 3 });
+            }
+        }
+    }
+
+    vector<string> texts;
+    vector<DocumentStatus> statuses;
+    vector<string> queries;
+};
+
+// median time (ns) of one operation: prepare isn't measured, run returns count of operations
+// query with the middle letter of every plus-word replaced by the next one
+string AddTypos(const string& query) {
+    string result = query;
+    size_t begin = 0;
+    while (begin < result.size()) {
+        size_t end = result.find(' ', begin);
+        if (end == string::npos) {
+            end = result.size();
+        }
+        if (end > begin && result[begin] != '-') {
+            char& letter = result[begin + (end - begin) / 2];
+            letter = letter == 'z' ? 'a' : letter + 1;
+        }
+        begin = end + 1;
+    }
+    return result;
+}
+
+double Measure(int repetitions, const function<void()>& prepare, const function<size_t()>& run, size_t& ops) {
+    vector<double> times;
+    for (int i = 0; i < repetitions; ++i) {
+        prepare();
+        const auto start = Clock::now();
+        ops = run();
+        const double time = chrono::duration<double, nano>(Clock::now() - start).count();
+        times.push_back(ops > 0 ? time / ops : 0);
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+vector<BenchmarkResult> RunCase(const BenchmarkCase& parameters, const vector<string>& operations, int query_count, int repetitions) {
+    const Corpus corpus(parameters, query_count);
+    const auto executor = make_shared<ThreadPool>(parameters.threads);
+
+    vector<BenchmarkResult> results;
+    for (const string& operation : operations) {
+        unique_ptr<SearchServer> server;
+        auto make_server = [&](int copies) {
+            server = make_unique<SearchServer>(""s, executor);
+            if (copies > 0) {
+                corpus.Fill(*server, copies);
+            }
+        };
+
+        BenchmarkResult result;
+        result.operation = operation;
+        result.parameters = parameters;
+        if (operation == "add"s) {
+            result.ns_per_op = Measure(repetitions, [&] { make_server(0); },
+                [&] {
+                    corpus.Fill(*server);
+                    return corpus.texts.size();
+                }, result.ops);
+            result.memory = server->GetMemoryUsage();
+        }
+        else if (operation == "add_dedup"s) {
+            result.ns_per_op = Measure(repetitions,
+                [&] {
+                    make_server(0);
+                    server->SetDuplicatePolicy(DuplicatePolicy::RECORD);
+                },
+                [&] {
+                    corpus.Fill(*server);
+                    return corpus.texts.size();
+                }, result.ops);
+            result.memory = server->GetMemoryUsage();
+        }
+        else if (operation == "query"s) {
+            make_server(1);
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    ProcessQueries(*server, corpus.queries);
+                    return corpus.queries.size();
+                }, result.ops);
+        }
+        else if (operation == "query_q8"s || operation == "query_q16"s) {
+            make_server(1);
+            server->SetScoringMode(operation == "query_q8"s ? ScoringMode::QUANTIZED_8 : ScoringMode::QUANTIZED_16);
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    for (const string& query : corpus.queries) {
+                        server->FindTopDocuments(query);
+                    }
+                    return corpus.queries.size();
+                }, result.ops);
+            result.memory = server->GetMemoryUsage();
+        }
+        else if (operation == "query_impact"s) {
+            make_server(1);
+            server->SetImpactOrderedPostings(true);
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    for (const string& query : corpus.queries) {
+                        server->FindTopDocuments(query);
+                    }
+                    return corpus.queries.size();
+                }, result.ops);
+            result.memory = server->GetMemoryUsage();
+        }
+        else if (operation == "query_and"s) {
+            make_server(1);
+            server->SetMatchMode(MatchMode::ALL);
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    for (const string& query : corpus.queries) {
+                        server->FindTopDocuments(query);
+                    }
+                    return corpus.queries.size();
+                }, result.ops);
+        }
+        else if (operation == "query_hot"s) {
+            make_server(1);
+            server->SetHotTermCount(HOT_TERM_BENCHMARK_COUNT);
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    for (const string& query : corpus.queries) {
+                        server->FindTopDocuments(query);
+                    }
+                    return corpus.queries.size();
+                }, result.ops);
+        }
+        else if (operation == "query_fuzzy"s || operation == "query_typo"s) {
+            make_server(1);
+            FuzzySearchOptions options;
+            options.max_distance = FUZZY_BENCHMARK_DISTANCE;
+            server->SetFuzzySearch(options);
+            vector<string> queries = corpus.queries;
+            if (operation == "query_typo"s) {
+                transform(queries.begin(), queries.end(), queries.begin(), AddTypos);
+            }
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    for (const string& query : queries) {
+                        server->FindTopDocuments(query);
+                    }
+                    return queries.size();
+                }, result.ops);
+            result.memory = server->GetMemoryUsage();
+        }
+        else if (operation == "query_range"s || operation == "query_filter"s) {
+            server = make_unique<SearchServer>(""s, executor);
+            for (size_t i = 0; i < corpus.texts.size(); ++i) {
+                server->AddDocument(i, corpus.texts[i], corpus.statuses[i],
+                    { static_cast<int>(i * FILTER_RATING_LEVELS / corpus.texts.size()) });
+            }
+            const DocumentFilter filter{ DocumentStatus::ACTUAL,
+                static_cast<int>(FILTER_RATING_LEVELS * (1 - FILTER_RATING_SHARE)) };
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    for (const string& query : corpus.queries) {
+                        if (operation == "query_filter"s) {
+                            server->FindTopDocuments(query, filter);
+                        }
+                        else {
+                            server->FindTopDocuments(query, [min_rating = filter.min_rating](int, DocumentStatus status, int rating) {
+                                return status == DocumentStatus::ACTUAL && rating >= min_rating;
+                            });
+                        }
+                    }
+                    return corpus.queries.size();
+                }, result.ops);
+        }
+        else if (operation == "tenants"s || operation == "tenants_shared"s) {
+            mt19937 generator(7);
+            const auto stop_words = GenerateDictionary(generator, TENANT_STOP_WORD_COUNT, 10);
+            vector<string> terms;
+            for (const string& text : corpus.texts) {
+                for (const string_view word : SplitIntoWords(text)) {
+                    terms.emplace_back(word);
+                }
+            }
+            const auto dictionary = make_shared<const SharedDictionary>(stop_words, terms);
+            vector<unique_ptr<SearchServer>> tenants;
+            result.ns_per_op = Measure(repetitions, [&] { tenants.clear(); },
+                [&] {
+                    for (size_t i = 0; i < TENANT_BENCHMARK_COUNT; ++i) {
+                        tenants.push_back(operation == "tenants"s
+                            ? make_unique<SearchServer>(stop_words, executor)
+                            : make_unique<SearchServer>(dictionary, executor));
+                        for (size_t j = 0; j < min(TENANT_DOCUMENT_COUNT, corpus.texts.size()); ++j) {
+                            tenants.back()->AddDocument(j, corpus.texts[j], corpus.statuses[j], { 1, 2, 3 });
+                        }
+                    }
+                    return TENANT_BENCHMARK_COUNT;
+                }, result.ops);
+            for (const auto& tenant : tenants) {
+                result.memory += tenant->GetMemoryUsage();
+            }
+            if (operation == "tenants_shared"s) {
+                result.memory.stop_words += dictionary->GetMemoryUsage();
+            }
+        }
+        else if (operation == "query_par"s) {
+            make_server(1);
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    for (const string& query : corpus.queries) {
+                        server->FindTopDocuments(execution::par, query);
+                    }
+                    return corpus.queries.size();
+                }, result.ops);
+        }
+        else if (operation == "match"s) {
+            make_server(1);
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    for (size_t i = 0; i < corpus.queries.size(); ++i) {
+                        server->MatchDocument(execution::par, corpus.queries[i], i % corpus.texts.size());
+                    }
+                    return corpus.queries.size();
+                }, result.ops);
+        }
+        else if (operation == "match_seq"s || operation == "match_bloom"s) {
+            make_server(1);
+            if (operation == "match_bloom"s) {
+                server->SetBloomFilters(BLOOM_BENCHMARK_RATE);
+            }
+            result.ns_per_op = Measure(repetitions, [] {},
+                [&] {
+                    for (size_t i = 0; i < corpus.queries.size(); ++i) {
+                        server->MatchDocument(corpus.queries[i], i % corpus.texts.size());
+                    }
+                    return corpus.queries.size();
+                }, result.ops);
+            result.memory = server->GetMemoryUsage();
+        }
+        else if (operation == "remove"s) {
+            result.ns_per_op = Measure(repetitions, [&] { make_server(1); },
+                [&] {
+                    for (size_t i = 0; i < corpus.texts.size(); ++i) {
+                        server->RemoveDocument(execution::par, i);
+                    }
+                    return corpus.texts.size();
+                }, result.ops);
+        }
+        else if (operation == "dedup"s) {
+            // every document has a duplicate, RemoveDuplicates reports them to cout
+            ostringstream ignored;
+            result.ns_per_op = Measure(repetitions, [&] { make_server(2); },
+                [&] {
+                    auto* buffer = cout.rdbuf(ignored.rdbuf());
+                    RemoveDuplicates(*server);
+                    cout.rdbuf(buffer);
+                    ignored.str(""s);
+                    return corpus.texts.size() * 2;
+                }, result.ops);
+        }
+        else {
+            throw invalid_argument("Unknown operation "s + operation);
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+string ToJson(const BenchmarkResult& result) {
+    const BenchmarkCase& p = result.parameters;
+    ostringstream out;
+    out << "{\"operation\": \""s << result.operation << "\", \"documents\": "s << p.documents
+        << ", \"vocabulary\": "s << p.vocabulary << ", \"document_words\": "s << p.document_words
+        << ", \"query_words\": "s << p.query_words << ", \"minus_prob\": "s << p.minus_prob
+        << ", \"actual_share\": "s << p.actual_share << ", \"threads\": "s << p.threads
+        << ", \"ops\": "s << result.ops << ", \"ns_per_op\": "s << static_cast<uint64_t>(result.ns_per_op)
+        << ", \"ops_per_sec\": "s << static_cast<uint64_t>(result.ns_per_op > 0 ? 1e9 / result.ns_per_op : 0);
+    if (result.memory.GetTotal() > 0) {
+        const MemoryUsage& memory = result.memory;
+        out << ", \"memory_total\": "s << memory.GetTotal() << ", \"memory_stop_words\": "s << memory.stop_words
+            << ", \"memory_inverted_index\": "s << memory.inverted_index << ", \"memory_forward_index\": "s << memory.forward_index
+            << ", \"memory_quantized_index\": "s << memory.quantized_index << ", \"memory_impact_index\": "s << memory.impact_index
+            << ", \"memory_duplicate_index\": "s << memory.duplicate_index << ", \"memory_bloom_filters\": "s << memory.bloom_filters
+            << ", \"memory_fuzzy_index\": "s << memory.fuzzy_index
+            << ", \"memory_document_texts\": "s << memory.document_texts << ", \"memory_document_metadata\": "s << memory.document_metadata;
+    }
+    out << '}';
+    return out.str();
+}
+
+// case (all fields except measurements) -> ns_per_op
+map<string, double> ReadResults(const string& path) {
+    ifstream input(path);
+    if (!input) {
+        throw invalid_argument("Can't open "s + path);
+    }
+    static const regex field(R"re("(\w+)": ("[^"]*"|[-+.\deE]+))re");
+    map<string, double> results;
+    string line;
+    while (getline(input, line)) {
+        string key;
+        double ns_per_op = -1;
+        for (sregex_iterator it(line.begin(), line.end(), field), end; it != end; ++it) {
+            const string name = (*it)[1];
+            if (name == "ns_per_op"s) {
+                ns_per_op = stod((*it)[2]);
+            }
+            else if (name != "ops"s && name != "ops_per_sec"s && name.rfind("memory_"s, 0) != 0) {
+                key += (key.empty() ? ""s : " "s) + name + "="s + string((*it)[2]);
+            }
+        }
+        if (ns_per_op >= 0) {
+            results[key] = ns_per_op;
+        }
+    }
+    return results;
+}
+
+int Compare(const string& base_path, const string& new_path, double noise) {
+    const auto base = ReadResults(base_path);
+    const auto current = ReadResults(new_path);
+    int regressions = 0;
+    for (const auto& [key, new_ns] : current) {
+        const auto it = base.find(key);
+        if (it == base.end() || it->second <= 0) {
+            cout << "NEW         "s << key << ": "s << new_ns << " ns"s << endl;
+            continue;
+        }
+        const double change = new_ns / it->second - 1;
+        string mark = "same        "s;
+        if (change > noise) {
+            mark = "REGRESSION  "s;
+            ++regressions;
+        }
+        else if (change < -noise) {
+            mark = "improvement "s;
+        }
+        cout << mark << key << ": "s << it->second << " -> "s << new_ns << " ns ("s
+            << (change >= 0 ? "+"s : ""s) << static_cast<int>(change * 100) << "%)"s << endl;
+    }
+    cout << regressions << " regression(s) beyond "s << noise * 100 << "% noise"s << endl;
+    return regressions > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    const ToolOptions options(argc, argv);
+
+    if (options.Has("compare"s)) {
+        const auto paths = ParseStrings(options.Get("compare"s));
+        if (paths.size() != 2) {
+            throw invalid_argument("--compare needs two files"s);
+        }
+        return Compare(paths[0], paths[1], options.GetDouble("noise"s, 0.05));
+    }
+
+    const auto documents = ParseInts(options.Get("documents"s, "1000,10000"s));
+    const auto vocabularies = ParseInts(options.Get("vocabulary"s, "1000"s));
+    const auto document_words = ParseInts(options.Get("document-words"s, "50"s));
+    const auto query_words = ParseInts(options.Get("query-words"s, "3,10"s));
+    const auto minus_probs = ParseDoubles(options.Get("minus-prob"s, "0,0.2"s));
+    const auto actual_shares = ParseDoubles(options.Get("actual-share"s, "1"s));
+    const auto threads = ParseInts(options.Get("threads"s, "1,"s + to_string(max(1u, thread::hardware_concurrency()))));
+    const auto operations = ParseStrings(options.Get("operations"s, "add,add_dedup,query,query_par,query_q8,query_q16,query_impact,query_and,query_hot,query_fuzzy,query_typo,query_range,query_filter,tenants,tenants_shared,match,match_seq,match_bloom,remove,dedup"s));
+    const int query_count = options.GetInt("queries"s, 200);
+    const int repetitions = options.GetInt("repetitions"s, 3);
+
+    ofstream file;
+    if (options.Has("output"s)) {
+        file.open(options.Get("output"s));
+    }
+    ostream& output = options.Has("output"s) ? file : cout;
+
+    for (const int document_count : documents) {
+        for (const int vocabulary : vocabularies) {
+            for (const int words : document_words) {
+                for (const int query_word_count : query_words) {
+                    for (const double minus_prob : minus_probs) {
+                        for (const double actual_share : actual_shares) {
+                            for (const int thread_count : threads) {
+                                const BenchmarkCase parameters{ document_count, vocabulary, words, query_word_count,
+                                    minus_prob, actual_share, thread_count };
+                                for (const auto& result : RunCase(parameters, operations, query_count, repetitions)) {
+                                    output << ToJson(result) << endl;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
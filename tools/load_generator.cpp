@@ -0,0 +1,149 @@
+// Load generator of query service: measures QPS and latency of pipelined requests.
+// load_generator [--tcp=HOST:PORT | --unix=PATH] [--connections=4] [--pipeline=16] [--requests=10000]
+//                [--query-words=5] [--minus-prob=0.1]
+// Without address the service with synthetic base is started in this process on 127.0.0.1
+// ([--documents=10000] [--workers=N] [--batch=32] [--in-flight=256]).
+#include "../generators.h"
+#include "../query_service.h"
+#include "../search_server.h"
+#include "tool_options.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <thread>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct ClientStats {
+    vector<double> latencies_us;
+    size_t errors = 0;
+};
+
+// sends requests keeping pipeline_depth of them without response
+ClientStats RunClient(const string& tcp_address, const string& unix_path, const vector<string>& queries, size_t pipeline_depth) {
+    unique_ptr<QueryClient> client;
+    if (!unix_path.empty()) {
+        client = make_unique<QueryClient>(unix_path);
+    }
+    else {
+        const size_t colon = tcp_address.find(':');
+        client = make_unique<QueryClient>(tcp_address.substr(0, colon), stoi(tcp_address.substr(colon + 1)));
+    }
+
+    ClientStats stats;
+    stats.latencies_us.reserve(queries.size());
+    vector<Clock::time_point> send_time(queries.size());
+    size_t sent = 0;
+
+    auto send_next = [&](size_t count) {
+        vector<QueryRequest> requests;
+        for (; count > 0 && sent < queries.size(); --count, ++sent) {
+            requests.push_back({ static_cast<uint32_t>(sent), DocumentStatus::ACTUAL, queries[sent] });
+            send_time[sent] = Clock::now();
+        }
+        if (!requests.empty()) {
+            client->Send(requests);
+        }
+    };
+
+    send_next(pipeline_depth);
+    for (size_t received = 0; received < queries.size(); ++received) {
+        const QueryResponse response = client->Receive();
+        const auto latency = Clock::now() - send_time[response.request_id];
+        stats.latencies_us.push_back(chrono::duration<double, micro>(latency).count());
+        if (response.result != QueryResult::OK) {
+            ++stats.errors;
+        }
+        send_next(1);
+    }
+    return stats;
+}
+
+double Percentile(const vector<double>& sorted_values, double percentile) {
+    if (sorted_values.empty()) {
+        return 0;
+    }
+    const size_t index = min(sorted_values.size() - 1, static_cast<size_t>(percentile * sorted_values.size()));
+    return sorted_values[index];
+}
+
+int main(int argc, char* argv[]) {
+    const ToolOptions options(argc, argv);
+
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+
+    string tcp_address = options.Get("tcp"s);
+    const string unix_path = options.Get("unix"s);
+
+    // local service if address isn't set
+    optional<SearchServer> search_server;
+    unique_ptr<QueryService> service;
+    thread service_thread;
+    if (!options.Has("tcp"s) && !options.Has("unix"s)) {
+        const auto documents = GenerateQueries(generator, dictionary, options.GetInt("documents"s, 10'000), 70);
+        search_server.emplace(""s);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server->AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+
+        QueryServiceConfig config;
+        config.worker_count = options.GetInt("workers"s, config.worker_count);
+        config.max_batch_size = options.GetInt("batch"s, config.max_batch_size);
+        config.max_in_flight = options.GetInt("in-flight"s, config.max_in_flight);
+        service = make_unique<QueryService>(*search_server, config);
+        const uint16_t port = service->ListenTcp("127.0.0.1"s, 0);
+        service_thread = thread([&service] { service->Run(); });
+
+        tcp_address = "127.0.0.1:"s + to_string(port);
+    }
+
+    const size_t connection_count = options.GetInt("connections"s, 4);
+    const size_t pipeline_depth = options.GetInt("pipeline"s, 16);
+    const size_t request_count = options.GetInt("requests"s, 10'000);
+    const int query_words = options.GetInt("query-words"s, 5);
+    const double minus_prob = options.GetDouble("minus-prob"s, 0.1);
+
+    vector<vector<string>> queries(connection_count);
+    for (auto& connection_queries : queries) {
+        for (size_t i = 0; i < request_count; ++i) {
+            connection_queries.push_back(GenerateQuery(generator, dictionary, query_words, minus_prob));
+        }
+    }
+
+    vector<ClientStats> stats(connection_count);
+    const auto start = Clock::now();
+    {
+        vector<thread> clients;
+        for (size_t i = 0; i < connection_count; ++i) {
+            clients.emplace_back([&, i] { stats[i] = RunClient(tcp_address, unix_path, queries[i], pipeline_depth); });
+        }
+        for (auto& client : clients) {
+            client.join();
+        }
+    }
+    const double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<double> latencies;
+    size_t errors = 0;
+    for (const auto& client_stats : stats) {
+        latencies.insert(latencies.end(), client_stats.latencies_us.begin(), client_stats.latencies_us.end());
+        errors += client_stats.errors;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    cout << "requests: "s << latencies.size() << ", errors: "s << errors
+        << ", connections: "s << connection_count << ", pipeline: "s << pipeline_depth << endl;
+    cout << "QPS: "s << static_cast<size_t>(latencies.size() / seconds) << endl;
+    cout << "latency us: p50 = "s << Percentile(latencies, 0.5)
+        << ", p90 = "s << Percentile(latencies, 0.9)
+        << ", p99 = "s << Percentile(latencies, 0.99)
+        << ", max = "s << (latencies.empty() ? 0 : latencies.back()) << endl;
+
+    if (service) {
+        service->Stop();
+        service_thread.join();
+    }
+}
@@ -0,0 +1,238 @@
+// Replay of query log against server loaded from snapshot: QPS, latency and differences of results.
+// query_replay --snapshot=PATH --log=PATH [--threads=4] [--speed=0] [--results=PATH] [--compare=PATH]
+//   --speed=1 keeps original pacing of log (2 - twice faster), 0 - as fast as possible;
+//   --results writes results of queries, --compare counts queries whose results differ from the file
+//   written by other build; requests by predicate are replayed without filter.
+// query_replay --capture --snapshot=PATH --log=PATH [--documents=10000] [--requests=10000] [--query-words=5]
+//   [--minus-prob=0.1] [--threads=4] writes synthetic base and log of its requests through RequestQueue.
+#include "../generators.h"
+#include "../query_log.h"
+#include "../request_queue.h"
+#include "../search_server.h"
+#include "tool_options.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+// max difference of relevance of the same document in compared results
+const double RELEVANCE_TOLERANCE = 1e-9;
+// count of printed differences of results
+const size_t MAX_REPORTED_DIFFERENCES = 10;
+
+struct ReplayStats {
+    vector<double> latencies_us;
+    size_t errors = 0;
+    // records of log with status whose count of results differs from logged one
+    size_t count_mismatches = 0;
+};
+
+double Percentile(const vector<double>& sorted_values, double percentile) {
+    if (sorted_values.empty()) {
+        return 0;
+    }
+    const size_t index = min(sorted_values.size() - 1, static_cast<size_t>(percentile * sorted_values.size()));
+    return sorted_values[index];
+}
+
+void Capture(const ToolOptions& options, const string& snapshot_path, const string& log_path) {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, options.GetInt("documents"s, 10'000), 70);
+    SearchServer server("and in the"s);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 3), { static_cast<int>(i % 10) });
+    }
+    ofstream snapshot(snapshot_path, ios::binary);
+    server.SaveSnapshot(snapshot);
+
+    const size_t thread_count = options.GetInt("threads"s, 4);
+    const size_t request_count = options.GetInt("requests"s, 10'000);
+    const int query_words = options.GetInt("query-words"s, 5);
+    const double minus_prob = options.GetDouble("minus-prob"s, 0.1);
+    vector<string> queries;
+    for (size_t i = 0; i < request_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, query_words, minus_prob));
+    }
+
+    ofstream log(log_path, ios::binary);
+    QueryLogWriter writer(log);
+    RequestQueueConfig config;
+    config.query_log = &writer;
+    RequestQueue queue(server, config);
+    vector<thread> threads;
+    for (size_t t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = t; i < queries.size(); i += thread_count) {
+                if (i % 10 == 9) {
+                    queue.AddFindRequest(queries[i], [](int, DocumentStatus, int rating) { return rating > 4; });
+                }
+                else {
+                    queue.AddFindRequest(queries[i], static_cast<DocumentStatus>(i % 3));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    writer.Flush();
+    cout << "documents: "s << server.GetDocumentCount() << ", records: "s << writer.GetRecordCount() << endl;
+}
+
+void WriteResults(ostream& output, const vector<vector<Document>>& results) {
+    output << setprecision(17);
+    for (const auto& documents : results) {
+        bool is_first = true;
+        for (const Document& document : documents) {
+            output << (is_first ? ""s : " "s) << document.id << ':' << document.relevance;
+            is_first = false;
+        }
+        output << '\n';
+    }
+}
+
+vector<vector<Document>> ReadResults(istream& input) {
+    vector<vector<Document>> results;
+    string line;
+    while (getline(input, line)) {
+        auto& documents = results.emplace_back();
+        istringstream line_input(line);
+        Document document;
+        char colon;
+        while (line_input >> document.id >> colon >> document.relevance) {
+            documents.push_back(document);
+        }
+    }
+    return results;
+}
+
+bool IsSameResult(const vector<Document>& lhs, const vector<Document>& rhs) {
+    return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& l, const Document& r) {
+        return l.id == r.id && abs(l.relevance - r.relevance) <= RELEVANCE_TOLERANCE;
+    });
+}
+
+int main(int argc, char* argv[]) {
+    const ToolOptions options(argc, argv);
+    const string snapshot_path = options.Get("snapshot"s);
+    const string log_path = options.Get("log"s);
+    if (snapshot_path.empty() || log_path.empty()) {
+        cerr << "--snapshot and --log must be set"s << endl;
+        return 1;
+    }
+    if (options.Has("capture"s)) {
+        Capture(options, snapshot_path, log_path);
+        return 0;
+    }
+
+    ifstream snapshot(snapshot_path, ios::binary);
+    const SearchServer server = SearchServer::LoadSnapshot(snapshot);
+    ifstream log(log_path, ios::binary);
+    const vector<QueryLogRecord> records = ReadQueryLog(log);
+
+    const size_t thread_count = max<long long>(1, options.GetInt("threads"s, 4));
+    const double speed = options.GetDouble("speed"s, 0);
+    // records are written at the end of requests, so they may be slightly out of order of times
+    chrono::microseconds log_start = chrono::microseconds::max();
+    for (const QueryLogRecord& record : records) {
+        log_start = min(log_start, record.time);
+    }
+
+    // records are shared by threads round-robin, results are stored by index of record
+    vector<vector<Document>> results(records.size());
+    vector<ReplayStats> stats(thread_count);
+    const auto start = Clock::now();
+    {
+        vector<thread> threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&, t] {
+                ReplayStats& thread_stats = stats[t];
+                for (size_t i = t; i < records.size(); i += thread_count) {
+                    const QueryLogRecord& record = records[i];
+                    if (speed > 0) {
+                        const auto offset = chrono::duration<double, micro>((record.time - log_start).count() / speed);
+                        this_thread::sleep_until(start + chrono::duration_cast<Clock::duration>(offset));
+                    }
+                    const auto request_start = Clock::now();
+                    try {
+                        if (record.filter == QueryFilter::STATUS) {
+                            results[i] = server.FindTopDocuments(record.query, record.status);
+                        }
+                        else {
+                            results[i] = server.FindTopDocuments(record.query, [](int, DocumentStatus, int) { return true; });
+                        }
+                    }
+                    catch (const invalid_argument&) {
+                        ++thread_stats.errors;
+                    }
+                    thread_stats.latencies_us.push_back(chrono::duration<double, micro>(Clock::now() - request_start).count());
+                    if (record.filter == QueryFilter::STATUS && results[i].size() != record.result_count) {
+                        ++thread_stats.count_mismatches;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    const double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<double> latencies;
+    ReplayStats total;
+    for (const auto& thread_stats : stats) {
+        latencies.insert(latencies.end(), thread_stats.latencies_us.begin(), thread_stats.latencies_us.end());
+        total.errors += thread_stats.errors;
+        total.count_mismatches += thread_stats.count_mismatches;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    cout << "documents: "s << server.GetDocumentCount() << ", requests: "s << records.size()
+        << ", errors: "s << total.errors << ", threads: "s << thread_count
+        << ", speed: "s;
+    if (speed > 0) {
+        cout << speed << endl;
+    }
+    else {
+        cout << "max"s << endl;
+    }
+    cout << "QPS: "s << static_cast<size_t>(seconds > 0 ? latencies.size() / seconds : 0) << endl;
+    cout << "latency us: p50 = "s << Percentile(latencies, 0.5)
+        << ", p90 = "s << Percentile(latencies, 0.9)
+        << ", p99 = "s << Percentile(latencies, 0.99)
+        << ", p999 = "s << Percentile(latencies, 0.999)
+        << ", max = "s << (latencies.empty() ? 0 : latencies.back()) << endl;
+    cout << "counts of results different from log: "s << total.count_mismatches << endl;
+
+    if (options.Has("results"s)) {
+        ofstream output(options.Get("results"s));
+        WriteResults(output, results);
+    }
+    if (options.Has("compare"s)) {
+        ifstream input(options.Get("compare"s));
+        const vector<vector<Document>> base = ReadResults(input);
+        if (base.size() != results.size()) {
+            cout << "compared results have "s << base.size() << " queries instead of "s << results.size() << endl;
+            return 1;
+        }
+        size_t differences = 0;
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (!IsSameResult(results[i], base[i])) {
+                if (differences < MAX_REPORTED_DIFFERENCES) {
+                    cout << "different results of query "s << i << ": "s << records[i].query << endl;
+                }
+                ++differences;
+            }
+        }
+        cout << "queries with different results: "s << differences << endl;
+        return differences == 0 ? 0 : 2;
+    }
+}
@@ -0,0 +1,72 @@
+// Query service daemon.
+// query_server [--tcp=127.0.0.1:7000] [--unix=PATH] [--stop-words="and in"]
+//              [--documents=FILE | --synthetic=10000] [--workers=N] [--queue=1024] [--batch=32] [--in-flight=256]
+// FILE contains one document per line, ID of document is number of line (from 0).
+// Synthetic base is the same as base of load_generator (same random seed).
+#include "../generators.h"
+#include "../query_service.h"
+#include "../search_server.h"
+#include "tool_options.h"
+#include <csignal>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+static QueryService* running_service = nullptr;
+
+static void StopService(int) {
+    if (running_service) {
+        running_service->Stop();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const ToolOptions options(argc, argv);
+
+    SearchServer search_server(options.Get("stop-words"s));
+    if (options.Has("documents"s)) {
+        ifstream input(options.Get("documents"s));
+        if (!input) {
+            cerr << "Can't open "s << options.Get("documents"s) << endl;
+            return 1;
+        }
+        string line;
+        for (int id = 0; getline(input, line); ++id) {
+            search_server.AddDocument(id, line, DocumentStatus::ACTUAL, {});
+        }
+    }
+    else {
+        mt19937 generator;
+        const auto dictionary = GenerateDictionary(generator, 1000, 10);
+        const auto documents = GenerateQueries(generator, dictionary, options.GetInt("synthetic"s, 10'000), 70);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+        }
+    }
+
+    QueryServiceConfig config;
+    config.worker_count = options.GetInt("workers"s, config.worker_count);
+    config.max_queue_size = options.GetInt("queue"s, config.max_queue_size);
+    config.max_batch_size = options.GetInt("batch"s, config.max_batch_size);
+    config.max_in_flight = options.GetInt("in-flight"s, config.max_in_flight);
+    QueryService service(search_server, config);
+
+    if (options.Has("unix"s)) {
+        service.ListenUnix(options.Get("unix"s));
+        cerr << "Listening to "s << options.Get("unix"s) << endl;
+    }
+    if (options.Has("tcp"s) || !options.Has("unix"s)) {
+        const string address = options.Get("tcp"s, "127.0.0.1:7000"s);
+        const size_t colon = address.find(':');
+        const uint16_t port = service.ListenTcp(address.substr(0, colon), stoi(address.substr(colon + 1)));
+        cerr << "Listening to "s << address.substr(0, colon) << ":"s << port << endl;
+    }
+    cerr << search_server.GetDocumentCount() << " documents"s << endl;
+
+    running_service = &service;
+    signal(SIGINT, StopService);
+    signal(SIGTERM, StopService);
+    service.Run();
+    running_service = nullptr;
+}
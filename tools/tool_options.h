@@ -0,0 +1,48 @@
+#pragma once
+#include <map>
+#include <stdexcept>
+#include <string>
+
+using namespace std::string_literals;
+
+// command line options of tools: --name=value or --name (value "1")
+class ToolOptions {
+public:
+    ToolOptions(int argc, char* argv[]) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.rfind("--"s, 0) != 0) {
+                throw std::invalid_argument("Invalid option "s + arg);
+            }
+            const size_t equal = arg.find('=');
+            if (equal == std::string::npos) {
+                values_[arg.substr(2)] = "1"s;
+            }
+            else {
+                values_[arg.substr(2, equal - 2)] = arg.substr(equal + 1);
+            }
+        }
+    }
+
+    bool Has(const std::string& name) const {
+        return values_.count(name) > 0;
+    }
+
+    std::string Get(const std::string& name, const std::string& default_value = ""s) const {
+        const auto it = values_.find(name);
+        return it == values_.end() ? default_value : it->second;
+    }
+
+    long long GetInt(const std::string& name, long long default_value) const {
+        const auto it = values_.find(name);
+        return it == values_.end() ? default_value : std::stoll(it->second);
+    }
+
+    double GetDouble(const std::string& name, double default_value) const {
+        const auto it = values_.find(name);
+        return it == values_.end() ? default_value : std::stod(it->second);
+    }
+
+private:
+    std::map<std::string, std::string> values_;
+};